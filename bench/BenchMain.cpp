@@ -0,0 +1,373 @@
+/*
+* Project: p2mark
+* File:    BenchMain.cpp
+* Desc:    Benchmark suite entry point
+* Created: 2026-10-17
+*/
+
+#include <algorithm>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "argparse.hpp"
+
+#include "AppInfo.hpp"
+#include "Application.hpp"
+#include "AtomicFileWriter.hpp"
+#include "ClipScanner.hpp"
+#include "GuidGenerator.hpp"
+#include "P2Exception.hpp"
+#include "ParseContext.hpp"
+#include "Utils.hpp"
+#include "XmlReader.hpp"
+#include "XmpWriter.hpp"
+
+#include "BenchRunner.hpp"
+#include "ShootGenerator.hpp"
+
+using namespace p2mark;
+using namespace p2mark::bench;
+
+// Command line arguments
+static inline constexpr std::string_view ARG_CLIPS         {"--clips"};
+static inline constexpr std::string_view ARG_EXISTING_XMPS {"--existing-xmps"};
+static inline constexpr std::string_view ARG_FILTER        {"--filter"};
+static inline constexpr std::string_view ARG_JOBS          {"--jobs"};
+static inline constexpr std::string_view ARG_JSON          {"--json"};
+static inline constexpr std::string_view ARG_KEEP          {"--keep"};
+static inline constexpr std::string_view ARG_MARKED        {"--marked"};
+static inline constexpr std::string_view ARG_MEMOS         {"--memos"};
+static inline constexpr std::string_view ARG_MIN_TIME      {"--min-time"};
+static inline constexpr std::string_view ARG_SEED          {"--seed"};
+static inline constexpr std::string_view ARG_TEXT_LENGTH   {"--text-length"};
+static inline constexpr std::string_view ARG_WORK_DIR      {"--work-dir"};
+
+static inline constexpr size_t GUID_BATCH {4096};
+static inline constexpr size_t LOOKUPS    {1000};
+
+/// The application reports every clip; nobody needs to see that while it's being timed.
+class SilencedOutput {
+public:
+    SilencedOutput() :
+        m_Out(std::cout.rdbuf(nullptr)), m_Err(std::cerr.rdbuf(nullptr)) {}
+
+    ~SilencedOutput() {
+        std::cout.rdbuf(m_Out);
+        std::cerr.rdbuf(m_Err);
+        std::cout.clear();
+        std::cerr.clear();
+    }
+
+    SilencedOutput(const SilencedOutput&) = delete;
+    SilencedOutput& operator=(const SilencedOutput&) = delete;
+
+private:
+    std::streambuf* m_Out;
+    std::streambuf* m_Err;
+};
+
+static void SetupArguments(argparse::ArgumentParser& parser) {
+    parser.add_description("Generates a synthetic P2 shoot and times p2mark's hot paths on it.");
+
+    parser.add_argument(ARG_CLIPS)
+        .help("Clips in the generated shoot.")
+        .metavar("N").default_value(size_t {200}).scan<'u', size_t>();
+    parser.add_argument(ARG_MEMOS)
+        .help(std::format("Memos per marked clip (at most {}).", XmlReader::MARKERS_VECTOR_RESERVE))
+        .metavar("N").default_value(size_t {3}).scan<'u', size_t>();
+    parser.add_argument(ARG_MARKED)
+        .help("Share of the clips that have memos (0 to 1).")
+        .metavar("SHARE").default_value(0.5).scan<'g', double>();
+    parser.add_argument(ARG_TEXT_LENGTH)
+        .help("Characters per memo text.")
+        .metavar("N").default_value(size_t {32}).scan<'u', size_t>();
+    parser.add_argument(ARG_EXISTING_XMPS)
+        .help("Share of the clips that already have a Premiere XMP (0 to 1).")
+        .metavar("SHARE").default_value(0.5).scan<'g', double>();
+    parser.add_argument(ARG_SEED)
+        .help("Seed for the generated contents.")
+        .metavar("N").default_value(uint64_t {2026}).scan<'u', uint64_t>();
+    parser.add_argument(ARG_JOBS)
+        .help("Workers for the parallel end-to-end runs (0 uses every CPU core).")
+        .metavar("N").default_value(0U).scan<'u', unsigned int>();
+    parser.add_argument(ARG_MIN_TIME)
+        .help("Minimum time spent per benchmark, in milliseconds.")
+        .metavar("MS").default_value(300U).scan<'u', unsigned int>();
+    parser.add_argument(ARG_FILTER)
+        .help("Only run the benchmarks whose name contains this.")
+        .metavar("TEXT").default_value(std::string {});
+    parser.add_argument(ARG_JSON)
+        .help("Write the results as JSON into this file (- writes them to stdout).")
+        .metavar("FILE");
+    parser.add_argument(ARG_WORK_DIR)
+        .help("Where to generate the shoot (defaults to the temporary directory); "
+              "a CONTENTS directory the bench didn't generate is left alone.")
+        .metavar("DIR");
+    parser.add_argument(ARG_KEEP)
+        .help("Don't delete the generated shoot afterwards.")
+        .flag();
+}
+
+static void RunApplication(const AppMode mode, const fs::path& contentsDir, const AppOptions& options) {
+    SilencedOutput silenced {};
+
+    Application app(mode, {contentsDir.string()}, options);
+    app.RetrieveClipFiles();
+    app.SortClipFiles();
+    app.BatchProcessClips();
+}
+
+static void RunMicroBenchmarks(BenchRunner& runner, ShootGenerator& shoot) {
+    const std::vector<fs::path>& clips {shoot.MarkedClips().empty() ? shoot.Clips() : shoot.MarkedClips()};
+
+    // One context for all the clips, like a worker has
+    ParseContext context {};
+    runner.Run("XmlReader::ParseSourceXml", "micro", clips.size(), [&]() {
+        for(const fs::path& clip : clips) {
+            XmlReader reader(clip, context);
+            Consume(reader.ParseSourceXml().size());
+        }
+    });
+
+    // The same, from contents that were already read (io_uring prefetching)
+    std::vector<std::string> contents(clips.size());
+    runner.Run("XmlReader::ParseSourceXml (preloaded)", "micro", clips.size(), [&]() {
+        for(size_t i {0}; i < clips.size(); i++) {
+            XmlReader reader(clips[i], contents[i], context);
+            Consume(reader.ParseSourceXml().size());
+        }
+    }, [&]() {
+        for(size_t i {0}; i < clips.size(); i++) {
+            std::ifstream file(clips[i], std::ios::binary);
+            contents[i].assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        }
+    });
+
+    // The markers borrow their text from the readers, and live in their contexts
+    std::vector<std::unique_ptr<ParseContext>> contexts {};
+    std::vector<std::unique_ptr<XmlReader>> readers {};
+    std::vector<std::span<const Marker>> markers {};
+    std::vector<fs::path> xmps {};
+    for(const fs::path& clip : shoot.MarkedClips()) {
+        ParseContext& clipContext {*contexts.emplace_back(std::make_unique<ParseContext>())};
+        markers.emplace_back(readers.emplace_back(std::make_unique<XmlReader>(clip, clipContext))->ParseSourceXml());
+        xmps.emplace_back(fs::path(clip).replace_extension(XMP_EXT));
+    }
+
+    const std::string premiereXmp {ShootGenerator::PremiereXmp()};
+
+    if(!xmps.empty()) {
+        AtomicFileWriter fileWriter(Durability::DURABILITY_NONE);
+
+        runner.Run("XmpWriter::WriteDestinationXmp (new XMP)", "micro", xmps.size(), [&]() {
+            for(size_t i {0}; i < xmps.size(); i++) {
+                XmpWriter(xmps[i], markers[i], fileWriter, context).WriteDestinationXmp();
+            }
+        }, [&]() {
+            for(const fs::path& xmp : xmps) {
+                fs::remove(xmp);
+            }
+        });
+
+        runner.Run("XmpWriter::WriteDestinationXmp (existing XMP)", "micro", xmps.size(), [&]() {
+            for(size_t i {0}; i < xmps.size(); i++) {
+                XmpWriter(xmps[i], markers[i], fileWriter, context).WriteDestinationXmp();
+            }
+        }, [&]() {
+            for(const fs::path& xmp : xmps) {
+                std::ofstream(xmp, std::ios::binary | std::ios::trunc) << premiereXmp;
+            }
+        });
+
+        shoot.ResetXmps();
+    }
+
+    // Parsed by the setup, so a filtered out benchmark doesn't need tinyxml2
+    tinyxml2::XMLDocument xmpDoc {};
+    runner.Run("XmlUtils::FindDeepElement", "micro", LOOKUPS, [&]() {
+        for(size_t i {0}; i < LOOKUPS; i++) {
+            Consume(reinterpret_cast<size_t>(
+                XmlUtils::FindDeepElement(xmpDoc.RootElement(), XmpWriter::MARKER_LIST_PATH)));
+        }
+    }, [&]() {
+        if(xmpDoc.NoChildren() && xmpDoc.Parse(premiereXmp.data(), premiereXmp.size()) != XML_SUCCESS) {
+            throw P2Exception("Can\'t parse the generated XMP", P2ExceptionCode::CODE_XMP_READ_ERROR);
+        }
+    });
+
+    // Two paths with a common beginning, resolved in one walk
+    constexpr auto TRACKS_PATH {CompileXmlPath<"rdf:RDF/rdf:Description/xmpDM:Tracks">()};
+    runner.Run("XmlUtils::FindDeepElements (2 paths)", "micro", LOOKUPS, [&]() {
+        for(size_t i {0}; i < LOOKUPS; i++) {
+            const auto found {XmlUtils::FindDeepElements(xmpDoc.RootElement(), XmpWriter::MARKER_LIST_PATH, TRACKS_PATH)};
+            Consume(reinterpret_cast<size_t>(found[0]) ^ reinterpret_cast<size_t>(found[1]));
+        }
+    }, [&]() {
+        if(xmpDoc.NoChildren() && xmpDoc.Parse(premiereXmp.data(), premiereXmp.size()) != XML_SUCCESS) {
+            throw P2Exception("Can\'t parse the generated XMP", P2ExceptionCode::CODE_XMP_READ_ERROR);
+        }
+    });
+
+    std::vector<GuidGenerator::GuidString> guids(GUID_BATCH);
+    runner.Run("GuidGenerator::Generate", "micro", GUID_BATCH, [&]() {
+        for(GuidGenerator::GuidString& guid : guids) {
+            Consume(GuidGenerator::Generate(guid).size());
+        }
+    });
+
+    runner.Run("GuidGenerator::GenerateBatch", "micro", GUID_BATCH, [&]() {
+        GuidGenerator::GenerateBatch(guids);
+        Consume(static_cast<size_t>(guids.back()[0]));
+    });
+
+    // The CLIP directory holds the clips and their XMPs, only the clips are stat'ed
+    ClipScanner scanner {};
+    runner.Run("ClipScanner::Scan", "micro", shoot.Clips().size(), [&]() {
+        scanner.Scan(shoot.ClipDir(), AtomicFileWriter::TEMP_SUFFIX);
+        Consume(scanner.Clips().size());
+    });
+
+    // Directory order is whatever the filesystem likes, which is what the sort gets in real runs too
+    std::unique_ptr<Application> app {};
+    runner.Run("Application::SortClipFiles", "micro", shoot.Clips().size(), [&]() {
+        app->SortClipFiles();
+    }, [&]() {
+        SilencedOutput silenced {};
+        app = std::make_unique<Application>(AppMode::MODE_LIST_MARKERS,
+                                            std::vector<std::string> {shoot.ContentsDir().string()});
+        app->RetrieveClipFiles();
+    });
+}
+
+static void RunEndToEndBenchmarks(BenchRunner& runner, ShootGenerator& shoot, const unsigned int jobs) {
+    const size_t clipCount {shoot.Clips().size()};
+    const auto coldShoot = [&shoot]() { shoot.ResetXmps(); };
+
+    AppOptions sequential {};
+    AppOptions parallel {};
+    parallel.Jobs = jobs;
+
+    runner.Run("e2e: list", "e2e", clipCount, [&]() {
+        RunApplication(AppMode::MODE_LIST_MARKERS, shoot.ContentsDir(), sequential);
+    }, coldShoot);
+
+    runner.Run("e2e: write", "e2e", clipCount, [&]() {
+        RunApplication(AppMode::MODE_WRITE_MARKERS, shoot.ContentsDir(), sequential);
+    }, coldShoot);
+
+    if(jobs > 1) {
+        runner.Run(std::format("e2e: write, {} jobs", jobs), "e2e", clipCount, [&]() {
+            RunApplication(AppMode::MODE_WRITE_MARKERS, shoot.ContentsDir(), parallel);
+        }, coldShoot);
+    }
+
+    AppOptions fullDurability {parallel};
+    fullDurability.XmpDurability = Durability::DURABILITY_FULL;
+    runner.Run(std::format("e2e: write, {} jobs, full durability", jobs), "e2e", clipCount, [&]() {
+        RunApplication(AppMode::MODE_WRITE_MARKERS, shoot.ContentsDir(), fullDurability);
+    }, coldShoot);
+
+    // The warm-up run writes everything, the timed ones find it all in the manifest
+    shoot.ResetXmps();
+    runner.Run("e2e: write, unchanged re-run", "e2e", clipCount, [&]() {
+        RunApplication(AppMode::MODE_WRITE_MARKERS, shoot.ContentsDir(), sequential);
+    });
+
+    shoot.ResetXmps();
+}
+
+int main(int argc, char* argv[]) {
+    argparse::ArgumentParser argParser(std::format("{}-bench", AppInfo::Name), AppInfo::Version.ToString());
+    SetupArguments(argParser);
+
+    try {
+        argParser.parse_args(argc, argv);
+    } catch(const std::exception& e) {
+        std::cerr << std::format("{}\nType -h or --help to get usage info.\n", e.what());
+        return 1;
+    }
+
+    ShootSpec spec {};
+    spec.ClipCount    = argParser.get<size_t>(ARG_CLIPS);
+    spec.MemosPerClip = std::min(argParser.get<size_t>(ARG_MEMOS), XmlReader::MARKERS_VECTOR_RESERVE);
+    spec.MarkedShare  = argParser.get<double>(ARG_MARKED);
+    spec.TextLength   = argParser.get<size_t>(ARG_TEXT_LENGTH);
+    spec.ExistingXmps = argParser.get<double>(ARG_EXISTING_XMPS);
+    spec.Seed         = argParser.get<uint64_t>(ARG_SEED);
+
+    unsigned int jobs {argParser.get<unsigned int>(ARG_JOBS)};
+    if(jobs == 0) {
+        jobs = std::max(1U, std::thread::hardware_concurrency());
+    }
+
+    BenchRunner::Settings settings {};
+    settings.MinTime = std::chrono::milliseconds(argParser.get<unsigned int>(ARG_MIN_TIME));
+    settings.Filter  = argParser.get<std::string>(ARG_FILTER);
+
+    const fs::path workDir {argParser.present(ARG_WORK_DIR) ?
+                            fs::path(*argParser.present(ARG_WORK_DIR)) :
+                            fs::temp_directory_path() / std::format("{}-bench", AppInfo::Name)};
+
+    BenchRunner runner(settings);
+
+    try {
+        ShootGenerator shoot(workDir, spec);
+        shoot.Generate();
+
+        std::cerr << std::format("Generated {} clips ({} with memos) in {}.\n\n",
+                                 shoot.Clips().size(), shoot.MarkedClips().size(), shoot.ContentsDir().string());
+
+        RunMicroBenchmarks(runner, shoot);
+        RunEndToEndBenchmarks(runner, shoot, jobs);
+
+        if(!argParser.get<bool>(ARG_KEEP)) {
+            shoot.Remove();
+        }
+    } catch(const P2Exception& e) {
+        std::cerr << std::format("{}.\n", e.what());
+        return 1;
+    } catch(const fs::filesystem_error& e) {
+        std::cerr << std::format("{}.\n", e.what());
+        return 1;
+    }
+
+    const std::optional<std::string> jsonPath {argParser.present(ARG_JSON)};
+
+    // Keep stdout clean for the JSON
+    runner.PrintTable(jsonPath == "-" ? std::cerr : std::cout);
+
+    if(jsonPath) {
+        const std::vector<BenchRunner::ConfigEntry> config {
+            {"version",            BenchRunner::JsonString(AppInfo::Version.ToString())},
+            {"clips",              std::to_string(spec.ClipCount)},
+            {"memos_per_clip",     std::to_string(spec.MemosPerClip)},
+            {"marked_share",       std::format("{}", spec.MarkedShare)},
+            {"text_length",        std::to_string(spec.TextLength)},
+            {"existing_xmp_share", std::format("{}", spec.ExistingXmps)},
+            {"seed",               std::to_string(spec.Seed)},
+            {"jobs",               std::to_string(jobs)},
+            {"work_dir",           BenchRunner::JsonString(workDir.string())}
+        };
+
+        if(*jsonPath == "-") {
+            runner.WriteJson(std::cout, config);
+        } else {
+            std::ofstream jsonFile(*jsonPath, std::ios::trunc);
+            if(!jsonFile.is_open()) {
+                std::cerr << std::format("Cannot write {}.\n", *jsonPath);
+                return 1;
+            }
+
+            runner.WriteJson(jsonFile, config);
+        }
+    }
+
+    return 0;
+}
\ No newline at end of file
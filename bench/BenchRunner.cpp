@@ -0,0 +1,118 @@
+/*
+* Project: p2mark
+* File:    BenchRunner.cpp
+* Desc:    Benchmark harness implementation file
+* Created: 2026-10-17
+*/
+
+#include "BenchRunner.hpp"
+
+#include <algorithm>
+#include <format>
+#include <iostream>
+#include <numeric>
+
+namespace p2mark::bench {
+    void Consume(const size_t value) {
+        static volatile size_t sink {0};
+        sink = sink + value;
+    }
+
+    BenchRunner::BenchRunner(const Settings& settings) :
+        m_Settings(settings) {}
+
+    void BenchRunner::Run(std::string_view name, std::string_view group, const size_t itemsPerSample,
+                          const std::function<void()>& body, const std::function<void()>& setup) {
+        if(!m_Settings.Filter.empty() && name.find(m_Settings.Filter) == std::string_view::npos) {
+            return;
+        }
+
+        using Clock = std::chrono::steady_clock;
+
+        std::vector<double> samples {};
+        Clock::duration spent {};
+
+        // One untimed run to warm up the caches (and the page cache)
+        if(setup) setup();
+        body();
+
+        while(samples.size() < m_Settings.MaxSamples &&
+              (samples.size() < m_Settings.MinSamples || spent < m_Settings.MinTime)) {
+            if(setup) setup();
+
+            const Clock::time_point start {Clock::now()};
+            body();
+            const Clock::duration elapsed {Clock::now() - start};
+
+            spent += elapsed;
+            samples.push_back(static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+        }
+
+        std::sort(samples.begin(), samples.end());
+
+        BenchResult& result {m_Results.emplace_back()};
+        result.Name           = name;
+        result.Group          = group;
+        result.Samples        = samples.size();
+        result.ItemsPerSample = std::max<size_t>(itemsPerSample, 1);
+        result.MinNs          = samples.front();
+        result.MaxNs          = samples.back();
+        result.MeanNs         = std::accumulate(samples.begin(), samples.end(), 0.0) / static_cast<double>(samples.size());
+        result.MedianNs       = samples.size() % 2 == 1 ?
+                                samples[samples.size() / 2] :
+                                (samples[samples.size() / 2 - 1] + samples[samples.size() / 2]) / 2.0;
+
+        std::cerr << std::format("{:<52} {:>12.3f} ms  ({} samples)\n",
+                                 result.Name, result.MedianNs / 1e6, result.Samples);
+    }
+
+    void BenchRunner::PrintTable(std::ostream& out) const {
+        out << std::format("\n{:<52} {:>6} {:>12} {:>12} {:>12} {:>14}\n",
+                           "Benchmark", "Items", "Min ms", "Median ms", "Max ms", "ns/item");
+
+        for(const BenchResult& result : m_Results) {
+            out << std::format("{:<52} {:>6} {:>12.3f} {:>12.3f} {:>12.3f} {:>14.1f}\n",
+                               result.Name, result.ItemsPerSample, result.MinNs / 1e6,
+                               result.MedianNs / 1e6, result.MaxNs / 1e6, result.NsPerItem());
+        }
+    }
+
+    void BenchRunner::WriteJson(std::ostream& out, const std::vector<ConfigEntry>& config) const {
+        out << "{\n  \"config\": {";
+        for(size_t i {0}; i < config.size(); i++) {
+            out << std::format("{}\n    {}: {}", i == 0 ? "" : ",", JsonString(config[i].first), config[i].second);
+        }
+        out << "\n  },\n  \"results\": [";
+
+        for(size_t i {0}; i < m_Results.size(); i++) {
+            const BenchResult& result {m_Results[i]};
+
+            out << std::format("{}\n    {{\"name\": {}, \"group\": {}, \"samples\": {}, \"items_per_sample\": {}, "
+                               "\"min_ns\": {:.0f}, \"median_ns\": {:.0f}, \"mean_ns\": {:.0f}, \"max_ns\": {:.0f}, "
+                               "\"ns_per_item\": {:.1f}}}",
+                               i == 0 ? "" : ",", JsonString(result.Name), JsonString(result.Group),
+                               result.Samples, result.ItemsPerSample, result.MinNs, result.MedianNs,
+                               result.MeanNs, result.MaxNs, result.NsPerItem());
+        }
+
+        out << "\n  ]\n}\n";
+    }
+
+    std::string BenchRunner::JsonString(std::string_view text) {
+        std::string json {"\""};
+
+        for(const char c : text) {
+            if(c == '"' || c == '\\') {
+                json.push_back('\\');
+                json.push_back(c);
+            } else if(static_cast<unsigned char>(c) < 0x20) {
+                json.append(std::format("\\u{:04x}", static_cast<unsigned>(c)));
+            } else {
+                json.push_back(c);
+            }
+        }
+
+        json.push_back('"');
+        return json;
+    }
+}
\ No newline at end of file
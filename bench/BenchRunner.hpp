@@ -0,0 +1,71 @@
+/*
+* Project: p2mark
+* File:    BenchRunner.hpp
+* Desc:    Benchmark harness header file
+* Created: 2026-10-17
+*/
+
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace p2mark::bench {
+    struct BenchResult {
+        std::string Name  {};
+        std::string Group {};          // "micro" or "e2e"
+        size_t Samples        {0};
+        size_t ItemsPerSample {1};     // Clips, GUIDs, lookups... per timed run
+
+        // Per sample, in nanoseconds
+        double MinNs    {0.0};
+        double MedianNs {0.0};
+        double MeanNs   {0.0};
+        double MaxNs    {0.0};
+
+        inline double NsPerItem() const { return MedianNs / static_cast<double>(ItemsPerSample); }
+    };
+
+    /// Runs every benchmark until it has enough samples (or time),
+    /// keeps the statistics and prints them as a table or as JSON.
+    class BenchRunner {
+    public:
+        struct Settings {
+            std::chrono::milliseconds MinTime {300}; // Per benchmark
+            size_t MinSamples {5};
+            size_t MaxSamples {1000};
+            std::string Filter {};                   // Only the benchmarks whose name contains it
+        };
+
+        /// A key and an already formatted JSON value, for the "config" object.
+        using ConfigEntry = std::pair<std::string, std::string>;
+
+    public:
+        explicit BenchRunner(const Settings& settings);
+
+    public:
+        /// Times body() once per sample; setup() (if any) runs before
+        /// every sample and isn't timed. Skipped if the filter doesn't match.
+        void Run(std::string_view name, std::string_view group, const size_t itemsPerSample,
+                 const std::function<void()>& body, const std::function<void()>& setup = {});
+
+        inline const std::vector<BenchResult>& Results() const { return m_Results; }
+
+        void PrintTable(std::ostream& out) const;
+        void WriteJson(std::ostream& out, const std::vector<ConfigEntry>& config) const;
+
+        static std::string JsonString(std::string_view text);
+
+    private:
+        const Settings m_Settings;
+        std::vector<BenchResult> m_Results {};
+    };
+
+    /// Keeps the compiler from optimizing away work whose result is otherwise unused.
+    void Consume(const size_t value);
+}
\ No newline at end of file
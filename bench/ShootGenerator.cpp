@@ -0,0 +1,209 @@
+/*
+* Project: p2mark
+* File:    ShootGenerator.cpp
+* Desc:    Synthetic P2 shoot generator implementation file
+* Created: 2026-10-17
+*/
+
+#include "ShootGenerator.hpp"
+
+#include <algorithm>
+#include <array>
+#include <format>
+#include <fstream>
+#include <string_view>
+
+#include "ClipManifest.hpp"
+#include "Constants.hpp"
+#include "P2Exception.hpp"
+#include "XmlReader.hpp"
+
+namespace p2mark::bench {
+    static void WriteFile(const fs::path& path, std::string_view data) {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        if(!file.is_open() || !file.write(data.data(), static_cast<std::streamsize>(data.size()))) {
+            throw P2Exception(std::format("Can't write {}", path.string()), P2ExceptionCode::CODE_FILESYSTEM_ERROR);
+        }
+    }
+
+    ShootGenerator::ShootGenerator(const fs::path& root, const ShootSpec& spec) :
+        m_Root(root), m_Spec(spec),
+        m_ContentsDir(root / CONTENTS_DIR), m_ClipDir(m_ContentsDir / CLIP_DIR),
+        m_Random(spec.Seed) {}
+
+    fs::path ShootGenerator::Generate() {
+        Remove();
+        fs::create_directories(m_ClipDir);
+        WriteFile(m_ContentsDir / SENTINEL_FILE, {});
+
+        m_Clips.clear();
+        m_MarkedClips.clear();
+        m_ExistingXmps.clear();
+
+        const size_t memoCount {std::min(m_Spec.MemosPerClip, XmlReader::MARKERS_VECTOR_RESERVE)};
+        std::bernoulli_distribution marked(std::clamp(m_Spec.MarkedShare, 0.0, 1.0));
+        std::bernoulli_distribution hasXmp(std::clamp(m_Spec.ExistingXmps, 0.0, 1.0));
+
+        for(size_t i {0}; i < m_Spec.ClipCount; i++) {
+            // Camcorders name clips like 0001AB: a counter and two letters of the card
+            const std::string clipName {std::format("{:04X}{}{}", i % 0x10000,
+                                                    static_cast<char>('A' + (i / 0x10000) % 26), 'B')};
+            const fs::path clipPath {m_ClipDir / (clipName + XML_EXT.data())};
+
+            const bool withMemos {marked(m_Random) && memoCount > 0};
+            WriteFile(clipPath, ClipXml(clipName, withMemos ? memoCount : 0));
+
+            m_Clips.push_back(clipPath);
+            if(withMemos) {
+                m_MarkedClips.push_back(clipPath);
+            }
+
+            if(hasXmp(m_Random)) {
+                m_ExistingXmps.push_back(m_ClipDir / (clipName + XMP_EXT.data()));
+            }
+        }
+
+        ResetXmps();
+        return m_ContentsDir;
+    }
+
+    void ShootGenerator::Remove() const {
+        CheckReplaceable();
+        fs::remove_all(m_ContentsDir);
+    }
+
+    void ShootGenerator::CheckReplaceable() const {
+        if(fs::exists(m_ContentsDir) && !fs::exists(m_ContentsDir / SENTINEL_FILE)) {
+            throw P2Exception(std::format("{} wasn't generated by the bench and won't be replaced, "
+                                          "pick another work directory", m_ContentsDir.string()),
+                              P2ExceptionCode::CODE_FILESYSTEM_ERROR);
+        }
+    }
+
+    void ShootGenerator::ResetXmps() const {
+        for(const auto& file : fs::directory_iterator(m_ClipDir)) {
+            if(file.path().extension() == XMP_EXT) {
+                fs::remove(file.path());
+            }
+        }
+
+        std::error_code ec {};
+        fs::remove(m_ClipDir / ClipManifest::FILE_NAME, ec);
+
+        const std::string xmp {PremiereXmp()};
+        for(const fs::path& path : m_ExistingXmps) {
+            WriteFile(path, xmp);
+        }
+    }
+
+    std::string ShootGenerator::ClipXml(std::string_view clipName, const size_t memoCount) {
+        std::string xml {};
+        xml.reserve(4096 + memoCount * (m_Spec.TextLength + 160));
+
+        xml.append("<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"no\" ?>\n");
+        xml.append("<P2Main xmlns=\"urn:schemas-Professional-Plug-in:P2:ClipMetadata:v3.1\">\n");
+        xml.append("\t<ClipContent>\n");
+        xml.append(std::format("\t\t<ClipName>{}</ClipName>\n", clipName));
+        xml.append(std::format("\t\t<GlobalClipID>060A2B340101010501010D4313000000{:016X}0080458200000000</GlobalClipID>\n",
+                               m_Random()));
+        xml.append("\t\t<Duration>1500</Duration>\n\t\t<EditUnit>1/25</EditUnit>\n");
+        xml.append("\t\t<EssenceList>\n\t\t\t<Video>\n\t\t\t\t<VideoFormat>MXF</VideoFormat>\n");
+        xml.append("\t\t\t\t<Codec Class=\"100\">AVC-I_1080/50i</Codec>\n\t\t\t\t<FrameRate>50i</FrameRate>\n");
+        xml.append("\t\t\t\t<StartTimecode>00:00:00:00</StartTimecode>\n\t\t\t</Video>\n");
+        for(int channel {0}; channel < 4; channel++) {
+            xml.append("\t\t\t<Audio>\n\t\t\t\t<AudioFormat>MXF</AudioFormat>\n");
+            xml.append("\t\t\t\t<SamplingRate>48000</SamplingRate>\n\t\t\t\t<BitsPerSample>24</BitsPerSample>\n\t\t\t</Audio>\n");
+        }
+        xml.append("\t\t</EssenceList>\n");
+
+        xml.append("\t\t<ClipMetadata>\n");
+        xml.append(std::format("\t\t\t<UserClipName>{}</UserClipName>\n", clipName));
+        xml.append("\t\t\t<DataSource>SHOOTING</DataSource>\n");
+        xml.append("\t\t\t<Access>\n\t\t\t\t<Creator>p2mark-bench</Creator>\n");
+        xml.append("\t\t\t\t<CreationDate>2026-10-17T10:00:00+03:00</CreationDate>\n\t\t\t</Access>\n");
+        xml.append("\t\t\t<Device>\n\t\t\t\t<Manufacturer>Panasonic</Manufacturer>\n");
+        xml.append("\t\t\t\t<ModelName>AJ-PX800</ModelName>\n\t\t\t</Device>\n");
+
+        if(memoCount > 0) {
+            xml.append("\t\t\t<MemoList>\n");
+            for(size_t memo {0}; memo < memoCount; memo++) {
+                xml.append(std::format("\t\t\t\t<Memo MemoID=\"{}\">\n", memo + 1));
+                xml.append(std::format("\t\t\t\t\t<Offset>{}</Offset>\n", memo * 1500 / memoCount));
+                xml.append("\t\t\t\t\t<Person>p2mark</Person>\n");
+                xml.append(std::format("\t\t\t\t\t<Text>{}</Text>\n", MemoText()));
+                xml.append("\t\t\t\t</Memo>\n");
+            }
+            xml.append("\t\t\t</MemoList>\n");
+        }
+
+        // Metadata after the memo list, which the streaming reader never gets to
+        xml.append("\t\t\t<Shoot>\n\t\t\t\t<Shooter>p2mark</Shooter>\n");
+        xml.append("\t\t\t\t<StartDate>2026-10-17T10:00:00+03:00</StartDate>\n");
+        xml.append("\t\t\t\t<EndDate>2026-10-17T10:01:00+03:00</EndDate>\n\t\t\t</Shoot>\n");
+        xml.append("\t\t\t<Thumbnail>\n\t\t\t\t<FrameOffset>0</FrameOffset>\n");
+        xml.append("\t\t\t\t<Width>160</Width>\n\t\t\t\t<Height>90</Height>\n\t\t\t</Thumbnail>\n");
+        xml.append("\t\t</ClipMetadata>\n\t</ClipContent>\n</P2Main>\n");
+
+        return xml;
+    }
+
+    std::string ShootGenerator::MemoText() {
+        // Mostly plain words, with the occasional character
+        // that has to be escaped or takes more than one byte
+        static constexpr std::array<std::string_view, 12> words {
+            "take", "good", "wide", "close-up", "interview", "b-roll",
+            "&amp;", "&lt;NG&gt;", "\"quote\"", "café", "сцена", "drone"
+        };
+
+        std::uniform_int_distribution<size_t> pick(0, words.size() - 1);
+        std::string text {};
+
+        while(text.size() < m_Spec.TextLength) {
+            if(!text.empty()) {
+                text.push_back(' ');
+            }
+            text.append(words[pick(m_Random)]);
+        }
+
+        return text;
+    }
+
+    std::string ShootGenerator::PremiereXmp() {
+        std::string xmp {
+            "<?xpacket begin=\"\xEF\xBB\xBF\" id=\"W5M0MpCehiHzreSzNTczkc9d\"?>\n"
+            "<x:xmpmeta xmlns:x=\"adobe:ns:meta/\" x:xmptk=\"Adobe XMP Core 9.1-c002\">\n"
+            "   <rdf:RDF xmlns:rdf=\"http://www.w3.org/1999/02/22-rdf-syntax-ns#\">\n"
+            "      <rdf:Description rdf:about=\"\"\n"
+            "            xmlns:xmp=\"http://ns.adobe.com/xap/1.0/\"\n"
+            "            xmlns:xmpDM=\"http://ns.adobe.com/xmp/1.0/DynamicMedia/\"\n"
+            "            xmlns:xmpMM=\"http://ns.adobe.com/xap/1.0/mm/\">\n"
+            "         <xmp:MetadataDate>2026-10-17T10:00:00+03:00</xmp:MetadataDate>\n"
+            "         <xmpMM:InstanceID>xmp.iid:00000000-0000-0000-0000-000000000000</xmpMM:InstanceID>\n"
+            "         <xmpDM:Tracks>\n"
+            "            <rdf:Bag>\n"
+            "               <rdf:li>\n"
+            "                  <rdf:Description xmpDM:trackName=\"Comment\" xmpDM:trackType=\"Comment\"\n"
+            "                        xmpDM:frameRate=\"f25\">\n"
+            "                     <xmpDM:markers>\n"
+            "                        <rdf:Seq>\n"
+            "                        </rdf:Seq>\n"
+            "                     </xmpDM:markers>\n"
+            "                  </rdf:Description>\n"
+            "               </rdf:li>\n"
+            "            </rdf:Bag>\n"
+            "         </xmpDM:Tracks>\n"
+            "      </rdf:Description>\n"
+            "   </rdf:RDF>\n"
+            "</x:xmpmeta>\n"
+        };
+
+        // XMP packets are padded so they can be edited in place
+        for(size_t i {0}; i < ShootGenerator::XMP_PADDING / 100; i++) {
+            xmp.append(99, ' ');
+            xmp.push_back('\n');
+        }
+
+        xmp.append("<?xpacket end=\"w\"?>");
+        return xmp;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,84 @@
+/*
+* Project: p2mark
+* File:    ShootGenerator.hpp
+* Desc:    Synthetic P2 shoot generator header file
+* Created: 2026-10-17
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace p2mark::bench {
+    /// What a generated shoot looks like.
+    struct ShootSpec {
+        size_t ClipCount     {100};
+        size_t MemosPerClip  {3};     // Up to XmlReader::MARKERS_VECTOR_RESERVE
+        double MarkedShare   {0.5};   // Clips that have memos at all
+        size_t TextLength    {32};    // Characters per memo text
+        double ExistingXmps  {0.5};   // Clips that already have an (empty) Premiere XMP
+        uint64_t Seed        {2026};
+    };
+
+    /// Creates a CONTENTS/CLIP tree that looks like a real P2 card:
+    /// clip files with metadata around the memo list, and for some of the
+    /// clips the kind of XMP Premiere leaves behind after importing them
+    /// (3-space indentation, an empty marker list, the packet padding).
+    /// The same spec and seed always give the same files.
+    class ShootGenerator {
+    public:
+        static inline constexpr size_t XMP_PADDING {2048};
+
+        /// Left in every generated CONTENTS directory; one without it
+        /// (a real card's, say) is never replaced or removed.
+        static inline constexpr std::string_view SENTINEL_FILE {".p2mark-bench"};
+
+    public:
+        ShootGenerator(const fs::path& root, const ShootSpec& spec);
+
+    public:
+        /// Creates the shoot (replacing one generated before) and returns its CONTENTS path.
+        /// Throws if there's a CONTENTS directory the bench didn't generate.
+        fs::path Generate();
+
+        /// Removes the generated shoot, under the same condition.
+        void Remove() const;
+
+        /// Puts the XMPs back the way Generate() left them
+        /// and removes the manifest, for another cold run.
+        void ResetXmps() const;
+
+        inline const fs::path& ContentsDir() const { return m_ContentsDir; }
+        inline const fs::path& ClipDir() const { return m_ClipDir; }
+        inline const std::vector<fs::path>& Clips() const { return m_Clips; }
+        inline const std::vector<fs::path>& MarkedClips() const { return m_MarkedClips; }
+
+        /// An XMP the way Premiere writes it before there are any markers in it.
+        static std::string PremiereXmp();
+
+    private:
+        /// Throws unless the CONTENTS directory is missing or was generated by the bench.
+        void CheckReplaceable() const;
+
+        std::string ClipXml(std::string_view clipName, const size_t memoCount);
+        std::string MemoText();
+
+    private:
+        const fs::path m_Root;
+        const ShootSpec m_Spec;
+        fs::path m_ContentsDir;
+        fs::path m_ClipDir;
+
+        std::mt19937_64 m_Random;
+        std::vector<fs::path> m_Clips {};
+        std::vector<fs::path> m_MarkedClips {};
+        std::vector<fs::path> m_ExistingXmps {};
+    };
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+/*
+* Project: p2mark
+* File:    AppOptions.hpp
+* Desc:    Optional behaviour switches collected from the command line
+* Created: 2026-10-17
+*/
+
+#pragma once
+
+#include <filesystem>
+
+#include "Durability.hpp"
+#include "OutputFormat.hpp"
+
+namespace fs = std::filesystem;
+
+namespace p2mark {
+    /// Everything that changes how a run behaves, apart from the mode itself.
+    struct AppOptions {
+        /// Clips processed in parallel per device (0 means every CPU core).
+        unsigned int Jobs {1};
+
+        /// Keep running and process clips as they are copied into CLIP.
+        bool Watch {false};
+
+        /// Process every clip, even the ones the manifest says are unchanged.
+        bool Force {false};
+
+        /// How XMPs are made to survive a power cut or a yanked card.
+        Durability XmpDurability {Durability::DURABILITY_BATCH};
+
+        /// What goes to the standard output: text, or records for other programs.
+        OutputFormat Format {OutputFormat::FORMAT_TEXT};
+
+        /// Where the markers of every clip read go (see MarkerIndex); empty: nowhere.
+        fs::path IndexPath {};
+
+        /// Print nothing at all; the results are only kept (see BatchProcessor).
+        bool Silent {false};
+
+        /// Keep a copy of every clip's markers with its result.
+        bool KeepMarkers {false};
+    };
+}
\ No newline at end of file
@@ -8,104 +8,624 @@
 #include "Application.hpp"
 
 namespace p2mark {
-    Application::Application(const AppMode mode, std::string_view contentsDirPath) :
+    std::string_view ClipResult::OutcomeName() const {
+        if(ErrorCode) {
+            return "error";
+        } else if(Unchanged) {
+            return "unchanged";
+        } else if(Record && Record->Outcome == ClipOutcome::XMP_WRITTEN) {
+            return "xmp_written";
+        } else if(Record && Record->Outcome == ClipOutcome::MARKERS_LISTED) {
+            return "markers_listed";
+        } else {
+            return "no_markers";
+        }
+    }
+
+    Application::Application(const AppMode mode,
+                             const std::vector<std::string>& contentsDirPaths,
+                             const AppOptions& options,
+                             std::ostream& recordOut) :
     m_AppMode(mode),
-    m_ComGuard(),
-    m_AppStats(),
-    m_ContentsDir(contentsDirPath),
-    m_ClipDir(m_ContentsDir / CLIP_DIR) {
-        auto result {P2Validator::Validate(m_ContentsDir)};
+    m_Options(options),
+    m_Jobs(options.Jobs == 0 ? std::max(1U, std::thread::hardware_concurrency()) : options.Jobs),
+    m_StartTime(std::chrono::steady_clock::now()),
+    m_AppStats() {
+        m_Shoots.reserve(contentsDirPaths.size());
+
+        if(m_Options.Format != OutputFormat::FORMAT_TEXT) {
+            m_Records = std::make_unique<RecordWriter>(m_Options.Format, recordOut);
+        }
+
+        if(!m_Options.IndexPath.empty()) {
+            m_IndexBuilder = std::make_unique<MarkerIndexBuilder>();
+        }
+
+        for(const std::string& path : contentsDirPaths) {
+            if(TarArchive::IsArchivePath(path)) {
+                OpenArchive(path);
+            } else {
+                OpenShoot(m_Shoots.emplace_back(), path);
+            }
+
+            // A single shoot keeps the old behaviour: an invalid path is fatal
+            if(contentsDirPaths.size() == 1 && m_Shoots.size() == 1 && !m_Shoots.front().IsValid()) {
+                throw P2Exception(m_Shoots.front().Error, P2ExceptionCode::CODE_FILESYSTEM_ERROR);
+            }
+        }
+    }
+
+    void Application::OpenShoot(Shoot& shoot, const fs::path& contentsDir) const {
+        shoot.ContentsDir = contentsDir;
+        shoot.ClipDir     = shoot.ContentsDir / CLIP_DIR;
+
+        try {
+            shoot.Error = ValidateShoot(shoot.ContentsDir, m_Options.Watch);
+        } catch(const fs::filesystem_error& e) {
+            shoot.Error = std::format("Cannot access path: {}", e.path1().string());
+        }
+
+        if(shoot.IsValid()) {
+            shoot.DeviceId = p2mark::FilesystemUtils::GetDeviceId(shoot.ContentsDir);
+            shoot.Clips.reserve(Application::CLIP_FILES_VECTOR_RESERVE);
+
+            // Loaded even when forced: its XMP outcomes are still worth keeping
+            shoot.Manifest = ClipManifest(shoot.ClipDir);
+            shoot.Manifest.Load();
+
+            shoot.FileWriter = std::make_unique<AtomicFileWriter>(m_Options.XmpDurability);
+        }
+    }
+
+    void Application::OpenArchive(const fs::path& archive) {
+        const auto invalid = [this, &archive](std::string error) {
+            Shoot& shoot {m_Shoots.emplace_back()};
+            shoot.ContentsDir = archive;
+            shoot.Archive     = archive;
+            shoot.Error       = std::move(error);
+        };
+
+        if(IsWriteMode(m_AppMode) || m_Options.Watch) {
+            invalid("An archive can only have its markers listed, its XMPs would have nowhere to go");
+            return;
+        }
+
+        TarArchive tar {};
+
+        try {
+            StageTimer timer(Stage::STAGE_SCAN);
+            tar.Scan(archive);
+        } catch(const fs::filesystem_error& e) {
+            invalid(std::format("Cannot access path: {}", e.path1().string()));
+            return;
+        } catch(const P2Exception& e) {
+            invalid(e.what());
+            return;
+        }
+
+        if(tar.ContentsDirs().empty()) {
+            invalid(std::format("There is no {}/{} directory in the archive", CONTENTS_DIR, CLIP_DIR));
+            return;
+        }
+
+        for(const std::string& path : tar.TooLarge()) {
+            TextOut() << std::format("{} is skipped because it is too large (more than {} MB).\n",
+                                     (archive / path).string(), P2Validator::CLIP_SIZE_LIMIT_MB);
+        }
+
+        const uint64_t deviceId {p2mark::FilesystemUtils::GetDeviceId(archive)};
+        std::vector<ArchivedClip>& clips {tar.Clips()};
+        size_t next {0};
+
+        // Both are sorted by CONTENTS directory, so every shoot's clips come in one run
+        for(const std::string& contentsDir : tar.ContentsDirs()) {
+            Shoot& shoot {m_Shoots.emplace_back()};
+            shoot.ContentsDir = archive / contentsDir;
+            shoot.ClipDir     = shoot.ContentsDir / CLIP_DIR;
+            shoot.DeviceId    = deviceId;
+            shoot.Archive     = archive;
+            shoot.FileWriter  = std::make_unique<AtomicFileWriter>(m_Options.XmpDurability); // Never gets anything
+
+            for(; next < clips.size() && clips[next].ContentsDir == contentsDir; next++) {
+                shoot.Clips.emplace_back(shoot.ClipDir / clips[next].Name);
+                shoot.ArchivedClips.emplace_back(std::move(clips[next].Clip));
+            }
+        }
+    }
+
+    std::string Application::ValidateShoot(const fs::path& contentsDir, const bool allowEmptyClipDir) {
+        auto result {P2Validator::Validate(contentsDir)};
 
         if(result == P2ValidationResult::CONTENTS_DIR_MISSING ||
            result == P2ValidationResult::CONTENTS_ISNT_DIRECTORY ||
            result == P2ValidationResult::CONTENTS_IS_EMPTY) {
-            throw P2Exception(std::format("The provided path to the {} directory is invalid", CONTENTS_DIR),
-                              P2ExceptionCode::CODE_FILESYSTEM_ERROR);
+            return std::format("The provided path to the {} directory is invalid", CONTENTS_DIR);
         } else if(result == P2ValidationResult::NOT_A_CONTENTS_DIR) {
-            throw P2Exception(std::format(
-                "Provided folder must be named {}, without a trailing slash at the end",
-                CONTENTS_DIR),
-                P2ExceptionCode::CODE_FILESYSTEM_ERROR);
+            return std::format("Provided folder must be named {}, without a trailing slash at the end",
+                               CONTENTS_DIR);
         } else if(result == P2ValidationResult::CLIP_DIR_MISSING) {
-            throw P2Exception(std::format(
-                "The {} directory is missing. The P2 structure is damaged",
-                CLIP_DIR),
-                P2ExceptionCode::CODE_FILESYSTEM_ERROR);
-        } else if(result == P2ValidationResult::CLIP_DIR_EMPTY) {
-            throw P2Exception(std::format("The {} directory is empty", CLIP_DIR),
-                              P2ExceptionCode::CODE_FILESYSTEM_ERROR);
+            return std::format("The {} directory is missing. The P2 structure is damaged", CLIP_DIR);
+        } else if(result == P2ValidationResult::CLIP_DIR_EMPTY && !allowEmptyClipDir) {
+            return std::format("The {} directory is empty", CLIP_DIR);
         }
 
-        m_Clips.reserve(Application::CLIP_FILES_VECTOR_RESERVE);
+        return {};
     }
 
     void Application::RetrieveClipFiles() {
-        for(const auto& file : fs::directory_iterator(m_ClipDir)) {
-            auto result {P2Validator::ValidateClip(file)};
+        for(Shoot& shoot : m_Shoots) {
+            if(!shoot.IsValid()) {
+                continue;
+            }
+
+            // One unreadable CLIP directory mustn't stop the other shoots;
+            // a single shoot keeps the old behaviour, it's fatal
+            try {
+                RetrieveClipFiles(shoot);
+            } catch(const fs::filesystem_error& e) {
+                if(m_Shoots.size() == 1) {
+                    throw;
+                }
 
-            if(result == ClipValidationResult::CORRECT_CLIP_FILE) {
-                m_Clips.emplace_back(file.path());
-            } else if(result == ClipValidationResult::SUSPICIOUSLY_LARGE_CLIP_FILE) {
-                std::cout << std::format("{} is skipped because it is too large (more than {} MB).\n",
-                                   file.path().filename().string(),
-                                   P2Validator::CLIP_SIZE_LIMIT_MB);
+                shoot.Error = std::format("Cannot access path: {}", e.path1().string());
             }
         }
     }
 
+    void Application::RetrieveClipFiles(Shoot& shoot) const {
+        // Found (and read) along with the archive
+        if(shoot.IsArchived()) {
+            return;
+        }
+
+        StageTimer timer(Stage::STAGE_SCAN);
+
+        // Temporary XMPs are left behind by a run that was stopped before it could put them in place.
+        // Another writer (a watch, the daemon) may be working on the shoot: only stale ones go
+        shoot.Scanner.Scan(shoot.ClipDir, IsWriteMode(m_AppMode) ? AtomicFileWriter::TEMP_SUFFIX : std::string_view {});
+
+        for(const ScannedFile& leftover : shoot.Scanner.Leftovers()) {
+            const fs::path path {shoot.ClipDir / shoot.Scanner.Name(leftover)};
+            if(AtomicFileWriter::IsStaleTemp(path)) {
+                std::error_code ec {};
+                fs::remove(path, ec);
+                StageMetrics::CountSyscalls(Syscall::SYSCALL_UNLINK);
+            }
+        }
+
+        for(const ScannedFile& file : shoot.Scanner.TooLarge()) {
+            TextOut() << std::format("{} is skipped because it is too large (more than {} MB).\n",
+                                     fs::path(shoot.Scanner.Name(file)).string(),
+                                     P2Validator::CLIP_SIZE_LIMIT_MB);
+        }
+    }
+
+    void Application::UseWorkers(WorkerPool& pool, std::vector<ParseContext>& contexts) {
+        assert(contexts.size() == pool.WorkerCount() && "UseWorkers: one context per worker.");
+
+        m_SharedPool     = &pool;
+        m_SharedContexts = &contexts;
+    }
+
     void Application::SortClipFiles() {
-        std::sort(m_Clips.begin(), m_Clips.end(), [](const fs::path& a, const fs::path& b) {
-            return a.filename().string() < b.filename().string();
-        });
+        for(Shoot& shoot : m_Shoots) {
+            SortClipFiles(shoot);
+        }
+    }
+
+    void Application::SortClipFiles(Shoot& shoot) const {
+        if(shoot.IsArchived()) {
+            return; // Sorted when the archive was read
+        }
+
+        StageTimer timer(Stage::STAGE_SORT);
+
+        // The names are only compared when their first characters are the same
+        shoot.Scanner.Sort();
+
+        shoot.Clips.clear();
+        shoot.Scanner.AppendClipPaths(shoot.ClipDir, shoot.Clips);
     }
 
     void Application::BatchProcessClips() {
-        const size_t& clipsCount {m_Clips.size()};
-        size_t markerCount {0};
+        // One shoot: the classic output, printed as the clips are processed
+        if(m_Shoots.size() == 1) {
+            Shoot& shoot {m_Shoots.front()};
+
+            if(shoot.Clips.empty()) {
+                ErrorOut() << "No clips found.\n";
+                return;
+            }
+
+            shoot.Stats.ClipsFound = static_cast<int>(shoot.Clips.size());
 
-        if(m_Clips.empty()) {
-            std::cerr << "No clips found.\n";
+            if(m_SharedPool) {
+                shoot.Completed = ProcessClipsInParallel(shoot, *m_SharedPool, *m_SharedContexts);
+
+                const std::vector<fs::path> failed {FinishWrites(shoot)};
+                PrintShootReport(shoot);
+                PrintWriteFailures(failed);
+            } else if(m_Jobs > 1) {
+                // No point in spinning up more workers than there are clips
+                WorkerPool pool(std::min<size_t>(m_Jobs, shoot.Clips.size()));
+                std::vector<ParseContext> contexts(pool.WorkerCount());
+                shoot.Completed = ProcessClipsInParallel(shoot, pool, contexts);
+
+                const std::vector<fs::path> failed {FinishWrites(shoot)};
+                PrintShootReport(shoot);
+                PrintWriteFailures(failed);
+            } else {
+                shoot.Completed = ProcessClipsSequentially(shoot);
+
+                PrintWriteFailures(FinishWrites(shoot));
+                if(shoot.Completed) {
+                    PrintStats(shoot.Stats, "Clips in the shoot");
+                }
+            }
+
+            FlushRecords();
+            m_AppStats += shoot.Stats;
             return;
         }
 
-        m_AppStats.ClipsFound = static_cast<int>(clipsCount);
+        // Several shoots: one lane per device, in the order the devices first appear
+        std::map<uint64_t, std::vector<Shoot*>> lanesByDevice {};
+        std::vector<std::vector<Shoot*>*> lanes {};
 
-        for(size_t i {0}; i < clipsCount; i++) {
-            const fs::path& clip {m_Clips[i]};
-            const std::string xmlFileName {clip.filename().string()};
-            const std::string xmpFileName {clip.stem().string() + XMP_EXT.data()};
+        for(Shoot& shoot : m_Shoots) {
+            if(!shoot.IsValid()) {
+                ErrorOut() << std::format("{}: {}.\n", shoot.ContentsDir.string(), shoot.Error);
+                continue;
+            }
 
+            auto [lane, inserted] {lanesByDevice.try_emplace(shoot.DeviceId)};
+            if(inserted) {
+                lanes.emplace_back(&lane->second);
+            }
+
+            lane->second.emplace_back(&shoot);
+        }
+
+        // -j is the total: the lanes split the workers between them (at least one each)
+        const auto laneWorkers = [this, &lanes](const size_t lane) {
+            const size_t share {m_Jobs / lanes.size()};
+            return std::max<size_t>(1, share + (lane < m_Jobs % lanes.size() ? 1 : 0));
+        };
+
+        // The shared workers can only run one shoot at a time
+        std::vector<std::thread> laneThreads {};
+        for(size_t i {1}; i < lanes.size() && !m_SharedPool; i++) {
+            laneThreads.emplace_back(&Application::RunDeviceLane, this, std::cref(*lanes[i]), laneWorkers(i));
+        }
+
+        if(m_SharedPool) {
+            for(const std::vector<Shoot*>* lane : lanes) {
+                RunDeviceLane(*lane, m_SharedPool->WorkerCount());
+            }
+        } else if(!lanes.empty()) {
+            RunDeviceLane(*lanes.front(), laneWorkers(0));
+        }
+
+        for(std::thread& t : laneThreads) {
+            t.join();
+        }
+
+        for(const Shoot& shoot : m_Shoots) {
+            if(shoot.Completed) {
+                m_AppStats += shoot.Stats;
+            }
+        }
+
+        FlushRecords();
+        PrintGlobalStats();
+    }
+
+    void Application::ProcessTree(const fs::path& root) {
+        std::mutex foundMutex {};
+        std::condition_variable foundCondition {};
+        std::deque<fs::path> found {};
+        bool walkDone {false};
+        std::exception_ptr walkError {};
+
+        // The walk goes on in the background; every shoot it finds is processed right away
+        ShootFinder finder {};
+        std::thread walk([&]() {
             try {
-                markerCount = ProcessSingleClip(clip, xmpFileName);
+                finder.Walk(root,
+                    [&](const fs::path& contentsDir) {
+                        {
+                            std::lock_guard<std::mutex> lock(foundMutex);
+                            found.push_back(contentsDir);
+                        }
+                        foundCondition.notify_one();
+                    },
+                    [this](const fs::path& dir, const std::error_code& error) {
+                        std::lock_guard<std::mutex> lock(m_OutputMutex);
+                        ErrorOut() << std::format("Cannot read {}: {}.\n", dir.string(), error.message());
+                    });
+            } catch(...) {
+                walkError = std::current_exception();
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(foundMutex);
+                walkDone = true;
+            }
+            foundCondition.notify_one();
+        });
 
-                // Don't print files without markers in them (clutters standard output)
-                if(markerCount > 0) {
-                    PrintFileResult(xmlFileName, xmpFileName, markerCount);
+        // Whichever way this returns, the walk has to end first: it pushes into found
+        struct WalkJoiner {
+            ShootFinder& Finder;
+            std::thread& Walk;
+
+            ~WalkJoiner() {
+                Finder.Stop();
+                if(Walk.joinable()) {
+                    Walk.join();
                 }
-            } catch(const P2Exception& e) {
-                const P2ExceptionCode& code {e.code()};
-                std::string_view msg {e.what()};
-
-                if(IsWriteMode(m_AppMode)) {
-                    std::cerr << std::format("{} -> <-------->: {}.\n", xmlFileName, msg);
-                } else {
-                    std::cerr << std::format("{}: {}.\n", xmlFileName, msg);
+            }
+        } walkJoiner {finder, walk};
+
+        std::optional<WorkerPool> ownPool {};
+        std::vector<ParseContext> ownContexts {};
+
+        if(!m_SharedPool) {
+            ownPool.emplace(m_Jobs);
+            ownContexts = std::vector<ParseContext>(ownPool->WorkerCount());
+        }
+
+        WorkerPool& pool {m_SharedPool ? *m_SharedPool : *ownPool};
+        std::vector<ParseContext>& contexts {m_SharedContexts ? *m_SharedContexts : ownContexts};
+
+        while(true) {
+            fs::path contentsDir {};
+
+            {
+                std::unique_lock<std::mutex> lock(foundMutex);
+                foundCondition.wait(lock, [&]() { return !found.empty() || walkDone; });
+                if(found.empty()) {
+                    break;
                 }
 
-                if(code == P2ExceptionCode::CODE_XML_READ_ERROR) {
-                    m_AppStats.XmlReadErrors++;
-                } else if(code == P2ExceptionCode::CODE_XMP_WRITE_ERROR) {
-                    m_AppStats.XmpWriteErrors++;
+                contentsDir = std::move(found.front());
+                found.pop_front();
+            }
+
+            Shoot shoot {};
+            OpenShoot(shoot, contentsDir);
+
+            // One unreadable CLIP directory mustn't stop the whole archive
+            if(shoot.IsValid()) {
+                try {
+                    RetrieveClipFiles(shoot);
+                } catch(const fs::filesystem_error& e) {
+                    shoot.Error = std::format("Cannot access path: {}", e.path1().string());
                 }
-            } catch(const std::filesystem::filesystem_error& e) {
-                const std::string errorDesc {e.what()};
+            }
 
-                std::cerr << std::format("Cannot write {}: {}.\n",
-                                         xmpFileName, errorDesc);
-                return;
-            } catch(const std::bad_alloc&) {
-                std::cerr << "System is out of memory.\n";
-                return;
+            if(shoot.IsValid()) {
+                SortClipFiles(shoot);
+                ProcessLaneShoot(shoot, pool, contexts);
+                FlushRecords();
+            } else {
+                std::lock_guard<std::mutex> lock(m_OutputMutex);
+                ErrorOut() << std::format("{}: {}.\n", shoot.ContentsDir.string(), shoot.Error);
+            }
+
+            if(shoot.Completed) {
+                m_AppStats += shoot.Stats;
+            }
+
+            // An archive holds thousands of shoots: only what the stats need is kept of each
+            Shoot& kept {m_Shoots.emplace_back()};
+            kept.ContentsDir = std::move(shoot.ContentsDir);
+            kept.ClipDir     = std::move(shoot.ClipDir);
+            kept.DeviceId    = shoot.DeviceId;
+            kept.Error       = std::move(shoot.Error);
+            kept.Stats       = shoot.Stats;
+            kept.Completed   = shoot.Completed;
+        }
+
+        walk.join();
+
+        if(walkError) {
+            std::rethrow_exception(walkError);
+        }
+
+        // MakeSingularIfNeeded() only drops an 's', which "directories" doesn't take
+        const std::string_view dirNoun {finder.DirectoriesListed() == 1 ? "directory" : "directories"};
+        const std::string_view shootNoun {finder.ShootsFound() == 1 ? "shoot" : "shoots"};
+
+        FlushRecords();
+        TextOut() << std::format("\nSearched {} {} under {} and found {} {}.\n",
+                                 finder.DirectoriesListed(), dirNoun, root.string(),
+                                 finder.ShootsFound(), shootNoun);
+        PrintGlobalStats();
+    }
+
+    void Application::WatchClips(const std::function<bool()>& stopRequested) {
+        Shoot& shoot {m_Shoots.front()};
+        ClipWatcher watcher(shoot.ClipDir);
+        ParseContext context {};
+
+        TextOut() << std::format("Watching {} for new clips, press Ctrl+C to stop.\n",
+                                 shoot.ClipDir.string());
+
+        while(!stopRequested()) {
+            for(const fs::path& clip : watcher.WaitForClips(WATCH_TICK)) {
+                ClipValidationResult validation {ClipValidationResult::UNSUPPORTED_CLIP_FILE};
+
+                // The clip may be gone again by now
+                try {
+                    validation = P2Validator::ValidateClip(fs::directory_entry(clip));
+                } catch(const fs::filesystem_error&) {
+                    continue;
+                }
+
+                if(validation == ClipValidationResult::SUSPICIOUSLY_LARGE_CLIP_FILE) {
+                    TextOut() << std::format("{} is skipped because it is too large (more than {} MB).\n",
+                                             clip.filename().string(),
+                                             P2Validator::CLIP_SIZE_LIMIT_MB);
+                }
+
+                if(validation != ClipValidationResult::CORRECT_CLIP_FILE) {
+                    continue;
+                }
+
+                shoot.Clips.emplace_back(clip);
+                shoot.Stats.ClipsFound++;
+
+                const ClipResult result {ProcessClipAt(shoot, shoot.Clips.size() - 1, shoot.Stats, context)};
+                RecordResult(shoot, result);
+                PrintClipResult(shoot, result);
+                TextOut().flush();
+
+                if(result.Fatal) {
+                    PrintWriteFailures(FinishWrites(shoot));
+                    FlushRecords();
+                    return;
+                }
+            }
+
+            // Every batch of clips is made durable before waiting for the next one
+            PrintWriteFailures(FinishWrites(shoot));
+            FlushRecords();
+        }
+
+        shoot.Completed = true;
+        m_AppStats += shoot.Stats;
+
+        PrintStats(shoot.Stats, "Clips in the shoot");
+    }
+
+    void Application::WriteStatsJson(std::ostream& out) const {
+        const auto counters = [](const AppStats& stats) {
+            return std::format("\"clips_found\": {}, \"clips_with_markers\": {}, \"total_markers\": {}, "
+                               "\"clips_unchanged\": {}, \"xml_read_errors\": {}, \"xmp_write_errors\": {}",
+                               stats.ClipsFound, stats.ClipsWithMarkers, stats.TotalMarkers,
+                               stats.ClipsUnchanged, stats.XmlReadErrors, stats.XmpWriteErrors);
+        };
+
+        const MetricsSnapshot metrics {StageMetrics::Snapshot()};
+        const auto elapsed {std::chrono::steady_clock::now() - m_StartTime};
+
+        out << "{\n";
+        out << std::format("  \"program\": {},\n", StringUtils::QuoteJson(AppInfo::Name));
+        out << std::format("  \"version\": {},\n", StringUtils::QuoteJson(AppInfo::Version.ToString()));
+        out << std::format("  \"mode\": {},\n", StringUtils::QuoteJson(AppModeToString(m_AppMode)));
+        out << std::format("  \"jobs\": {},\n", m_Jobs);
+        out << std::format("  \"durability\": {},\n",
+                           StringUtils::QuoteJson(DurabilityToString(m_Options.XmpDurability)));
+        out << std::format("  \"elapsed_ns\": {},\n",
+                           std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+        out << std::format("  \"totals\": {{{}}},\n", counters(m_AppStats));
+
+        out << "  \"shoots\": [";
+        for(size_t i {0}; i < m_Shoots.size(); i++) {
+            const Shoot& shoot {m_Shoots[i]};
+            out << std::format("{}\n    {{\"path\": {}, \"error\": {}, \"completed\": {}, {}}}",
+                               i == 0 ? "" : ",",
+                               StringUtils::QuoteJson(shoot.ContentsDir.string()),
+                               shoot.IsValid() ? "null" : StringUtils::QuoteJson(shoot.Error),
+                               shoot.Completed ? "true" : "false", counters(shoot.Stats));
+        }
+        out << "\n  ],\n";
+
+        out << "  \"stages\": {";
+        for(size_t i {0}; i < metrics.Stages.size(); i++) {
+            const Stage stage {static_cast<Stage>(i)};
+            const LatencyHistogram& histogram {metrics.Of(stage)};
+            out << std::format("{}\n    {}: {{\"count\": {}, \"total_ns\": {}, \"p50_ns\": {}, "
+                               "\"p99_ns\": {}, \"max_ns\": {}}}",
+                               i == 0 ? "" : ",", StringUtils::QuoteJson(StageToString(stage)),
+                               histogram.Count, histogram.TotalNs, histogram.Percentile(50.0),
+                               histogram.Percentile(99.0), histogram.MaxNs);
+        }
+        out << "\n  },\n";
+
+        out << std::format("  \"io\": {{\"bytes_read\": {}, \"bytes_written\": {}}},\n",
+                           metrics.BytesRead, metrics.BytesWritten);
+
+        out << "  \"syscalls\": {";
+        for(size_t i {0}; i < metrics.Syscalls.size(); i++) {
+            const Syscall call {static_cast<Syscall>(i)};
+            out << std::format("{}{}: {}", i == 0 ? "" : ", ",
+                               StringUtils::QuoteJson(SyscallToString(call)), metrics.Of(call));
+        }
+        out << "}\n}\n";
+    }
+
+    bool Application::SaveMarkerIndex() {
+        if(!m_IndexBuilder) {
+            return true;
+        }
+
+        StageTimer timer(Stage::STAGE_INDEX);
+
+        if(!m_IndexBuilder->Save(m_Options.IndexPath, m_Options.XmpDurability)) {
+            ErrorOut() << std::format("Cannot write the marker index to {}.\n", m_Options.IndexPath.string());
+            return false;
+        }
+
+        std::string markerNoun {"markers"};
+        std::string clipNoun {"clips"};
+        p2mark::StringUtils::MakeSingularIfNeeded(markerNoun, static_cast<int>(m_IndexBuilder->MarkerCount()));
+        p2mark::StringUtils::MakeSingularIfNeeded(clipNoun, static_cast<int>(m_IndexBuilder->ClipCount()));
+
+        TextOut() << std::format("\nIndexed {} {} of {} {} into {}.\n",
+                                 m_IndexBuilder->MarkerCount(), markerNoun,
+                                 m_IndexBuilder->ClipCount(), clipNoun, m_Options.IndexPath.string());
+        return true;
+    }
+
+    void Application::RunDeviceLane(const std::vector<Shoot*>& shoots, const size_t workers) {
+        std::optional<WorkerPool> ownPool {};
+        std::vector<ParseContext> ownContexts {};
+
+        if(!m_SharedPool) {
+            ownPool.emplace(workers);
+            ownContexts = std::vector<ParseContext>(ownPool->WorkerCount()); // Kept from one shoot to the next
+        }
+
+        WorkerPool& pool {m_SharedPool ? *m_SharedPool : *ownPool};
+        std::vector<ParseContext>& contexts {m_SharedContexts ? *m_SharedContexts : ownContexts};
+
+        for(Shoot* shoot : shoots) {
+            ProcessLaneShoot(*shoot, pool, contexts);
+        }
+    }
+
+    void Application::ProcessLaneShoot(Shoot& shoot, WorkerPool& pool, std::vector<ParseContext>& contexts) {
+        shoot.Stats.ClipsFound = static_cast<int>(shoot.Clips.size());
+        shoot.Completed = ProcessClipsInParallel(shoot, pool, contexts);
+        const std::vector<fs::path> failed {FinishWrites(shoot)};
+
+        std::lock_guard<std::mutex> lock(m_OutputMutex);
+        TextOut() << std::format("\n{}:\n", shoot.ContentsDir.string());
+
+        if(shoot.Clips.empty()) {
+            ErrorOut() << "No clips found.\n";
+        } else {
+            PrintShootReport(shoot);
+            PrintWriteFailures(failed);
+        }
+    }
+
+    bool Application::ProcessClipsSequentially(Shoot& shoot) const {
+        const size_t& clipsCount {shoot.Clips.size()};
+
+        const std::vector<bool> wanted {WantedClips(shoot)};
+        ClipPrefetcher prefetcher(shoot.Clips, wanted);
+        ParseContext context {};
+
+        for(size_t i {0}; i < clipsCount; i++) {
+            const ClipResult result {ProcessClipAt(shoot, i, shoot.Stats, context, &prefetcher)};
+            RecordResult(shoot, result);
+            PrintClipResult(shoot, result);
+
+            if(result.Fatal) {
+                return false;
             }
 
             // Signal to the OS that it can trigger a context switch
@@ -114,27 +634,391 @@ namespace p2mark {
             }
         }
 
-        PrintStats();
+        return true;
+    }
+
+    bool Application::ProcessClipsInParallel(Shoot& shoot, WorkerPool& pool,
+                                             std::vector<ParseContext>& contexts) const {
+        assert(contexts.size() == pool.WorkerCount() && "ProcessClipsInParallel: one context per worker.");
+
+        const size_t& clipsCount {shoot.Clips.size()};
+
+        shoot.Results.assign(clipsCount, ClipResult {});
+        std::vector<WorkerStats> workerStats(pool.WorkerCount());
+        std::atomic<bool> stopped {false};
+
+        const std::vector<bool> wanted {WantedClips(shoot)};
+        ClipPrefetcher prefetcher(shoot.Clips, wanted);
+
+        pool.ParallelFor(clipsCount, [&](const size_t index, const size_t worker) {
+            if(stopped.load(std::memory_order_relaxed)) {
+                return;
+            }
+
+            shoot.Results[index] = ProcessClipAt(shoot, index, workerStats[worker].Stats, contexts[worker], &prefetcher);
+            if(shoot.Results[index].Fatal) {
+                stopped.store(true, std::memory_order_relaxed);
+            }
+        });
+
+        for(const WorkerStats& ws : workerStats) {
+            shoot.Stats += ws.Stats;
+        }
+
+        // The manifest isn't shared with the workers, it's updated afterwards
+        for(const ClipResult& result : shoot.Results) {
+            RecordResult(shoot, result);
+        }
+
+        return !stopped.load();
+    }
+
+    ClipResult Application::ProcessClipAt(Shoot& shoot, const size_t index, AppStats& stats, ParseContext& context,
+                                          ClipPrefetcher* prefetcher) const {
+        const fs::path& clip {shoot.Clips[index]};
+
+        ClipResult result {};
+        result.XmlName   = clip.filename().string();
+        result.XmpName   = clip.stem().string() + XMP_EXT.data();
+        result.Processed = true;
+
+        if(ReuseRecordedResult(shoot, clip, result, stats)) {
+            return result;
+        }
+
+        std::optional<PrefetchedClip> prefetched {};
+        if(prefetcher) {
+            StageTimer timer(Stage::STAGE_PREFETCH);
+            prefetched = prefetcher->Take(index);
+        }
+
+        // An archived clip was read with the archive; the reader takes its own copy
+        if(!prefetched && shoot.IsArchived()) {
+            prefetched = shoot.ArchivedClips[index];
+        }
+
+        try {
+            ManifestEntry record {};
+            result.MarkerCount = ProcessSingleClip(clip, shoot.ClipDir, result.XmpName, *shoot.FileWriter,
+                                                   context, prefetched ? &*prefetched : nullptr, stats, record,
+                                                   result.MarkerRecords, shoot.Markers, result.Markers);
+            result.Record      = record;
+        } catch(const P2Exception& e) {
+            result.ErrorCode    = e.code();
+            result.ErrorMessage = e.what();
+
+            if(e.code() == P2ExceptionCode::CODE_XML_READ_ERROR) {
+                stats.XmlReadErrors++;
+            } else if(e.code() == P2ExceptionCode::CODE_XMP_WRITE_ERROR) {
+                stats.XmpWriteErrors++;
+            }
+        } catch(const std::filesystem::filesystem_error& e) {
+            result.ErrorCode    = P2ExceptionCode::CODE_FILESYSTEM_ERROR;
+            result.ErrorMessage = e.what();
+            result.Fatal        = true;
+        } catch(const std::bad_alloc&) {
+            result.ErrorCode = P2ExceptionCode::CODE_GENERIC;
+            result.Fatal     = true;
+        }
+
+        // Whatever buffer the clip left behind can hold one of the next ones
+        if(prefetched && prefetcher) {
+            prefetcher->Recycle(std::move(prefetched->Data));
+        }
+
+        return result;
+    }
+
+    std::vector<bool> Application::WantedClips(const Shoot& shoot) const {
+        // Archived clips are in memory already
+        std::vector<bool> wanted(shoot.Clips.size(), !shoot.IsArchived());
+        if(!ReusesResults() || shoot.IsArchived()) {
+            return wanted;
+        }
+
+        for(size_t i {0}; i < shoot.Clips.size(); i++) {
+            const ManifestEntry* entry {shoot.Manifest.Find(shoot.Clips[i].filename().string())};
+
+            // Whether it really is unchanged is only checked when it's processed;
+            // if it isn't after all, it's simply read the usual way
+            wanted[i] = !entry;
+        }
+
+        return wanted;
+    }
+
+    bool Application::ReusesResults() const {
+        const bool needsMarkers {m_Records || m_Options.KeepMarkers};
+        return !m_Options.Force && !m_IndexBuilder && !(needsMarkers && !IsWriteMode(m_AppMode));
+    }
+
+    bool Application::ReuseRecordedResult(const Shoot& shoot,
+                                          const fs::path& clipPath,
+                                          ClipResult& result,
+                                          AppStats& stats) const {
+        if(!ReusesResults()) {
+            return false;
+        }
+
+        StageTimer timer(Stage::STAGE_MANIFEST);
+
+        const ManifestEntry* entry {shoot.Manifest.Find(result.XmlName)};
+        if(!entry) {
+            return false;
+        }
+
+        FileStamp clipStamp {};
+        if(!ClipManifest::StampFile(clipPath, clipStamp) || clipStamp.Size != entry->Clip.Size) {
+            return false;
+        }
+
+        // Same size but a new mtime (e.g. the card was copied again):
+        // only the contents can tell. Remember the new mtime if they match,
+        // so the next run gets away with a stat() again
+        if(clipStamp != entry->Clip) {
+            uint64_t hash {0};
+            if(!ClipManifest::HashFile(clipPath, hash) || hash != entry->ContentHash) {
+                return false;
+            }
+
+            ManifestEntry record {*entry};
+            record.Clip   = clipStamp;
+            result.Record = record;
+        }
+
+        // The XMP has to be exactly the one we wrote, an editor may have touched it since
+        if(IsWriteMode(m_AppMode) && entry->Outcome == ClipOutcome::XMP_WRITTEN) {
+            FileStamp xmpStamp {};
+            if(!ClipManifest::StampFile(shoot.ClipDir / result.XmpName, xmpStamp) || xmpStamp != entry->Xmp) {
+                result.Record.reset();
+                return false;
+            }
+        }
+
+        result.MarkerCount = entry->MarkerCount;
+        result.Unchanged   = true;
+
+        stats.ClipsUnchanged++;
+        if(result.MarkerCount > 0) {
+            stats.ClipsWithMarkers++;
+            stats.TotalMarkers += static_cast<int>(result.MarkerCount);
+        }
+
+        return true;
+    }
+
+    void Application::RecordResult(Shoot& shoot, const ClipResult& result) const {
+        // Listing never writes to the card; only write runs keep a manifest
+        if(!IsWriteMode(m_AppMode)) {
+            return;
+        }
+
+        if(!result.Record) {
+            // Failed clips are tried again next time
+            if(result.ErrorCode) {
+                shoot.Manifest.Forget(result.XmlName);
+            }
+            return;
+        }
+
+        shoot.Manifest.Record(result.XmlName, *result.Record);
     }
 
-    size_t Application::ProcessSingleClip(const fs::path& xmlPath, std::string_view xmpFileName) {
-        std::vector<Marker> markers {XmlReader(xmlPath).ParseSourceXml()};
+    std::vector<fs::path> Application::FinishWrites(Shoot& shoot) const {
+        StageTimer timer(Stage::STAGE_COMMIT);
+
+        std::vector<fs::path> failed {shoot.FileWriter->Commit()};
+        shoot.Stats.XmpWriteErrors += static_cast<int>(failed.size());
+
+        // The manifest is only saved once the XMPs it vouches for are in place.
+        // What it has on the failed ones doesn't match the files that were kept,
+        // so their clips are processed again next time.
+        // A write-protected card simply doesn't get one, and neither does a listed one
+        if(IsWriteMode(m_AppMode)) {
+            shoot.Manifest.Save();
+        }
+
+        return failed;
+    }
+
+    size_t Application::ProcessSingleClip(const fs::path& xmlPath,
+                                          const fs::path& clipDir,
+                                          std::string_view xmpFileName,
+                                          AtomicFileWriter& fileWriter,
+                                          ParseContext& context,
+                                          PrefetchedClip* prefetched,
+                                          AppStats& stats,
+                                          ManifestEntry& record,
+                                          std::string& markerRecords,
+                                          MarkerStore& markerStore,
+                                          MarkerRange& keptMarkers) const {
+        // The trace shows which clip each span belongs to
+        const std::string tracedPath {TraceRecorder::IsRecording() ? xmlPath.string() : std::string {}};
+        StageTimer clipTimer(Stage::STAGE_CLIP, tracedPath);
+
+        // The markers borrow their text from the reader, so it has to outlive them
+        std::optional<XmlReader> reader {};
+
+        // Only the manifest needs the stamp and the hash, and only write runs keep one
+        const bool recorded {IsWriteMode(m_AppMode)};
+
+        {
+            StageTimer readTimer(Stage::STAGE_READ);
+
+            // Stamped before reading: if it changes while we read it,
+            // the next run sees a different stamp and reads it again
+            // (the prefetcher stamps it before reading it, too)
+            if(recorded && prefetched) {
+                record.Clip = prefetched->Stamp;
+            } else if(recorded) {
+                ClipManifest::StampFile(xmlPath, record.Clip);
+            }
+
+            // The contents go into the context; the buffer that was there
+            // goes back to the prefetcher (see ProcessClipAt())
+            if(prefetched) {
+                reader.emplace(xmlPath, prefetched->Data, context);
+            } else {
+                reader.emplace(xmlPath, context);
+            }
+        }
+
+        const std::span<const Marker> markers {reader->ParseSourceXml()};
+
+        // From what the reader holds already; the file is only mapped again if the reader couldn't map it
+        if(recorded && !reader->HashContents(record.ContentHash)) {
+            ClipManifest::HashFile(xmlPath, record.ContentHash);
+        }
+
+        record.MarkerCount = static_cast<uint32_t>(markers.size());
+        record.Outcome     = ClipOutcome::NO_MARKERS;
 
         if(markers.empty()) {
             return 0;
         }
 
-        m_AppStats.ClipsWithMarkers++;
-        m_AppStats.TotalMarkers += static_cast<int>(markers.size());
+        stats.ClipsWithMarkers++;
+        stats.TotalMarkers += static_cast<int>(markers.size());
+
+        const fs::path xmpFilePath {IsWriteMode(m_AppMode) ? fs::path(clipDir / xmpFileName) : fs::path {}};
 
         if(IsWriteMode(m_AppMode)) {
-            const fs::path xmpFilePath {fs::path(m_ClipDir / xmpFileName)};
-            XmpWriter(xmpFilePath, markers).WriteDestinationXmp();
+            record.Xmp     = XmpWriter(xmpFilePath, markers, fileWriter, context).WriteDestinationXmp();
+            record.Outcome = ClipOutcome::XMP_WRITTEN;
+        } else {
+            record.Outcome = ClipOutcome::MARKERS_LISTED;
+        }
+
+        // While the reader (and what the markers point into) is still around
+        if(m_Records) {
+            RecordWriter::FormatMarkers(m_Options.Format, xmlPath.string(), xmpFilePath.string(), markers, markerRecords);
+        }
+
+        if(m_IndexBuilder) {
+            m_IndexBuilder->AddClip(xmlPath.string(), markers);
+        }
+
+        if(m_Options.KeepMarkers) {
+            std::scoped_lock lock {m_KeptMarkersMutex};
+            keptMarkers = markerStore.Append(markers);
         }
 
         return markers.size();
     }
 
+    void Application::PrintShootReport(const Shoot& shoot) const {
+        for(const ClipResult& result : shoot.Results) {
+            if(!result.Processed) {
+                continue;
+            }
+
+            PrintClipResult(shoot, result);
+            if(result.Fatal) {
+                return;
+            }
+        }
+
+        PrintStats(shoot.Stats, "Clips in the shoot");
+    }
+
+    void Application::PrintClipResult(const Shoot& shoot, const ClipResult& result) const {
+        if(m_Records) {
+            WriteClipRecord(shoot, result);
+
+            // The record says it all; errors are still worth a message
+            if(!result.ErrorCode) {
+                return;
+            }
+        }
+
+        if(!result.ErrorCode) {
+            // Don't print files without markers in them (clutters standard output),
+            // nor the ones whose XMPs were already written by an earlier run
+            if(result.MarkerCount > 0 && !(result.Unchanged && IsWriteMode(m_AppMode))) {
+                PrintFileResult(result.XmlName, result.XmpName, result.MarkerCount);
+            }
+            return;
+        }
+
+        if(result.Fatal) {
+            if(result.ErrorCode == P2ExceptionCode::CODE_FILESYSTEM_ERROR) {
+                ErrorOut() << std::format("Cannot write {}: {}.\n",
+                                         result.XmpName, result.ErrorMessage);
+            } else {
+                ErrorOut() << "System is out of memory.\n";
+            }
+        } else if(IsWriteMode(m_AppMode)) {
+            ErrorOut() << std::format("{} -> <-------->: {}.\n", result.XmlName, result.ErrorMessage);
+        } else {
+            ErrorOut() << std::format("{}: {}.\n", result.XmlName, result.ErrorMessage);
+        }
+    }
+
+    void Application::WriteClipRecord(const Shoot& shoot, const ClipResult& result) const {
+        ClipRecord record {};
+        record.MarkerCount  = result.MarkerCount;
+        record.ErrorCode    = result.ErrorCode;
+        record.ErrorMessage = result.ErrorMessage;
+        record.Outcome      = result.OutcomeName();
+
+        const std::string clipPath {(shoot.ClipDir / result.XmlName).string()};
+        record.Clip = clipPath;
+
+        // Only an XMP that holds the markers is worth pointing to
+        std::string xmpPath {};
+        if(IsWriteMode(m_AppMode) && result.MarkerCount > 0 && !result.ErrorCode) {
+            xmpPath    = (shoot.ClipDir / result.XmpName).string();
+            record.Xmp = xmpPath;
+        }
+
+        m_Records->WriteClip(record, result.MarkerRecords);
+    }
+
+    void Application::FlushRecords() const {
+        if(m_Records) {
+            m_Records->Flush();
+        }
+    }
+
+    std::ostream& Application::TextOut() const {
+        if(m_Options.Silent) {
+            return m_NullOut;
+        }
+
+        return m_Records ? std::cerr : std::cout;
+    }
+
+    std::ostream& Application::ErrorOut() const {
+        return m_Options.Silent ? m_NullOut : std::cerr;
+    }
+
+    void Application::PrintWriteFailures(const std::vector<fs::path>& failed) const {
+        for(const fs::path& xmp : failed) {
+            ErrorOut() << std::format("{}: can't be saved, the previous version is kept.\n",
+                                     xmp.filename().string());
+        }
+    }
+
     void Application::PrintFileResult(std::string_view xmlName,
                                       std::string_view xmpName,
                                       const size_t markerCount) const {
@@ -142,30 +1026,34 @@ namespace p2mark {
         p2mark::StringUtils::MakeSingularIfNeeded(markerNoun, static_cast<int>(markerCount));
 
         if(IsWriteMode(m_AppMode)) {
-            std::cout << std::format("{} -> {}: {} {} written.\n",
+            TextOut() << std::format("{} -> {}: {} {} written.\n",
                                      xmlName, xmpName, markerCount, markerNoun);
         } else {
-            std::cout << std::format("{}: has {} {}.\n",
+            TextOut() << std::format("{}: has {} {}.\n",
                                      xmlName, markerCount, markerNoun);
         }
     }
 
-    void Application::PrintStats() const {
+    void Application::PrintStats(const AppStats& stats, std::string_view clipsLabel) const {
         std::stringstream ss {};
 
-        if(m_AppStats.AreThereMarkers()) ss << "\n";
-        ss << "Clips in the shoot: " << m_AppStats.ClipsFound << "\n";
+        if(stats.AreThereMarkers()) ss << "\n";
+        ss << clipsLabel << ": " << stats.ClipsFound << "\n";
+
+        if(stats.ClipsUnchanged > 0) {
+            ss << "Clips unchanged since the last run: " << stats.ClipsUnchanged << "\n";
+        }
 
-        if(m_AppStats.AreThereMarkers()) {
-            ss << "Clips with markers: " << m_AppStats.ClipsWithMarkers << "\n";
-            ss << "Total number of markers: " << m_AppStats.TotalMarkers << "\n";
+        if(stats.AreThereMarkers()) {
+            ss << "Clips with markers: " << stats.ClipsWithMarkers << "\n";
+            ss << "Total number of markers: " << stats.TotalMarkers << "\n";
 
-            if(m_AppStats.AnyXmlReadErrors()) {
-                ss << "XML read errors: " << m_AppStats.XmlReadErrors << "\n";
+            if(stats.AnyXmlReadErrors()) {
+                ss << "XML read errors: " << stats.XmlReadErrors << "\n";
             }
 
-            if(m_AppStats.AnyXmpWriteErrors()) {
-                ss << "XMP write errors: " << m_AppStats.XmpWriteErrors << "\n";
+            if(stats.AnyXmpWriteErrors()) {
+                ss << "XMP write errors: " << stats.XmpWriteErrors << "\n";
             }
         } else {
             if(IsWriteMode(m_AppMode)) {
@@ -175,6 +1063,20 @@ namespace p2mark {
             }
         }
 
-        std::cout << ss.str();
+        TextOut() << ss.str();
+    }
+
+    void Application::PrintGlobalStats() const {
+        const auto processed {std::count_if(m_Shoots.begin(), m_Shoots.end(), [](const Shoot& shoot) {
+            return shoot.Completed;
+        })};
+        const auto failed {static_cast<std::ptrdiff_t>(m_Shoots.size()) - processed};
+
+        TextOut() << std::format("\nShoots processed: {}\n", processed);
+        if(failed > 0) {
+            TextOut() << std::format("Shoots skipped or stopped: {}\n", failed);
+        }
+
+        PrintStats(m_AppStats, "Clips in all shoots");
     }
 }
\ No newline at end of file
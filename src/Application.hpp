@@ -7,9 +7,20 @@
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
 #include <filesystem>
 #include <format>
+#include <functional>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ostream>
 #include <string>
 #include <string_view>
 #include <thread>
@@ -17,10 +28,23 @@
 
 #include "AppInfo.hpp"
 #include "AppMode.hpp"
-#include "ComGuard.hpp"
+#include "AppOptions.hpp"
+#include "AtomicFileWriter.hpp"
+#include "ClipManifest.hpp"
+#include "ClipPrefetcher.hpp"
+#include "ClipScanner.hpp"
+#include "ClipWatcher.hpp"
 #include "Constants.hpp"
 #include "P2Exception.hpp"
 #include "P2Validator.hpp"
+#include "MarkerIndexBuilder.hpp"
+#include "MarkerStore.hpp"
+#include "ParseContext.hpp"
+#include "RecordWriter.hpp"
+#include "ShootFinder.hpp"
+#include "StageMetrics.hpp"
+#include "TarArchive.hpp"
+#include "WorkerPool.hpp"
 #include "XmlReader.hpp"
 #include "XmpWriter.hpp"
 
@@ -35,10 +59,76 @@ namespace p2mark {
         int TotalMarkers     {0};
         int XmlReadErrors    {0};
         int XmpWriteErrors   {0};
+        int ClipsUnchanged   {0}; // Skipped thanks to the manifest
 
         inline bool AreThereMarkers()   const { return ClipsWithMarkers != 0; }
         inline bool AnyXmlReadErrors()  const { return XmlReadErrors != 0; }
         inline bool AnyXmpWriteErrors() const { return XmpWriteErrors != 0; }
+
+        AppStats& operator+=(const AppStats& other) {
+            ClipsFound       += other.ClipsFound;
+            ClipsWithMarkers += other.ClipsWithMarkers;
+            TotalMarkers     += other.TotalMarkers;
+            XmlReadErrors    += other.XmlReadErrors;
+            XmpWriteErrors   += other.XmpWriteErrors;
+            ClipsUnchanged   += other.ClipsUnchanged;
+            return *this;
+        }
+    };
+
+    /// The outcome of processing a single clip, kept around
+    /// so that parallel runs can still be printed in clip order.
+    struct ClipResult {
+        std::string XmlName {};
+        std::string XmpName {};
+        size_t MarkerCount  {0};
+
+        std::optional<P2ExceptionCode> ErrorCode {};
+        std::string ErrorMessage {};
+
+        bool Processed {false};
+        bool Fatal     {false}; // The whole batch has to stop
+        bool Unchanged {false}; // The outcome of an earlier run was reused
+
+        /// What goes into the manifest once the batch is over
+        std::optional<ManifestEntry> Record {};
+
+        /// --format: the clip's markers, already formatted as records
+        std::string MarkerRecords {};
+
+        /// AppOptions::KeepMarkers: where the clip's markers are in Shoot::Markers
+        MarkerRange Markers {};
+
+        /// What happened to the clip, as the records name it ("xmp_written", "error"...).
+        std::string_view OutcomeName() const;
+    };
+
+    /// One P2 shoot (a CONTENTS directory) and everything found while processing it.
+    struct Shoot {
+        fs::path ContentsDir {};
+        fs::path ClipDir     {};
+        uint64_t DeviceId    {0}; // Shoots on the same device share one I/O lane
+
+        std::string Error {};     // Why the shoot can't be processed, if it can't
+        ClipScanner Scanner {};   // What RetrieveClipFiles() found in CLIP
+        std::vector<fs::path> Clips {};
+        std::vector<ClipResult> Results {};
+        ClipManifest Manifest {};
+        std::unique_ptr<AtomicFileWriter> FileWriter {}; // XMPs and their durability
+        AppStats Stats {};
+        bool Completed {false};
+
+        /// AppOptions::KeepMarkers: the markers of every clip, in the order
+        /// the workers finished them; each result has its range
+        MarkerStore Markers {};
+
+        /// Only for a shoot read from a tar archive (list mode): the archive,
+        /// and the contents of the clips, in the order of Clips
+        fs::path Archive {};
+        std::vector<PrefetchedClip> ArchivedClips {};
+
+        inline bool IsValid() const { return Error.empty(); }
+        inline bool IsArchived() const { return !Archive.empty(); }
     };
 
     class Application {
@@ -52,42 +142,213 @@ namespace p2mark {
     private:
         static inline constexpr size_t YIELD_AFTER {5};
 
+        /// How long watch mode waits for new clips before checking for Ctrl+C.
+        static inline constexpr std::chrono::milliseconds WATCH_TICK {200};
+
+        /// Per-worker statistics, padded to a cache line each,
+        /// so workers never write to a shared line while counting.
+        struct alignas(64) WorkerStats {
+            AppStats Stats {};
+        };
+
     public:
-        explicit Application(const AppMode mode, std::string_view contentsDirPath);
+        /// With a single path an invalid shoot is an error (exception);
+        /// with several of them it is reported and the rest are processed.
+        /// A path to a .tar archive of P2 cards (list mode only) stands for
+        /// every shoot in it; it's read right away, see TarArchive.
+        /// With --format the records go to recordOut.
+        explicit Application(const AppMode mode,
+                             const std::vector<std::string>& contentsDirPaths,
+                             const AppOptions& options = {},
+                             std::ostream& recordOut = std::cout);
 
     public:
-        /// Iterates through the CLIP directory
-        /// and builds a list of valid clips.
+        /// Scans the CLIP directories and finds the valid clips of each shoot.
         void RetrieveClipFiles();
 
-        /// Sort clip paths alphabetically because they appear
-        /// out of order when printed.
+        /// Processes the clips on these workers (one context per worker)
+        /// instead of a pool of its own, so that a process that runs job
+        /// after job keeps its threads and their warm contexts. Several shoots
+        /// are then processed one after another. Call before BatchProcessClips().
+        void UseWorkers(WorkerPool& pool, std::vector<ParseContext>& contexts);
+
+        /// Sorts the clips alphabetically because they appear out of order
+        /// when printed, and builds the clip list of each shoot in that order.
         void SortClipFiles();
 
         /// Parses clips, retrieves a list of markers from them,
         /// and then, depending on the application mode, either writes
         /// these markers to *.XMP files, or just outputs them as a list.
+        /// Several shoots are grouped by the device they live on: each device
+        /// gets its own lane (thread and worker pool), so card readers
+        /// are read in parallel without thrashing each other. The lanes
+        /// split the jobs between them, each one gets at least one worker.
         void BatchProcessClips();
 
+        /// --recursive: looks for shoots everywhere under root (see ShootFinder)
+        /// and processes each one as soon as it's found, while the walk goes on,
+        /// then prints the stats. Construct the application without any paths for it.
+        /// An archive is one device, so the shoots go through a single lane;
+        /// only their stats are kept in Shoots().
+        void ProcessTree(const fs::path& root);
+
+        /// Watch mode: processes the clips of the (only) shoot as soon as
+        /// they have been completely copied into CLIP, until stopRequested()
+        /// returns true, then prints the stats.
+        void WatchClips(const std::function<bool()>& stopRequested);
+
+        /// Writes the counters of every shoot, the per-stage latencies,
+        /// the bytes read and written and the system call counts
+        /// of the run so far as one JSON object, for monitoring.
+        void WriteStatsJson(std::ostream& out) const;
+
+        /// --build-index: writes the markers of every clip read so far
+        /// to the index. Returns false (and says why) if it couldn't.
+        bool SaveMarkerIndex();
+
+        /// The shoots and what was found in them, clip by clip (the clip
+        /// results are only kept when the clips were processed in parallel
+        /// or on UseWorkers() workers, and never by ProcessTree()).
+        inline const std::vector<Shoot>& Shoots() const { return m_Shoots; }
+
+        /// The totals of all the shoots processed so far.
+        inline const AppStats& Stats() const { return m_AppStats; }
+
     private:
-        size_t ProcessSingleClip(const fs::path& clipPath, std::string_view xmpFileName);
+        /// Returns an error message if the path isn't a usable P2 CONTENTS directory.
+        /// An empty CLIP directory is fine in watch mode, the card is still being copied.
+        static std::string ValidateShoot(const fs::path& contentsDir, const bool allowEmptyClipDir);
+
+        /// Validates the shoot and gets its manifest and file writer ready.
+        void OpenShoot(Shoot& shoot, const fs::path& contentsDir) const;
+
+        /// Adds a shoot for every CONTENTS directory in the archive, with its
+        /// clips already read (or one invalid shoot that says what's wrong).
+        /// The shoots have no manifest: nothing can be written into the archive.
+        void OpenArchive(const fs::path& archive);
 
-        /// Print the result for one processed file.
+        void RetrieveClipFiles(Shoot& shoot) const;
+        void SortClipFiles(Shoot& shoot) const;
+
+        /// Processes the shoots of one device, one shoot after another,
+        /// on a pool of its own with that many workers (unless the pool is shared).
+        void RunDeviceLane(const std::vector<Shoot*>& shoots, const size_t workers);
+
+        /// Processes one shoot of a lane and prints its report.
+        void ProcessLaneShoot(Shoot& shoot, WorkerPool& pool, std::vector<ParseContext>& contexts);
+
+        /// Processes clips one by one on the current thread, printing as it goes.
+        /// Returns false if the batch had to be stopped.
+        bool ProcessClipsSequentially(Shoot& shoot) const;
+
+        /// Spreads the clips over the pool's workers, keeping the results
+        /// so they can be printed in the sorted clip order afterwards.
+        /// Returns false if the batch had to be stopped.
+        /// Every worker parses with its own context (one per worker of the pool).
+        bool ProcessClipsInParallel(Shoot& shoot, WorkerPool& pool, std::vector<ParseContext>& contexts) const;
+
+        /// Processes the clip at the given index and turns any
+        /// exception into a result; counters go into the supplied stats.
+        /// The clip is taken from the prefetcher if there is one and it has it.
+        /// Kept markers go into the shoot's store, which is locked for it.
+        ClipResult ProcessClipAt(Shoot& shoot, const size_t index, AppStats& stats, ParseContext& context,
+                                 ClipPrefetcher* prefetcher = nullptr) const;
+
+        /// The clips that will most likely have to be read: the ones
+        /// the manifest doesn't already have an answer for.
+        std::vector<bool> WantedClips(const Shoot& shoot) const;
+
+        /// Fills in the result from the manifest if neither the clip
+        /// nor (in write mode) its XMP changed since an earlier run.
+        bool ReuseRecordedResult(const Shoot& shoot,
+                                 const fs::path& clipPath,
+                                 ClipResult& result,
+                                 AppStats& stats) const;
+
+        /// Listing the markers as records needs the markers themselves,
+        /// which the manifest doesn't have: every clip is read then.
+        /// The same goes for building an index and keeping the markers.
+        bool ReusesResults() const;
+
+        /// Updates the shoot's manifest with what happened to a clip (write modes only).
+        void RecordResult(Shoot& shoot, const ClipResult& result) const;
+
+        /// Puts the shoot's pending XMPs in place, then saves its manifest (write modes only).
+        /// Returns the XMPs that couldn't be put in place (counted as write errors).
+        std::vector<fs::path> FinishWrites(Shoot& shoot) const;
+
+        size_t ProcessSingleClip(const fs::path& clipPath,
+                                 const fs::path& clipDir,
+                                 std::string_view xmpFileName,
+                                 AtomicFileWriter& fileWriter,
+                                 ParseContext& context,
+                                 PrefetchedClip* prefetched,
+                                 AppStats& stats,
+                                 ManifestEntry& record,
+                                 std::string& markerRecords,
+                                 MarkerStore& markerStore,
+                                 MarkerRange& keptMarkers) const;
+
+        /// Prints the kept results and the stats of a shoot processed in parallel.
+        void PrintShootReport(const Shoot& shoot) const;
+
+        /// Print the result (or the error) for one processed file;
+        /// with --format, its records go to the record writer.
+        void PrintClipResult(const Shoot& shoot, const ClipResult& result) const;
+
+        /// Writes the clip's record, after the records of its markers.
+        void WriteClipRecord(const Shoot& shoot, const ClipResult& result) const;
+
+        /// Hands the buffered records over to the standard output.
+        void FlushRecords() const;
+
+        /// Where the messages meant for people go: the standard output,
+        /// unless it carries records (or nowhere, when silent).
+        std::ostream& TextOut() const;
+
+        /// Where the errors go: the standard error, unless silent.
+        std::ostream& ErrorOut() const;
+
+        /// Print the XMPs that FinishWrites() couldn't put in place.
+        void PrintWriteFailures(const std::vector<fs::path>& failed) const;
+
+        /// Print the result for one successfully processed file.
         void PrintFileResult(std::string_view xmlName,
                              std::string_view xmpName,
                              const size_t markerCount) const;
 
         /// Prints the final output.
-        void PrintStats() const;
+        void PrintStats(const AppStats& stats, std::string_view clipsLabel) const;
+
+        /// Prints the totals of a multi-shoot run.
+        void PrintGlobalStats() const;
 
     private:
         const AppMode m_AppMode;
-        const ComGuard m_ComGuard;
-        AppStats m_AppStats;
+        const AppOptions m_Options;
+        const unsigned int m_Jobs;
+        const std::chrono::steady_clock::time_point m_StartTime;
+        AppStats m_AppStats; // Totals across all shoots
+
+        std::vector<Shoot> m_Shoots;
+
+        /// Only with --format ndjson or csv; written under m_OutputMutex
+        std::unique_ptr<RecordWriter> m_Records;
+
+        /// Only with --build-index; the workers add their clips to it
+        std::unique_ptr<MarkerIndexBuilder> m_IndexBuilder;
+
+        /// Only with UseWorkers(); they belong to the caller
+        WorkerPool* m_SharedPool {nullptr};
+        std::vector<ParseContext>* m_SharedContexts {nullptr};
+
+        /// Lanes print whole shoot reports, one at a time
+        std::mutex m_OutputMutex;
 
-        fs::path m_ContentsDir;
-        fs::path m_ClipDir;
+        /// AppOptions::KeepMarkers: the workers of a shoot share its marker store
+        mutable std::mutex m_KeptMarkersMutex;
 
-        std::vector<fs::path> m_Clips;
+        /// AppOptions::Silent: a stream without a buffer drops everything
+        mutable std::ostream m_NullOut {nullptr};
     };
 }
\ No newline at end of file
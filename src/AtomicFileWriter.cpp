@@ -0,0 +1,408 @@
+/*
+* Project: p2mark
+* File:    AtomicFileWriter.cpp
+* Desc:    Crash-safe file replacement implementation file
+* Created: 2026-10-17
+*/
+
+#include "AtomicFileWriter.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <string>
+#include <utility>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "GuidGenerator.hpp"
+#include "StageMetrics.hpp"
+
+#ifdef __linux__
+#include "IoRing.hpp"
+#endif
+
+namespace p2mark {
+    AtomicFileWriter::AtomicFileWriter(const Durability durability, const size_t batchSize) :
+        m_Durability(durability), m_BatchSize(std::max<size_t>(batchSize, 1)) {
+    }
+
+    AtomicFileWriter::~AtomicFileWriter() {
+        // Callers commit themselves; anything left here was cut short by an exception,
+        // so it's dropped and the old versions of the files stay in place
+        for(const PendingRename& pending : m_Pending) {
+            std::error_code ec {};
+            fs::remove(pending.Temp, ec);
+            StageMetrics::CountSyscalls(Syscall::SYSCALL_UNLINK);
+        }
+    }
+
+    bool AtomicFileWriter::Write(const fs::path& target, std::string_view data,
+                                 const bool textMode, FileStamp* stamp) {
+#ifdef _WIN32
+        // What a text mode stream would do: every '\n' gets its '\r'
+        std::string translated {};
+        if(textMode) {
+            translated.reserve(data.size() + static_cast<size_t>(std::count(data.begin(), data.end(), '\n')));
+            for(const char c : data) {
+                if(c == '\n') {
+                    translated.push_back('\r');
+                }
+                translated.push_back(c);
+            }
+            data = translated;
+        }
+#else
+        (void)textMode;
+#endif
+
+        const bool syncNow {m_Durability == Durability::DURABILITY_FULL};
+        fs::path temp {};
+
+        if(!WriteTempFile(target, data, syncNow, temp)) {
+            if(!temp.empty()) {
+                std::error_code ec {};
+                fs::remove(temp, ec);
+                StageMetrics::CountSyscalls(Syscall::SYSCALL_UNLINK);
+            }
+            return false;
+        }
+
+        // The new file shouldn't be any more (or less) accessible than the one it replaces
+        std::error_code ec {};
+        const fs::file_status status {fs::status(target, ec)};
+        StageMetrics::CountSyscalls(Syscall::SYSCALL_STAT);
+        if(!ec && fs::exists(status)) {
+            fs::permissions(temp, status.permissions(), fs::perm_options::replace, ec);
+            StageMetrics::CountSyscalls(Syscall::SYSCALL_CHMOD);
+        }
+
+        // A rename keeps the size and the mtime
+        if(stamp) {
+            ClipManifest::StampFile(temp, *stamp);
+        }
+
+        if(m_Durability != Durability::DURABILITY_BATCH) {
+            if(!ReplaceFile(temp, target, syncNow)) {
+                fs::remove(temp, ec);
+                StageMetrics::CountSyscalls(Syscall::SYSCALL_UNLINK);
+                return false;
+            }
+
+            if(syncNow) {
+                SyncDirectory(target.parent_path());
+            }
+
+            return true;
+        }
+
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Pending.push_back({temp, target});
+
+        if(m_Pending.size() >= m_BatchSize) {
+            CommitPending();
+        }
+
+        return true;
+    }
+
+    std::vector<fs::path> AtomicFileWriter::Commit() {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        CommitPending();
+
+        return std::exchange(m_Failed, {});
+    }
+
+    fs::path AtomicFileWriter::TempPathFor(const fs::path& target) {
+#ifdef _WIN32
+        const unsigned long pid {GetCurrentProcessId()};
+#else
+        const long pid {static_cast<long>(getpid())};
+#endif
+
+        // The first group of a random GUID: 32 random bits
+        GuidGenerator::GuidString guid {};
+        const std::string_view random {GuidGenerator::Generate(guid).substr(0, 8)};
+
+        fs::path temp {target};
+        temp += "." + std::to_string(pid) + "-" + std::string(random);
+        temp += TEMP_SUFFIX;
+        return temp;
+    }
+
+    bool AtomicFileWriter::IsStaleTemp(const fs::path& temp) {
+        std::error_code ec {};
+        const fs::file_time_type writeTime {fs::last_write_time(temp, ec)};
+        StageMetrics::CountSyscalls(Syscall::SYSCALL_STAT);
+
+        return !ec && fs::file_time_type::clock::now() - writeTime > STALE_TEMP_AGE;
+    }
+
+    void AtomicFileWriter::CommitPending() {
+        if(m_Pending.empty()) {
+            return;
+        }
+
+        std::vector<fs::path> dirs {};
+        for(const PendingRename& pending : m_Pending) {
+            const fs::path dir {pending.Target.parent_path()};
+            if(std::find(dirs.begin(), dirs.end(), dir) == dirs.end()) {
+                dirs.push_back(dir);
+            }
+        }
+
+        std::vector<int32_t> results(m_Pending.size(), NOT_RENAMED);
+
+        // 1. The data of every temporary file has to be on the disk
+        //    before any of them replaces a file that is already there.
+        //    Where syncfs() fails, the files are synced one by one instead,
+        //    and one that can't be synced isn't put in place at all
+#ifdef __linux__
+        for(const fs::path& dir : dirs) {
+            if(SyncFilesystem(dir)) {
+                continue;
+            }
+
+            for(size_t i {0}; i < m_Pending.size(); i++) {
+                if(m_Pending[i].Target.parent_path() == dir && !SyncFile(m_Pending[i].Temp)) {
+                    results[i] = NOT_SYNCED;
+                }
+            }
+        }
+#else
+        for(size_t i {0}; i < m_Pending.size(); i++) {
+            if(!SyncFile(m_Pending[i].Temp)) {
+                results[i] = NOT_SYNCED;
+            }
+        }
+#endif
+
+        // 2. Put them in place, all in one submission where io_uring is available
+        RenameThroughRing(results);
+
+        for(size_t i {0}; i < m_Pending.size(); i++) {
+            const PendingRename& pending {m_Pending[i]};
+
+            if(results[i] == NOT_RENAMED) {
+                results[i] = ReplaceFile(pending.Temp, pending.Target, true) ? 0 : -1;
+            }
+
+            if(results[i] != 0) {
+                std::error_code ec {};
+                fs::remove(pending.Temp, ec);
+                StageMetrics::CountSyscalls(Syscall::SYSCALL_UNLINK);
+                m_Failed.push_back(pending.Target);
+            }
+        }
+
+        // 3. And make the renames themselves durable
+        for(const fs::path& dir : dirs) {
+            SyncDirectory(dir);
+        }
+
+        m_Pending.clear();
+    }
+
+    void AtomicFileWriter::RenameThroughRing(std::span<int32_t> results) const {
+#ifdef __linux__
+        IoRing ring(static_cast<unsigned>(std::min(m_Pending.size(), m_BatchSize)));
+        if(!ring.IsOpen()) {
+            return;
+        }
+
+        // Only the files that are safely on the disk; the others keep their result
+        size_t next {0};
+        while(next < m_Pending.size()) {
+            unsigned queued {0};
+
+            for(; next < m_Pending.size() && queued < ring.Capacity(); next++) {
+                if(results[next] != NOT_RENAMED) {
+                    continue;
+                }
+
+                // A full queue: this one goes with the next submission
+                if(!ring.PrepareRename(m_Pending[next].Temp.c_str(), m_Pending[next].Target.c_str(), next)) {
+                    break;
+                }
+                queued++;
+            }
+
+            // Nothing fits at all: the rest are renamed the usual way
+            if(queued == 0 || !ring.SubmitAndWait(results)) {
+                return;
+            }
+        }
+#else
+        (void)results;
+#endif
+    }
+
+#ifdef _WIN32
+    bool AtomicFileWriter::WriteTempFile(const fs::path& target, std::string_view data, const bool sync,
+                                         fs::path& temp) {
+        HANDLE file {INVALID_HANDLE_VALUE};
+
+        // CREATE_NEW never opens what's already there, whatever it is
+        for(unsigned int attempt {0}; attempt < TEMP_NAME_ATTEMPTS && file == INVALID_HANDLE_VALUE; attempt++) {
+            temp = TempPathFor(target);
+            file = CreateFileW(temp.c_str(), GENERIC_WRITE, 0, nullptr,
+                               CREATE_NEW, FILE_ATTRIBUTE_NORMAL, nullptr);
+            StageMetrics::CountSyscalls(Syscall::SYSCALL_OPEN, 2);
+
+            if(file == INVALID_HANDLE_VALUE && GetLastError() != ERROR_FILE_EXISTS) {
+                break;
+            }
+        }
+
+        if(file == INVALID_HANDLE_VALUE) {
+            temp.clear();
+            return false;
+        }
+
+        bool written {true};
+        while(!data.empty()) {
+            const DWORD chunk {static_cast<DWORD>(std::min<size_t>(data.size(), 1U << 30))};
+            DWORD done {0};
+            StageMetrics::CountSyscalls(Syscall::SYSCALL_WRITE);
+            if(!WriteFile(file, data.data(), chunk, &done, nullptr) || done == 0) {
+                written = false;
+                break;
+            }
+            StageMetrics::CountBytesWritten(done);
+            data.remove_prefix(done);
+        }
+
+        if(written && sync) {
+            StageMetrics::CountSyscalls(Syscall::SYSCALL_SYNC);
+            written = FlushFileBuffers(file) != 0;
+        }
+
+        return CloseHandle(file) && written;
+    }
+
+    bool AtomicFileWriter::SyncFile(const fs::path& path) {
+        HANDLE file {CreateFileW(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+                                 OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr)};
+        StageMetrics::CountSyscalls(Syscall::SYSCALL_OPEN, 2);
+        if(file == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+
+        StageMetrics::CountSyscalls(Syscall::SYSCALL_SYNC);
+        const bool synced {FlushFileBuffers(file) != 0};
+        CloseHandle(file);
+        return synced;
+    }
+
+    bool AtomicFileWriter::SyncDirectory(const fs::path&) {
+        // MOVEFILE_WRITE_THROUGH already waited for the renames
+        return true;
+    }
+
+    bool AtomicFileWriter::SyncFilesystem(const fs::path&) {
+        return true;
+    }
+
+    bool AtomicFileWriter::ReplaceFile(const fs::path& temp, const fs::path& target, const bool sync) {
+        StageMetrics::CountSyscalls(Syscall::SYSCALL_RENAME);
+        return MoveFileExW(temp.c_str(), target.c_str(),
+                           MOVEFILE_REPLACE_EXISTING | (sync ? MOVEFILE_WRITE_THROUGH : 0)) != 0;
+    }
+#else
+    bool AtomicFileWriter::WriteTempFile(const fs::path& target, std::string_view data, const bool sync,
+                                         fs::path& temp) {
+        int fd {-1};
+
+        // Never somebody else's file, nor a symlink planted where the temporary file goes
+        for(unsigned int attempt {0}; attempt < TEMP_NAME_ATTEMPTS && fd < 0; attempt++) {
+            temp = TempPathFor(target);
+            fd = open(temp.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0666);
+            StageMetrics::CountSyscalls(Syscall::SYSCALL_OPEN, 2);
+
+            if(fd < 0 && errno != EEXIST) {
+                break;
+            }
+        }
+
+        if(fd < 0) {
+            temp.clear();
+            return false;
+        }
+
+        bool written {true};
+        while(!data.empty()) {
+            const ssize_t done {write(fd, data.data(), data.size())};
+            StageMetrics::CountSyscalls(Syscall::SYSCALL_WRITE);
+            if(done < 0) {
+                if(errno == EINTR) continue;
+                written = false;
+                break;
+            }
+            StageMetrics::CountBytesWritten(static_cast<uint64_t>(done));
+            data.remove_prefix(static_cast<size_t>(done));
+        }
+
+        if(written && sync) {
+            StageMetrics::CountSyscalls(Syscall::SYSCALL_SYNC);
+            written = fsync(fd) == 0;
+        }
+
+        return close(fd) == 0 && written;
+    }
+
+    bool AtomicFileWriter::SyncFile(const fs::path& path) {
+        const int fd {open(path.c_str(), O_RDONLY | O_CLOEXEC)};
+        StageMetrics::CountSyscalls(Syscall::SYSCALL_OPEN, 2);
+        if(fd < 0) {
+            return false;
+        }
+
+        StageMetrics::CountSyscalls(Syscall::SYSCALL_SYNC);
+        const bool synced {fsync(fd) == 0};
+        close(fd);
+        return synced;
+    }
+
+    bool AtomicFileWriter::SyncDirectory(const fs::path& dir) {
+        const int fd {open(dir.empty() ? "." : dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC)};
+        StageMetrics::CountSyscalls(Syscall::SYSCALL_OPEN, 2);
+        if(fd < 0) {
+            return false;
+        }
+
+        StageMetrics::CountSyscalls(Syscall::SYSCALL_SYNC);
+        const bool synced {fsync(fd) == 0};
+        close(fd);
+        return synced;
+    }
+
+    bool AtomicFileWriter::SyncFilesystem(const fs::path& dir) {
+#ifdef __linux__
+        const int fd {open(dir.empty() ? "." : dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC)};
+        StageMetrics::CountSyscalls(Syscall::SYSCALL_OPEN, 2);
+        if(fd < 0) {
+            return false;
+        }
+
+        StageMetrics::CountSyscalls(Syscall::SYSCALL_SYNC);
+        const bool synced {syncfs(fd) == 0};
+        close(fd);
+        return synced;
+#else
+        (void)dir;
+        return false;
+#endif
+    }
+
+    bool AtomicFileWriter::ReplaceFile(const fs::path& temp, const fs::path& target, const bool) {
+        StageMetrics::CountSyscalls(Syscall::SYSCALL_RENAME);
+        return ::rename(temp.c_str(), target.c_str()) == 0;
+    }
+#endif
+}
\ No newline at end of file
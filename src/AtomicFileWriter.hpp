@@ -0,0 +1,120 @@
+/*
+* Project: p2mark
+* File:    AtomicFileWriter.hpp
+* Desc:    Crash-safe file replacement header file
+* Created: 2026-10-17
+*/
+
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <cstdint>
+#include <mutex>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "ClipManifest.hpp"
+#include "Durability.hpp"
+
+namespace fs = std::filesystem;
+
+namespace p2mark {
+    /// Replaces files without ever leaving a half-written one behind:
+    /// the data goes into a temporary file next to the target,
+    /// which is then renamed over it.
+    /// How much syncing that takes depends on the durability:
+    /// with DURABILITY_BATCH the renames are held back and done in groups:
+    /// the temporary files are synced, then renamed, then the directory is synced.
+    /// On Linux one syncfs() covers all the temporary files of a file system,
+    /// so a shoot of a hundred XMPs costs a couple of syncs instead of a couple
+    /// of hundred. Windows has no such call and syncs every file on its own;
+    /// there batching only saves the directory syncs (done by the renames).
+    /// Can be shared between threads.
+    class AtomicFileWriter {
+    public:
+        /// Ends the temporary file's name: the target's name, the process id
+        /// and a random part, so writers that overlap never share one.
+        /// The scanner ignores them, and stale leftovers from a crash are cleaned up.
+        static inline constexpr std::string_view TEMP_SUFFIX {".p2tmp"};
+
+        /// A temporary file this old is a leftover; a live writer renames its own long before.
+        static inline constexpr std::chrono::hours STALE_TEMP_AGE {1};
+
+        /// Pending renames that trigger a commit in batch mode.
+        static inline constexpr size_t DEFAULT_BATCH_SIZE {64};
+
+    public:
+        explicit AtomicFileWriter(const Durability durability,
+                                  const size_t batchSize = DEFAULT_BATCH_SIZE);
+
+        /// Callers have to Commit() themselves. Whatever is still pending here
+        /// (an exception cut the writes short) is dropped: the temporary files
+        /// are removed and the targets keep their old versions.
+        ~AtomicFileWriter();
+
+        AtomicFileWriter(const AtomicFileWriter&) = delete;
+        AtomicFileWriter& operator=(const AtomicFileWriter&) = delete;
+
+    public:
+        /// Writes the data to the target's temporary file. Without batching
+        /// it replaces the target straight away, otherwise only once the batch
+        /// is committed. In text mode '\n' becomes the platform's line break.
+        /// The stamp (if any) is the one the target will have once it's
+        /// in place. Returns false if the data couldn't be written.
+        bool Write(const fs::path& target, std::string_view data,
+                   const bool textMode = false, FileStamp* stamp = nullptr);
+
+        /// Syncs and renames everything pending. Returns the targets that
+        /// couldn't be replaced since the last call (including the batches
+        /// committed along the way); their old versions are intact.
+        std::vector<fs::path> Commit();
+
+        inline Durability GetDurability() const { return m_Durability; }
+
+        /// A new, unique temporary file name for the target.
+        static fs::path TempPathFor(const fs::path& target);
+
+        /// Whether a leftover temporary file is old enough to be removed
+        /// without pulling it out from under a writer that is still running.
+        static bool IsStaleTemp(const fs::path& temp);
+
+    private:
+        static inline constexpr int32_t NOT_RENAMED {1};
+        static inline constexpr unsigned int TEMP_NAME_ATTEMPTS {4};
+        static inline constexpr int32_t NOT_SYNCED  {2}; // Never renamed: its data may not be on the disk
+
+        struct PendingRename {
+            fs::path Temp   {};
+            fs::path Target {};
+        };
+
+        /// Has to be called with the mutex held.
+        void CommitPending();
+
+        /// Creates a new temporary file for the target (its path goes to temp)
+        /// and writes the data to it. temp is left empty if none could be created.
+        static bool WriteTempFile(const fs::path& target, std::string_view data, const bool sync,
+                                  fs::path& temp);
+        static bool SyncFile(const fs::path& path);
+        static bool SyncDirectory(const fs::path& dir);
+
+        /// Makes everything written to the filesystem the directory lives on durable.
+        static bool SyncFilesystem(const fs::path& dir);
+
+        static bool ReplaceFile(const fs::path& temp, const fs::path& target, const bool sync);
+
+        /// Submits the pending renames still NOT_RENAMED to io_uring at once (Linux).
+        /// Whatever it couldn't submit stays NOT_RENAMED in the results.
+        void RenameThroughRing(std::span<int32_t> results) const;
+
+    private:
+        const Durability m_Durability;
+        const size_t m_BatchSize;
+
+        std::mutex m_Mutex;
+        std::vector<PendingRename> m_Pending {};
+        std::vector<fs::path> m_Failed {};
+    };
+}
\ No newline at end of file
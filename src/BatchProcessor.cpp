@@ -0,0 +1,148 @@
+/*
+* Project: p2mark
+* File:    BatchProcessor.cpp
+* Desc:    In-process batch API of libp2mark implementation file
+* Created: 2026-10-17
+*/
+
+#include "BatchProcessor.hpp"
+
+#include <algorithm>
+#include <format>
+#include <new>
+#include <system_error>
+#include <thread>
+
+#include "XmlReader.hpp"
+
+namespace p2mark {
+    namespace {
+        /// The CONTENTS directory (of those given) that the path is in, or the path itself.
+        std::string ShootOf(const std::vector<std::string>& contentsDirPaths, const fs::path& path) {
+            const fs::path normalPath {path.lexically_normal()};
+
+            for(const std::string& contentsDir : contentsDirPaths) {
+                fs::path normalDir {fs::path(contentsDir).lexically_normal()};
+                if(normalDir.filename().empty()) {
+                    normalDir = normalDir.parent_path(); // "CONTENTS/"
+                }
+
+                const auto [dirEnd, pathEnd] {std::mismatch(normalDir.begin(), normalDir.end(),
+                                                            normalPath.begin(), normalPath.end())};
+                if(dirEnd == normalDir.end()) {
+                    return contentsDir;
+                }
+            }
+
+            return path.string();
+        }
+    }
+
+    BatchProcessor::BatchProcessor(const unsigned int jobs) :
+        m_Pool(jobs == 0 ? std::max(1U, std::thread::hardware_concurrency()) : jobs),
+        m_Contexts(m_Pool.WorkerCount()) {}
+
+    BatchReport BatchProcessor::ProcessShoots(const std::vector<std::string>& contentsDirPaths,
+                                              const AppMode mode,
+                                              const AppOptions& options) {
+        AppOptions appOptions {options};
+        appOptions.Jobs        = static_cast<unsigned int>(m_Pool.WorkerCount());
+        appOptions.Watch       = false;
+        appOptions.Format      = OutputFormat::FORMAT_TEXT;
+        appOptions.Silent      = true;
+        appOptions.KeepMarkers = true;
+
+        BatchReport report {};
+
+        try {
+            Application app(mode, contentsDirPaths, appOptions);
+
+            app.UseWorkers(m_Pool, m_Contexts);
+            app.RetrieveClipFiles();
+            app.SortClipFiles();
+            app.BatchProcessClips();
+            if(!app.SaveMarkerIndex()) {
+                report.IndexError = std::format("Cannot write the marker index to {}", appOptions.IndexPath.string());
+            }
+
+            report.Totals = app.Stats();
+
+            for(const Shoot& shoot : app.Shoots()) {
+                ShootReport& shootReport {report.Shoots.emplace_back()};
+                shootReport.ContentsDir = shoot.ContentsDir.string();
+                shootReport.Error       = shoot.Error;
+                shootReport.Completed   = shoot.Completed;
+                shootReport.Stats       = shoot.Stats;
+                shootReport.Markers     = shoot.Markers;
+
+                if(shoot.IsValid() && shoot.Clips.empty()) {
+                    shootReport.Error = "No clips found";
+                }
+
+                for(const ClipResult& result : shoot.Results) {
+                    if(!result.Processed) {
+                        continue;
+                    }
+
+                    ClipReport& clip {shootReport.Clips.emplace_back()};
+                    clip.Clip         = (shoot.ClipDir / result.XmlName).string();
+                    clip.Outcome      = result.OutcomeName();
+                    clip.MarkerCount  = result.MarkerCount;
+                    clip.Markers      = result.Markers;
+                    clip.ErrorCode    = result.ErrorCode;
+                    clip.ErrorMessage = result.ErrorMessage;
+
+                    if(IsWriteMode(mode) && result.MarkerCount > 0 && !result.ErrorCode) {
+                        clip.Xmp = (shoot.ClipDir / result.XmpName).string();
+                    }
+                }
+            }
+        } catch(const P2Exception& e) {
+            // Only a batch of one shoot stops at an unusable shoot; several shoots
+            // report theirs one by one, so there's no telling whose this would be
+            if(contentsDirPaths.size() == 1) {
+                ShootReport& shootReport {report.Shoots.emplace_back()};
+                shootReport.ContentsDir = contentsDirPaths.front();
+                shootReport.Error       = e.what();
+            } else {
+                report.Error = e.what();
+            }
+        } catch(const fs::filesystem_error& e) {
+            ShootReport& shootReport {report.Shoots.emplace_back()};
+            shootReport.ContentsDir = ShootOf(contentsDirPaths, e.path1());
+            shootReport.Error       = std::format("Cannot access path: {}", e.path1().string());
+        } catch(const std::bad_alloc&) {
+            report.Error = "Out of memory";
+        } catch(const std::system_error& e) {
+            // A device lane's workers couldn't be started
+            report.Error = e.what();
+        }
+
+        return report;
+    }
+
+    ClipReport BatchProcessor::ParseClip(std::string_view xml, MarkerStore& markers, std::string_view name) {
+        ClipReport report {};
+        report.Clip = name;
+
+        try {
+            m_ClipBuffer.assign(xml);
+
+            // The buffer and the context's read buffer trade places
+            XmlReader reader(fs::path(name), m_ClipBuffer, m_Contexts.front());
+            report.Markers = reader.ParseInto(markers);
+
+            report.MarkerCount = report.Markers.Count;
+            report.Outcome     = report.Markers.IsEmpty() ? "no_markers" : "markers_listed";
+        } catch(const P2Exception& e) {
+            report.Outcome      = "error";
+            report.ErrorCode    = e.code();
+            report.ErrorMessage = e.what();
+        } catch(const std::bad_alloc&) {
+            report.Outcome   = "error";
+            report.ErrorCode = P2ExceptionCode::CODE_GENERIC;
+        }
+
+        return report;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,92 @@
+/*
+* Project: p2mark
+* File:    BatchProcessor.hpp
+* Desc:    In-process batch API of libp2mark header file
+* Created: 2026-10-17
+*/
+
+#pragma once
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "AppMode.hpp"
+#include "AppOptions.hpp"
+#include "Application.hpp"
+#include "MarkerStore.hpp"
+#include "P2Exception.hpp"
+#include "ParseContext.hpp"
+#include "WorkerPool.hpp"
+
+namespace p2mark {
+    /// What happened to one clip.
+    struct ClipReport {
+        std::string Clip {};         // The full path of the clip file (or the name of a buffer)
+        std::string Xmp {};          // The XMP that holds its markers, if one was written
+        std::string_view Outcome {}; // "xmp_written", "markers_listed", "no_markers", "unchanged" or "error"
+        size_t MarkerCount {0};
+
+        /// Where its markers are in the shoot's (or ParseClip()'s) store.
+        /// Empty for clips whose XMPs an earlier run already wrote:
+        /// those aren't read again (see AppOptions::Force).
+        MarkerRange Markers {};
+
+        std::optional<P2ExceptionCode> ErrorCode {};
+        std::string ErrorMessage {};
+    };
+
+    /// What happened to one shoot, clip by clip in the sorted clip order.
+    struct ShootReport {
+        std::string ContentsDir {};
+        std::string Error {}; // Why it couldn't be processed, if it couldn't
+        bool Completed {false};
+        AppStats Stats {};
+        std::vector<ClipReport> Clips {};
+
+        /// The markers of all its clips; shoot.Markers.View(clip.Markers) reads a clip's
+        MarkerStore Markers {};
+    };
+
+    struct BatchReport {
+        std::vector<ShootReport> Shoots {};
+        AppStats Totals {};
+        std::string IndexError {}; // Why the marker index (AppOptions::IndexPath) couldn't be written, if it couldn't
+        std::string Error {};      // Why the batch stopped partway (out of memory, no threads, an error of no one shoot), if it did
+    };
+
+    /// Processes shoots (or single clips held in memory) inside the calling
+    /// program, with nothing printed and nothing thrown: everything comes back
+    /// in the reports. This is what libp2mark offers to programs that would
+    /// otherwise run p2mark and read its output. Only the constructor throws
+    /// (std::system_error when the worker threads can't be started).
+    /// The workers and their parse contexts are kept from one call to the next.
+    /// One call at a time: use one processor per thread that needs one.
+    class BatchProcessor {
+    public:
+        /// jobs clips are processed in parallel (0 means every CPU core).
+        explicit BatchProcessor(const unsigned int jobs = 1);
+
+        BatchProcessor(const BatchProcessor&) = delete;
+        BatchProcessor& operator=(const BatchProcessor&) = delete;
+
+    public:
+        /// Does what the command line does with these CONTENTS directories.
+        /// Of the options, Force, XmpDurability and IndexPath apply;
+        /// the rest are the processor's business.
+        BatchReport ProcessShoots(const std::vector<std::string>& contentsDirPaths,
+                                  const AppMode mode,
+                                  const AppOptions& options = {});
+
+        /// Reads the markers out of a clip file's contents; nothing is written.
+        /// They're added to the store, so the markers of many clips can be
+        /// kept in one. The name only goes into the report.
+        ClipReport ParseClip(std::string_view xml, MarkerStore& markers, std::string_view name = {});
+
+    private:
+        WorkerPool m_Pool;
+        std::vector<ParseContext> m_Contexts;
+        std::string m_ClipBuffer {}; // ParseClip()'s copy of the contents, swapped with a context's
+    };
+}
\ No newline at end of file
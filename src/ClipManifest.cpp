@@ -0,0 +1,245 @@
+/*
+* Project: p2mark
+* File:    ClipManifest.cpp
+* Desc:    Per-shoot record of already processed clips implementation file
+* Created: 2026-10-17
+*/
+
+#include "ClipManifest.hpp"
+
+#include <fstream>
+#include <iterator>
+#include <system_error>
+#include <type_traits>
+
+#include "AtomicFileWriter.hpp"
+#include "MappedFile.hpp"
+#include "StageMetrics.hpp"
+
+namespace p2mark {
+    // The manifest is stored little-endian whatever the host,
+    // so a card can travel between machines
+    template<typename T>
+    static void PutValue(std::string& out, const T value) {
+        auto bits {static_cast<std::make_unsigned_t<T>>(value)};
+
+        for(size_t i {0}; i < sizeof(T); i++) {
+            out.push_back(static_cast<char>(bits & 0xFF));
+            bits = static_cast<decltype(bits)>(bits >> 8);
+        }
+    }
+
+    template<typename T>
+    static bool GetValue(std::string_view& in, T& value) {
+        if(in.size() < sizeof(T)) {
+            return false;
+        }
+
+        std::make_unsigned_t<T> bits {0};
+        for(size_t i {0}; i < sizeof(T); i++) {
+            bits |= static_cast<std::make_unsigned_t<T>>(static_cast<unsigned char>(in[i])) << (8 * i);
+        }
+
+        value = static_cast<T>(bits);
+        in.remove_prefix(sizeof(T));
+        return true;
+    }
+
+    static void PutStamp(std::string& out, const FileStamp& stamp) {
+        PutValue(out, stamp.Size);
+        PutValue(out, stamp.WriteTime);
+    }
+
+    static bool GetStamp(std::string_view& in, FileStamp& stamp) {
+        return GetValue(in, stamp.Size) && GetValue(in, stamp.WriteTime);
+    }
+
+    ClipManifest::ClipManifest(const fs::path& clipDir) :
+        m_FilePath(clipDir / ClipManifest::FILE_NAME) {}
+
+    void ClipManifest::Load() {
+        m_Entries.clear();
+        m_Dirty = false;
+
+        std::ifstream file(m_FilePath, std::ios::binary);
+        if(!file.is_open()) {
+            return;
+        }
+
+        const std::string contents {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+        std::string_view in {contents};
+
+        StageMetrics::CountSyscalls(Syscall::SYSCALL_OPEN, 2);
+        StageMetrics::CountSyscalls(Syscall::SYSCALL_READ);
+        StageMetrics::CountBytesRead(contents.size());
+
+        uint16_t version {0};
+        uint32_t count   {0};
+
+        if(!in.starts_with(ClipManifest::MAGIC)) {
+            return;
+        }
+
+        in.remove_prefix(ClipManifest::MAGIC.size());
+        if(!GetValue(in, version) || version != ClipManifest::VERSION || !GetValue(in, count)) {
+            return;
+        }
+
+        for(uint32_t i {0}; i < count; i++) {
+            uint16_t nameLength {0};
+            uint8_t outcome     {0};
+            ManifestEntry entry {};
+
+            if(!GetValue(in, nameLength) || in.size() < nameLength) {
+                m_Entries.clear();
+                return;
+            }
+
+            const std::string_view name {in.substr(0, nameLength)};
+            in.remove_prefix(nameLength);
+
+            if(!GetStamp(in, entry.Clip) ||
+               !GetValue(in, entry.ContentHash) ||
+               !GetValue(in, entry.MarkerCount) ||
+               !GetValue(in, outcome) ||
+               !GetStamp(in, entry.Xmp) ||
+               outcome < static_cast<uint8_t>(ClipOutcome::MARKERS_LISTED) ||
+               outcome > static_cast<uint8_t>(ClipOutcome::NO_MARKERS)) {
+                m_Entries.clear();
+                return;
+            }
+
+            // Left by an older version that recorded listings; it says nothing about the XMP
+            if(outcome == static_cast<uint8_t>(ClipOutcome::MARKERS_LISTED)) {
+                continue;
+            }
+
+            entry.Outcome = static_cast<ClipOutcome>(outcome);
+            m_Entries.insert_or_assign(std::string(name), entry);
+        }
+    }
+
+    bool ClipManifest::Save() {
+        if(!m_Dirty || m_FilePath.empty()) {
+            return true;
+        }
+
+        std::string out {};
+        out.reserve(ClipManifest::MAGIC.size() + 6 + m_Entries.size() * 64);
+        out.append(ClipManifest::MAGIC);
+        PutValue(out, ClipManifest::VERSION);
+        PutValue(out, static_cast<uint32_t>(m_Entries.size()));
+
+        for(const auto& [name, entry] : m_Entries) {
+            PutValue(out, static_cast<uint16_t>(name.size()));
+            out.append(name);
+            PutStamp(out, entry.Clip);
+            PutValue(out, entry.ContentHash);
+            PutValue(out, entry.MarkerCount);
+            PutValue(out, static_cast<uint8_t>(entry.Outcome));
+            PutStamp(out, entry.Xmp);
+        }
+
+        // Write it next to the old one and swap, so an interrupted run
+        // never leaves a half-written manifest behind; like a temporary XMP,
+        // whatever it leaves is cleaned up by a later write run
+        const fs::path tempPath {AtomicFileWriter::TempPathFor(m_FilePath)};
+
+        {
+            std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+            if(!file.is_open() || !file.write(out.data(), static_cast<std::streamsize>(out.size()))) {
+                return false;
+            }
+        }
+
+        StageMetrics::CountSyscalls(Syscall::SYSCALL_OPEN, 2);
+        StageMetrics::CountSyscalls(Syscall::SYSCALL_WRITE);
+        StageMetrics::CountSyscalls(Syscall::SYSCALL_RENAME);
+        StageMetrics::CountBytesWritten(out.size());
+
+        std::error_code ec {};
+        fs::rename(tempPath, m_FilePath, ec);
+        if(ec) {
+            fs::remove(tempPath, ec);
+            StageMetrics::CountSyscalls(Syscall::SYSCALL_UNLINK);
+            return false;
+        }
+
+        m_Dirty = false;
+        return true;
+    }
+
+    void ClipManifest::Clear() {
+        m_Dirty = m_Dirty || !m_Entries.empty();
+        m_Entries.clear();
+    }
+
+    const ManifestEntry* ClipManifest::Find(std::string_view clipName) const {
+        auto it {m_Entries.find(clipName)};
+        return it != m_Entries.end() ? &it->second : nullptr;
+    }
+
+    void ClipManifest::Record(std::string_view clipName, const ManifestEntry& entry) {
+        // Clip names are short (0001AB.XML); a name too long for the manifest just isn't remembered
+        if(clipName.size() > UINT16_MAX) {
+            return;
+        }
+
+        auto it {m_Entries.find(clipName)};
+        if(it == m_Entries.end()) {
+            m_Entries.emplace(std::string(clipName), entry);
+        } else {
+            it->second = entry;
+        }
+
+        m_Dirty = true;
+    }
+
+    void ClipManifest::Forget(std::string_view clipName) {
+        auto it {m_Entries.find(clipName)};
+        if(it != m_Entries.end()) {
+            m_Entries.erase(it);
+            m_Dirty = true;
+        }
+    }
+
+    bool ClipManifest::StampFile(const fs::path& path, FileStamp& stamp) {
+        std::error_code ec {};
+        StageMetrics::CountSyscalls(Syscall::SYSCALL_STAT, 2);
+
+        const uintmax_t size {fs::file_size(path, ec)};
+        if(ec) {
+            return false;
+        }
+
+        const fs::file_time_type writeTime {fs::last_write_time(path, ec)};
+        if(ec) {
+            return false;
+        }
+
+        stamp.Size      = static_cast<uint64_t>(size);
+        stamp.WriteTime = static_cast<int64_t>(writeTime.time_since_epoch().count());
+        return true;
+    }
+
+    uint64_t ClipManifest::HashContents(std::string_view data) {
+        uint64_t hash {14695981039346656037ULL};
+
+        for(const char c : data) {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 1099511628211ULL;
+        }
+
+        return hash;
+    }
+
+    bool ClipManifest::HashFile(const fs::path& path, uint64_t& hash) {
+        MappedFile file {};
+        if(!file.Open(path)) {
+            return false;
+        }
+
+        hash = HashContents(file.View());
+        return true;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,86 @@
+/*
+* Project: p2mark
+* File:    ClipManifest.hpp
+* Desc:    Per-shoot record of already processed clips header file
+* Created: 2026-10-17
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <string>
+#include <string_view>
+
+namespace fs = std::filesystem;
+
+namespace p2mark {
+    /// What a run did with a clip that went through without errors.
+    enum class ClipOutcome : uint8_t {
+        MARKERS_LISTED = 1, // Parsed in list mode, nothing was written (never in a manifest)
+        XMP_WRITTEN,        // Markers were written into the XMP
+        NO_MARKERS          // Nothing to write, in either mode
+    };
+
+    /// Size and modification time: enough to tell that a file wasn't touched.
+    struct FileStamp {
+        uint64_t Size     {0};
+        int64_t WriteTime {0};
+
+        bool operator==(const FileStamp&) const = default;
+    };
+
+    struct ManifestEntry {
+        FileStamp Clip       {};
+        uint64_t ContentHash {0}; // Of the clip file, for when only its mtime changed
+        uint32_t MarkerCount {0};
+        ClipOutcome Outcome  {ClipOutcome::NO_MARKERS};
+        FileStamp Xmp        {}; // Only for XMP_WRITTEN
+    };
+
+    /// A compact on-disk record of the clips of one shoot that were already
+    /// processed, so re-runs on the same shoot can skip the unchanged ones
+    /// with a couple of stat() calls instead of parsing them again.
+    /// It lives next to the XMPs in CLIP, where camcorders ignore foreign files.
+    /// A missing, damaged or outdated manifest is simply treated as empty.
+    class ClipManifest {
+    public:
+        static inline constexpr std::string_view FILE_NAME {"p2mark.manifest"};
+
+    private:
+        static inline constexpr std::string_view MAGIC   {"P2MARK"};
+        static inline constexpr uint16_t VERSION         {2}; // 2: 16-bit name lengths
+
+    public:
+        ClipManifest() = default;
+        explicit ClipManifest(const fs::path& clipDir);
+
+    public:
+        void Load();
+
+        /// Replaces the manifest on disk if anything was recorded.
+        /// Returns false if it couldn't be written (e.g. a write-protected card).
+        bool Save();
+
+        /// Forgets everything the previous runs recorded.
+        void Clear();
+
+        const ManifestEntry* Find(std::string_view clipName) const;
+        void Record(std::string_view clipName, const ManifestEntry& entry);
+        void Forget(std::string_view clipName);
+
+        /// Returns false if the file can't be accessed.
+        static bool StampFile(const fs::path& path, FileStamp& stamp);
+
+        /// 64-bit FNV-1a.
+        static uint64_t HashContents(std::string_view data);
+        static bool HashFile(const fs::path& path, uint64_t& hash);
+
+    private:
+        fs::path m_FilePath {};
+        std::map<std::string, ManifestEntry, std::less<>> m_Entries {};
+        bool m_Dirty {false};
+    };
+}
\ No newline at end of file
@@ -0,0 +1,263 @@
+/*
+* Project: p2mark
+* File:    ClipPrefetcher.cpp
+* Desc:    Batched clip file reader implementation file
+* Created: 2026-10-17
+*/
+
+#include "ClipPrefetcher.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <utility>
+
+#include "P2Validator.hpp"
+#include "StageMetrics.hpp"
+
+#ifdef __linux__
+#include <cerrno>
+
+#include <unistd.h>
+
+#include "IoRing.hpp"
+#endif
+
+namespace p2mark {
+#ifdef __linux__
+    namespace {
+        /// The calling thread's ring, set up the first time the thread loads
+        /// a window and kept for all of its windows after that (and closed
+        /// when the thread ends).
+        std::unique_ptr<IoRing>& ThreadRing() {
+            // The ring counts its system calls until it's closed, so the thread's metrics
+            // shard has to be set up first: thread_locals are destroyed in reverse order
+            StageMetrics::CountSyscalls(Syscall::SYSCALL_RING, 0);
+
+            thread_local std::unique_ptr<IoRing> ring {};
+            if(!ring) {
+                ring = std::make_unique<IoRing>(static_cast<unsigned>(ClipPrefetcher::WINDOW_SIZE * 2));
+            }
+            return ring;
+        }
+
+        /// Gives up on the thread's ring while the kernel may still write to
+        /// what its requests point to: neither the ring nor those buffers are
+        /// ever freed, and the thread sets up a new ring next time.
+        template<typename T>
+        void AbandonRing(T&& targets) {
+            (void)ThreadRing().release();
+            (void)new T(std::move(targets)); // Moving a vector keeps its elements where they are
+        }
+    }
+#endif
+
+    ClipPrefetcher::ClipPrefetcher(std::span<const fs::path> clips, const std::vector<bool>& wanted) :
+        m_Clips(clips), m_Wanted(wanted),
+        m_Windows((clips.size() + ClipPrefetcher::WINDOW_SIZE - 1) / ClipPrefetcher::WINDOW_SIZE) {
+#ifdef __linux__
+        m_Enabled = true;
+        m_Spares.reserve(ClipPrefetcher::SPARE_BUFFERS_LIMIT);
+#endif
+    }
+
+    std::optional<PrefetchedClip> ClipPrefetcher::Take(const size_t index) {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+
+        if(!m_Enabled || index >= m_Clips.size() || !m_Wanted[index]) {
+            return std::nullopt;
+        }
+
+        Window& window {m_Windows[index / ClipPrefetcher::WINDOW_SIZE]};
+        const size_t first {index - index % ClipPrefetcher::WINDOW_SIZE};
+
+        if(window.State == WindowState::EMPTY) {
+            window.State = WindowState::LOADING;
+
+            const size_t count {std::min(ClipPrefetcher::WINDOW_SIZE, m_Clips.size() - first)};
+            std::vector<std::string> spares {};
+            while(!m_Spares.empty() && spares.size() < count) {
+                spares.emplace_back(std::move(m_Spares.back()));
+                m_Spares.pop_back();
+            }
+
+            // The other windows can be taken from (or loaded) in the meantime
+            lock.unlock();
+            std::vector<std::optional<PrefetchedClip>> loaded {};
+            try {
+                loaded = LoadWindow(first, count, spares);
+            } catch(...) {
+                // Nobody may be left waiting: the window's clips are read the usual way
+                lock.lock();
+                window.State = WindowState::READY;
+                m_WindowLoaded.notify_all();
+                throw;
+            }
+            lock.lock();
+
+            for(std::string& spare : spares) {
+                if(m_Spares.size() < ClipPrefetcher::SPARE_BUFFERS_LIMIT) {
+                    m_Spares.emplace_back(std::move(spare));
+                }
+            }
+
+            // No ring: no point in trying again for the other windows
+            if(loaded.empty()) {
+                m_Enabled = false;
+            }
+
+            window.Clips = std::move(loaded);
+            window.State = WindowState::READY;
+            m_WindowLoaded.notify_all();
+        } else {
+            m_WindowLoaded.wait(lock, [&window]() { return window.State == WindowState::READY; });
+        }
+
+        if(index - first >= window.Clips.size()) {
+            return std::nullopt;
+        }
+
+        return std::exchange(window.Clips[index - first], std::nullopt);
+    }
+
+    void ClipPrefetcher::Recycle(std::string&& buffer) {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        if(m_Enabled && buffer.capacity() > std::string().capacity() && m_Spares.size() < ClipPrefetcher::SPARE_BUFFERS_LIMIT) {
+            m_Spares.emplace_back(std::move(buffer));
+        }
+    }
+
+    std::vector<std::optional<PrefetchedClip>> ClipPrefetcher::LoadWindow(const size_t first,
+                                                                          const size_t count,
+                                                                          std::vector<std::string>& spares) const {
+        std::vector<std::optional<PrefetchedClip>> clips(count);
+
+#ifdef __linux__
+        if(std::none_of(m_Wanted.begin() + first, m_Wanted.begin() + first + count, std::identity {})) {
+            return clips;
+        }
+
+        IoRing& ring {*ThreadRing()};
+        if(!ring.IsOpen()) {
+            return {};
+        }
+
+        std::vector<struct statx> stats(count);
+        std::vector<int32_t> results(count * 2, -ECANCELED);
+
+        // 1. Stat and open every wanted clip of the window.
+        //    Whatever doesn't fit in the ring keeps -ECANCELED and is read the usual way
+        for(size_t i {0}; i < count; i++) {
+            if(m_Wanted[first + i]) {
+                const char* path {m_Clips[first + i].c_str()};
+                if(ring.PrepareStatx(path, STATX_SIZE | STATX_MTIME, &stats[i], i * 2)) {
+                    ring.PrepareOpen(path, O_RDONLY, i * 2 + 1);
+                }
+            }
+        }
+
+        if(!ring.SubmitAndWait(results)) {
+            if(!ring.Drain(results)) {
+                AbandonRing(std::move(stats));
+                return {};
+            }
+            for(size_t i {0}; i < count; i++) {
+                if(results[i * 2 + 1] >= 0) {
+                    close(results[i * 2 + 1]);
+                }
+            }
+            return {};
+        }
+
+        // 2. Read every clip that could be opened in one go, and close it right after.
+        //    The buffers come first: nothing may be queued yet if one can't be had
+        std::vector<int32_t> readResults(count * 2, -ECANCELED);
+
+        try {
+            for(size_t i {0}; i < count; i++) {
+                if(results[i * 2 + 1] < 0) {
+                    continue;
+                }
+
+                const struct statx& st {stats[i]};
+                const bool stated {results[i * 2] == 0 &&
+                                   (st.stx_mask & (STATX_SIZE | STATX_MTIME)) == (STATX_SIZE | STATX_MTIME)};
+
+                if(stated && st.stx_size > 0 && st.stx_size <= P2Validator::CLIP_SIZE_LIMIT_MB * 1024 * 1024) {
+                    // The same stamp fs::last_write_time() would give
+                    const std::chrono::sys_time<std::chrono::nanoseconds> writeTime {
+                        std::chrono::seconds(st.stx_mtime.tv_sec) + std::chrono::nanoseconds(st.stx_mtime.tv_nsec)
+                    };
+
+                    PrefetchedClip& clip {clips[i].emplace()};
+                    clip.Stamp.Size      = st.stx_size;
+                    clip.Stamp.WriteTime = static_cast<int64_t>(
+                        std::chrono::file_clock::from_sys(writeTime).time_since_epoch().count());
+
+                    if(!spares.empty()) {
+                        clip.Data = std::move(spares.back());
+                        spares.pop_back();
+                    }
+                    clip.Data.resize(static_cast<size_t>(st.stx_size));
+                }
+            }
+        } catch(...) {
+            for(size_t i {0}; i < count; i++) {
+                if(results[i * 2 + 1] >= 0) {
+                    close(results[i * 2 + 1]);
+                }
+            }
+            throw;
+        }
+
+        for(size_t i {0}; i < count; i++) {
+            const int fd {results[i * 2 + 1]};
+            if(fd < 0) {
+                continue;
+            }
+
+            // A read that doesn't fit isn't queued; the file is closed either way
+            if(clips[i] && !ring.PrepareRead(fd, clips[i]->Data.data(), static_cast<unsigned>(clips[i]->Data.size()),
+                                             i * 2, true)) {
+                clips[i].reset();
+            }
+
+            if(!ring.PrepareClose(fd, i * 2 + 1)) {
+                close(fd);
+                results[i * 2 + 1] = -ECANCELED; // Nothing for a failed submission to close
+            }
+        }
+
+        if(!ring.SubmitAndWait(readResults)) {
+            if(!ring.Drain(readResults)) {
+                // The files stay open too: their closes may still be on the way
+                AbandonRing(std::move(clips));
+                return {};
+            }
+            for(size_t i {0}; i < count; i++) {
+                if(results[i * 2 + 1] >= 0 && readResults[i * 2 + 1] == -ECANCELED) {
+                    close(results[i * 2 + 1]);
+                }
+            }
+            return {};
+        }
+
+        // A short read means the file changed since it was stat'ed
+        for(size_t i {0}; i < count; i++) {
+            if(clips[i] && readResults[i * 2] != static_cast<int32_t>(clips[i]->Data.size())) {
+                clips[i].reset();
+            } else if(clips[i]) {
+                StageMetrics::CountBytesRead(clips[i]->Data.size());
+            }
+        }
+
+        return clips;
+#else
+        (void)first;
+        (void)spares;
+        return {};
+#endif
+    }
+}
\ No newline at end of file
@@ -0,0 +1,89 @@
+/*
+* Project: p2mark
+* File:    ClipPrefetcher.hpp
+* Desc:    Batched clip file reader header file
+* Created: 2026-10-17
+*/
+
+#pragma once
+
+#include <condition_variable>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "ClipManifest.hpp"
+
+namespace fs = std::filesystem;
+
+namespace p2mark {
+    /// A clip file read ahead of time, with the stamp it had before it was read.
+    struct PrefetchedClip {
+        std::string Data {};
+        FileStamp Stamp  {};
+    };
+
+    /// Reads clip files a window at a time through io_uring: the statx calls
+    /// and opens of a whole window are submitted together, then all of its
+    /// reads (each followed by its close). That is two waits per window instead
+    /// of several blocking system calls per clip, so on card readers and network
+    /// shares the latencies overlap instead of adding up.
+    /// Every thread keeps one ring for all of the windows it loads.
+    /// The first clip asked for in a window loads all of it; the worker pool
+    /// hands every worker a run of neighbouring clips, so each worker mostly
+    /// loads its own windows. Where io_uring isn't available (other systems,
+    /// old kernels, sandboxes) nothing is prefetched and the clips are read
+    /// the usual way.
+    class ClipPrefetcher {
+    public:
+        /// Clips per batch. Each of them takes two ring entries at a time.
+        static inline constexpr size_t WINDOW_SIZE {32};
+
+        /// At most this many spare buffers are kept for the next windows.
+        static inline constexpr size_t SPARE_BUFFERS_LIMIT {WINDOW_SIZE * 2};
+
+    public:
+        /// Only the wanted clips are read: there's no point in reading
+        /// the ones the manifest will most likely skip.
+        /// Both have to stay the same while the prefetcher is in use.
+        ClipPrefetcher(std::span<const fs::path> clips, const std::vector<bool>& wanted);
+
+    public:
+        /// Hands out the clip's contents (once), or nothing if it wasn't
+        /// wanted or couldn't be read, in which case it's read the usual way.
+        /// Can be called from several threads.
+        std::optional<PrefetchedClip> Take(const size_t index);
+
+        /// Takes back a buffer that's no longer needed; the clips of the next
+        /// windows are read into spare buffers instead of new ones.
+        /// Can be called from several threads.
+        void Recycle(std::string&& buffer);
+
+    private:
+        enum class WindowState { EMPTY, LOADING, READY };
+
+        struct Window {
+            WindowState State {WindowState::EMPTY};
+            std::vector<std::optional<PrefetchedClip>> Clips {};
+        };
+
+    private:
+        /// Reads the wanted clips in [first, first + count),
+        /// into the spare buffers as long as there are any.
+        std::vector<std::optional<PrefetchedClip>> LoadWindow(const size_t first, const size_t count,
+                                                              std::vector<std::string>& spares) const;
+
+    private:
+        std::span<const fs::path> m_Clips;
+        const std::vector<bool>& m_Wanted;
+
+        std::mutex m_Mutex;
+        std::condition_variable m_WindowLoaded;
+        std::vector<Window> m_Windows;
+        std::vector<std::string> m_Spares;
+        bool m_Enabled {false};
+    };
+}
\ No newline at end of file
@@ -0,0 +1,306 @@
+/*
+* Project: p2mark
+* File:    ClipScanner.cpp
+* Desc:    Single-pass CLIP directory scanner implementation file
+* Created: 2026-10-17
+*/
+
+#include "ClipScanner.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+#include <type_traits>
+
+#include "Constants.hpp"
+#include "P2Validator.hpp"
+#include "StageMetrics.hpp"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+namespace p2mark {
+    template<typename StatAt>
+    void ClipScanner::AddEntry(NameView name, const EntryType type, std::string_view leftoverSuffix, StatAt&& statAt) {
+        if(!leftoverSuffix.empty() && EndsWith(name, leftoverSuffix)) {
+            m_Leftovers.push_back(Store(name, 0));
+            return;
+        }
+
+        // A file called just ".XML" has no extension as far as fs::path is concerned
+        if(type == EntryType::OTHER || name.size() <= XML_EXT.size() || !EndsWith(name, XML_EXT)) {
+            return;
+        }
+
+        StageTimer timer(Stage::STAGE_VALIDATE);
+
+        bool regular   {false};
+        uint64_t size  {0};
+        if(!statAt(name, regular, size)) {
+            return; // Gone since it was listed
+        }
+
+        const ClipValidationResult result {P2Validator::ValidateClip(regular, size, true)};
+        if(result == ClipValidationResult::CORRECT_CLIP_FILE) {
+            m_Clips.push_back(Store(name, size));
+        } else if(result == ClipValidationResult::SUSPICIOUSLY_LARGE_CLIP_FILE) {
+            m_TooLarge.push_back(Store(name, size));
+        }
+    }
+
+#ifdef _WIN32
+    void ClipScanner::Scan(const fs::path& dir, std::string_view leftoverSuffix) {
+        m_Names.clear();
+        m_Names.reserve(ClipScanner::NAME_ARENA_RESERVE);
+        m_Clips.clear();
+        m_Clips.reserve(ClipScanner::CLIPS_RESERVE);
+        m_TooLarge.clear();
+        m_Leftovers.clear();
+
+        // Basic info and large fetches: no short names, and many entries per call
+        WIN32_FIND_DATAW data {};
+        HANDLE find {FindFirstFileExW((dir / L"*").c_str(), FindExInfoBasic, &data, FindExSearchNameMatch,
+                                      nullptr, FIND_FIRST_EX_LARGE_FETCH)};
+        StageMetrics::CountSyscalls(Syscall::SYSCALL_OPEN);
+
+        if(find == INVALID_HANDLE_VALUE) {
+            const DWORD error {GetLastError()};
+            if(error == ERROR_FILE_NOT_FOUND) {
+                return;
+            }
+
+            throw fs::filesystem_error("Cannot list the directory", dir,
+                                       std::error_code(static_cast<int>(error), std::system_category()));
+        }
+
+        // At least one more for the entries that didn't fit into the first fetch
+        StageMetrics::CountSyscalls(Syscall::SYSCALL_READ);
+
+        do {
+            const bool directory {(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0};
+            const bool link      {(data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) != 0};
+            const uint64_t size  {static_cast<uint64_t>(data.nFileSizeHigh) << 32 | data.nFileSizeLow};
+
+            const auto statAt = [&dir, link, size](NameView name, bool& regular, uint64_t& fileSize) {
+                if(!link) {
+                    regular  = true;
+                    fileSize = size;
+                    return true;
+                }
+
+                // Links are followed, like is_regular_file() does
+                std::error_code ec {};
+                const fs::path path {dir / name};
+                StageMetrics::CountSyscalls(Syscall::SYSCALL_STAT);
+
+                regular  = fs::is_regular_file(path, ec);
+                fileSize = regular ? static_cast<uint64_t>(fs::file_size(path, ec)) : 0;
+                return !ec;
+            };
+
+            const EntryType type {directory ? EntryType::OTHER : (link ? EntryType::UNKNOWN : EntryType::REGULAR)};
+
+            try {
+                AddEntry(NameView(data.cFileName), type, leftoverSuffix, statAt);
+            } catch(...) {
+                FindClose(find);
+                throw;
+            }
+        } while(FindNextFileW(find, &data));
+
+        FindClose(find);
+        StageMetrics::CountSyscalls(Syscall::SYSCALL_OPEN);
+    }
+#else
+    /// Closes the directory whatever happens to the scan.
+    class DirectoryCloser {
+    public:
+#ifdef __linux__
+        explicit DirectoryCloser(const int fd) : m_Fd(fd) {}
+        ~DirectoryCloser() { ::close(m_Fd); StageMetrics::CountSyscalls(Syscall::SYSCALL_OPEN); }
+#else
+        explicit DirectoryCloser(DIR* dir) : m_Dir(dir) {}
+        ~DirectoryCloser() { ::closedir(m_Dir); StageMetrics::CountSyscalls(Syscall::SYSCALL_OPEN); }
+#endif
+
+        DirectoryCloser(const DirectoryCloser&) = delete;
+        DirectoryCloser& operator=(const DirectoryCloser&) = delete;
+
+    private:
+#ifdef __linux__
+        const int m_Fd;
+#else
+        DIR* m_Dir;
+#endif
+    };
+
+    void ClipScanner::Scan(const fs::path& dir, std::string_view leftoverSuffix) {
+        m_Names.clear();
+        m_Names.reserve(ClipScanner::NAME_ARENA_RESERVE);
+        m_Clips.clear();
+        m_Clips.reserve(ClipScanner::CLIPS_RESERVE);
+        m_TooLarge.clear();
+        m_Leftovers.clear();
+
+        const auto cantList = [&dir](const int error) {
+            return fs::filesystem_error("Cannot list the directory", dir,
+                                        std::error_code(error, std::generic_category()));
+        };
+
+        const auto typeOf = [](const unsigned char type) {
+            if(type == DT_REG) {
+                return EntryType::REGULAR;
+            } else if(type == DT_LNK || type == DT_UNKNOWN) {
+                return EntryType::UNKNOWN;
+            }
+
+            return EntryType::OTHER;
+        };
+
+#ifdef __linux__
+        const int fd {::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC)};
+#else
+        DIR* listing {::opendir(dir.c_str())};
+        const int fd {listing ? ::dirfd(listing) : -1};
+#endif
+        StageMetrics::CountSyscalls(Syscall::SYSCALL_OPEN);
+
+        if(fd < 0) {
+            throw cantList(errno);
+        }
+
+#ifdef __linux__
+        DirectoryCloser closer(fd);
+#else
+        DirectoryCloser closer(listing);
+#endif
+
+        // The names come straight from the listing, null-terminated;
+        // links are followed, like is_regular_file() does
+        const auto statAt = [fd](NameView name, bool& regular, uint64_t& size) {
+            struct stat st {};
+            StageMetrics::CountSyscalls(Syscall::SYSCALL_STAT);
+
+            if(::fstatat(fd, name.data(), &st, 0) != 0) {
+                return false;
+            }
+
+            regular = S_ISREG(st.st_mode);
+            size    = static_cast<uint64_t>(st.st_size);
+            return true;
+        };
+
+#ifdef __linux__
+        // linux_dirent64: d_ino (8 bytes), d_off (8), d_reclen (2), d_type (1), then the name
+        constexpr size_t RECLEN_OFFSET {16};
+        constexpr size_t TYPE_OFFSET   {18};
+        constexpr size_t NAME_OFFSET   {19};
+
+        alignas(8) char buffer[ClipScanner::READ_BUFFER_SIZE];
+
+        while(true) {
+            const long bytes {::syscall(SYS_getdents64, fd, buffer, sizeof(buffer))};
+            StageMetrics::CountSyscalls(Syscall::SYSCALL_READ);
+
+            if(bytes < 0) {
+                if(errno == EINTR) continue;
+                throw cantList(errno);
+            } else if(bytes == 0) {
+                break;
+            }
+
+            for(long pos {0}; pos < bytes;) {
+                const char* record {buffer + pos};
+
+                unsigned short length {0};
+                std::memcpy(&length, record + RECLEN_OFFSET, sizeof(length));
+                pos += length;
+
+                AddEntry(NameView(record + NAME_OFFSET),
+                         typeOf(static_cast<unsigned char>(record[TYPE_OFFSET])), leftoverSuffix, statAt);
+            }
+        }
+#else
+        while(true) {
+            errno = 0;
+            const dirent* entry {::readdir(listing)};
+            StageMetrics::CountSyscalls(Syscall::SYSCALL_READ);
+
+            if(!entry) {
+                if(errno != 0) throw cantList(errno);
+                break;
+            }
+
+            AddEntry(NameView(entry->d_name), typeOf(entry->d_type), leftoverSuffix, statAt);
+        }
+#endif
+    }
+#endif
+
+    void ClipScanner::Sort() {
+        std::sort(m_Clips.begin(), m_Clips.end(), [this](const ScannedFile& a, const ScannedFile& b) {
+            if(a.SortKey != b.SortKey) {
+                return a.SortKey < b.SortKey;
+            }
+
+            return Name(a) < Name(b);
+        });
+    }
+
+    void ClipScanner::AppendClipPaths(const fs::path& dir, std::vector<fs::path>& out) const {
+        out.reserve(out.size() + m_Clips.size());
+
+        for(const ScannedFile& clip : m_Clips) {
+            out.emplace_back(dir / Name(clip));
+        }
+    }
+
+    ScannedFile ClipScanner::Store(NameView name, const uint64_t size) {
+        ScannedFile file {};
+        file.SortKey    = SortKeyOf(name);
+        file.Size       = size;
+        file.NameOffset = static_cast<uint32_t>(m_Names.size());
+        file.NameLength = static_cast<uint32_t>(name.size());
+
+        m_Names.append(name);
+        return file;
+    }
+
+    uint64_t ClipScanner::SortKeyOf(NameView name) {
+        using Unit = std::make_unsigned_t<NameChar>;
+        constexpr size_t UNITS     {sizeof(uint64_t) / sizeof(NameChar)};
+        constexpr size_t UNIT_BITS {sizeof(NameChar) * 8};
+
+        // Big-endian, missing characters are zeros: a name sorts before the
+        // longer names it is a prefix of, just like in a string comparison
+        uint64_t key {0};
+        for(size_t i {0}; i < UNITS; i++) {
+            const uint64_t unit {i < name.size() ? static_cast<Unit>(name[i]) : 0U};
+            key = key << UNIT_BITS | unit;
+        }
+
+        return key;
+    }
+
+    bool ClipScanner::EndsWith(NameView name, std::string_view suffix) {
+        if(name.size() < suffix.size()) {
+            return false;
+        }
+
+        const NameView end {name.substr(name.size() - suffix.size())};
+        return std::equal(end.begin(), end.end(), suffix.begin(), [](const NameChar a, const char b) {
+            return a == static_cast<NameChar>(static_cast<unsigned char>(b));
+        });
+    }
+}
\ No newline at end of file
@@ -0,0 +1,96 @@
+/*
+* Project: p2mark
+* File:    ClipScanner.hpp
+* Desc:    Single-pass CLIP directory scanner header file
+* Created: 2026-10-17
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace p2mark {
+    /// A file found by the scanner; its name lives in the scanner's arena.
+    struct ScannedFile {
+        uint64_t SortKey    {0}; // The first characters of the name, packed so that keys compare like names
+        uint64_t Size       {0};
+        uint32_t NameOffset {0};
+        uint32_t NameLength {0};
+    };
+
+    /// Lists a CLIP directory in one pass and validates the clips on the way.
+    /// The raw directory entries are read in bulk (getdents64 on Linux,
+    /// readdir elsewhere, large fetches on Windows) and their types come with
+    /// them, so only the entries named *.XML are ever stat'ed; the XMPs and
+    /// everything else next to the clips cost nothing but their directory entry.
+    /// All the names go into one arena, and every clip carries a sort key,
+    /// so sorting hardly ever has to look at the names themselves.
+    class ClipScanner {
+    public:
+        using NameChar = fs::path::value_type;
+        using NameView = std::basic_string_view<NameChar>;
+
+        /// How many bytes of directory entries are read at a time
+        /// (on the stack): about a thousand P2 file names.
+        static inline constexpr size_t READ_BUFFER_SIZE {32 * 1024};
+
+        /// The arena is reserved once, with room for this many characters of names.
+        static inline constexpr size_t NAME_ARENA_RESERVE {16 * 1024};
+
+        /// The same generous estimate as Application::CLIP_FILES_VECTOR_RESERVE.
+        static inline constexpr size_t CLIPS_RESERVE {250};
+
+    public:
+        /// Lists the directory, forgetting the previous listing.
+        /// Names ending with leftoverSuffix (if it isn't empty) are collected
+        /// separately. Throws fs::filesystem_error if the directory can't be read.
+        void Scan(const fs::path& dir, std::string_view leftoverSuffix = {});
+
+        /// Sorts the clips by name, the same order as comparing filename().string().
+        void Sort();
+
+        /// The valid clip files, in directory order until Sort() is called.
+        inline std::span<const ScannedFile> Clips() const { return m_Clips; }
+
+        /// Clip files skipped for being suspiciously large.
+        inline std::span<const ScannedFile> TooLarge() const { return m_TooLarge; }
+
+        /// Files whose names end with the leftover suffix.
+        inline std::span<const ScannedFile> Leftovers() const { return m_Leftovers; }
+
+        inline NameView Name(const ScannedFile& file) const {
+            return NameView(m_Names).substr(file.NameOffset, file.NameLength);
+        }
+
+        /// Appends the full paths of the clips to out, in the current order.
+        void AppendClipPaths(const fs::path& dir, std::vector<fs::path>& out) const;
+
+    private:
+        enum class EntryType { REGULAR, OTHER, UNKNOWN }; // Unknown: a symlink, or the listing doesn't say
+
+        /// Classifies one directory entry; type and size are looked up
+        /// (through statAt) only for the *.XML entries that need them.
+        template<typename StatAt>
+        void AddEntry(NameView name, EntryType type, std::string_view leftoverSuffix, StatAt&& statAt);
+
+        ScannedFile Store(NameView name, const uint64_t size);
+
+        static uint64_t SortKeyOf(NameView name);
+
+        /// Compares an ASCII suffix with the end of a name of any character type.
+        static bool EndsWith(NameView name, std::string_view suffix);
+
+    private:
+        std::basic_string<NameChar> m_Names {};
+        std::vector<ScannedFile> m_Clips {};
+        std::vector<ScannedFile> m_TooLarge {};
+        std::vector<ScannedFile> m_Leftovers {};
+    };
+}
\ No newline at end of file
@@ -0,0 +1,194 @@
+/*
+* Project: p2mark
+* File:    ClipWatcher.cpp
+* Desc:    CLIP directory watcher implementation file
+* Created: 2026-10-17
+*/
+
+#include "ClipWatcher.hpp"
+
+#include <algorithm>
+#include <thread>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace p2mark {
+    ClipWatcher::ClipWatcher(const fs::path& clipDir) :
+        m_ClipDir(clipDir) {
+#ifdef __linux__
+        m_InotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+        if(m_InotifyFd >= 0) {
+            constexpr uint32_t mask {IN_CREATE | IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_TO};
+            m_WatchFd = inotify_add_watch(m_InotifyFd, m_ClipDir.c_str(), mask);
+
+            // Fall back to polling (e.g. network shares without inotify support)
+            if(m_WatchFd < 0) {
+                close(m_InotifyFd);
+                m_InotifyFd = -1;
+            }
+        }
+#endif
+        // Clips that were already there (or half-copied) before we started
+        ScanDirectory();
+    }
+
+    ClipWatcher::~ClipWatcher() {
+#ifdef __linux__
+        if(m_InotifyFd >= 0) {
+            close(m_InotifyFd);
+        }
+#endif
+    }
+
+    std::vector<fs::path> ClipWatcher::WaitForClips(const std::chrono::milliseconds timeout) {
+        std::vector<fs::path> settled {};
+
+        if(IsEventDriven()) {
+            ReadEvents(timeout);
+        } else {
+            std::this_thread::sleep_for(std::min(timeout, ClipWatcher::POLL_INTERVAL));
+
+            if(std::chrono::steady_clock::now() - m_LastScan >= ClipWatcher::POLL_INTERVAL) {
+                ScanDirectory();
+            }
+        }
+
+        CollectSettled(settled);
+        std::sort(settled.begin(), settled.end());
+        return settled;
+    }
+
+    void ClipWatcher::ScanDirectory() {
+        std::error_code ec {};
+        m_LastScan = std::chrono::steady_clock::now();
+
+        for(const auto& entry : fs::directory_iterator(m_ClipDir, ec)) {
+            const std::string name {entry.path().filename().string()};
+            if(!IsClipName(name) || m_Reported.contains(name)) {
+                continue;
+            }
+
+            const uintmax_t size {entry.file_size(ec)};
+            const fs::file_time_type writeTime {entry.last_write_time(ec)};
+            if(ec) {
+                continue;
+            }
+
+            auto [it, inserted] {m_Pending.try_emplace(name)};
+            PendingClip& pending {it->second};
+
+            // Without events, "closed" can only mean "stopped changing"
+            pending.Closed = true;
+
+            if(inserted || pending.Size != size || pending.WriteTime != writeTime) {
+                pending.Size       = size;
+                pending.WriteTime  = writeTime;
+                pending.LastChange = m_LastScan;
+            }
+        }
+    }
+
+    void ClipWatcher::ReadEvents(const std::chrono::milliseconds timeout) {
+#ifdef __linux__
+        pollfd pfd {m_InotifyFd, POLLIN, 0};
+        if(poll(&pfd, 1, static_cast<int>(timeout.count())) <= 0) {
+            return;
+        }
+
+        alignas(inotify_event) char buffer[16 * 1024];
+
+        while(true) {
+            const ssize_t length {read(m_InotifyFd, buffer, sizeof(buffer))};
+            if(length <= 0) {
+                break;
+            }
+
+            for(ssize_t offset {0}; offset < length;) {
+                const auto* event {reinterpret_cast<const inotify_event*>(buffer + offset)};
+                offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+
+                // Events were dropped, look at the directory itself
+                if(event->mask & IN_Q_OVERFLOW) {
+                    ScanDirectory();
+                    continue;
+                }
+
+                if(event->len == 0 || !IsClipName(event->name)) {
+                    continue;
+                }
+
+                Touch(event->name, (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) != 0);
+            }
+        }
+#else
+        std::this_thread::sleep_for(timeout);
+#endif
+    }
+
+    void ClipWatcher::Touch(const std::string& name, const bool closed) {
+        if(m_Reported.contains(name)) {
+            return;
+        }
+
+        PendingClip& pending {m_Pending[name]};
+        pending.LastChange = std::chrono::steady_clock::now();
+
+        if(closed) {
+            // Remember what the writer left behind; it must still look
+            // the same once the quiet period is over
+            std::error_code ec {};
+            const fs::path path {m_ClipDir / name};
+
+            pending.Closed    = true;
+            pending.Size      = fs::file_size(path, ec);
+            pending.WriteTime = fs::last_write_time(path, ec);
+        }
+    }
+
+    void ClipWatcher::CollectSettled(std::vector<fs::path>& settled) {
+        const auto now {std::chrono::steady_clock::now()};
+
+        for(auto it {m_Pending.begin()}; it != m_Pending.end();) {
+            auto& [name, pending] {*it};
+
+            if(!pending.Closed || now - pending.LastChange < ClipWatcher::QUIET_PERIOD) {
+                ++it;
+                continue;
+            }
+
+            std::error_code ec {};
+            const fs::path path {m_ClipDir / name};
+            const uintmax_t size {fs::file_size(path, ec)};
+            const fs::file_time_type writeTime {ec ? fs::file_time_type {} : fs::last_write_time(path, ec)};
+
+            // Deleted or renamed away in the meantime
+            if(ec) {
+                it = m_Pending.erase(it);
+                continue;
+            }
+
+            // Still changing (or an empty placeholder): give it another quiet period
+            if(size == 0 || size != pending.Size || writeTime != pending.WriteTime) {
+                pending.Size       = size;
+                pending.WriteTime  = writeTime;
+                pending.LastChange = now;
+                ++it;
+                continue;
+            }
+
+            settled.emplace_back(path);
+            m_Reported.insert(name);
+            it = m_Pending.erase(it);
+        }
+    }
+
+    bool ClipWatcher::IsClipName(std::string_view name) {
+        // Copy tools write to hidden temporary names and rename at the end
+        return !name.starts_with('.') && name.size() > XML_EXT.size() && name.ends_with(XML_EXT);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,82 @@
+/*
+* Project: p2mark
+* File:    ClipWatcher.hpp
+* Desc:    CLIP directory watcher header file
+* Created: 2026-10-17
+*/
+
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "Constants.hpp"
+
+namespace fs = std::filesystem;
+
+namespace p2mark {
+    /// Watches a CLIP directory while a card is being copied into it
+    /// and reports every clip file once it has been completely written.
+    /// On Linux this is driven by inotify: a clip is a candidate once its
+    /// writer closes it. Elsewhere the directory is polled. Either way
+    /// a clip is only handed out after its size and modification time
+    /// have stayed the same for QUIET_PERIOD, so a file that is still
+    /// being written (or is reopened right away) is never parsed.
+    class ClipWatcher {
+    public:
+        static inline constexpr std::chrono::milliseconds QUIET_PERIOD  {750};
+        static inline constexpr std::chrono::milliseconds POLL_INTERVAL {500};
+
+    public:
+        explicit ClipWatcher(const fs::path& clipDir);
+        ~ClipWatcher();
+
+        ClipWatcher(const ClipWatcher&) = delete;
+        ClipWatcher& operator=(const ClipWatcher&) = delete;
+
+    public:
+        /// Waits up to the timeout for filesystem activity and returns
+        /// the clips that have settled since the last call, sorted by name.
+        /// Every clip is returned only once.
+        std::vector<fs::path> WaitForClips(const std::chrono::milliseconds timeout);
+
+        /// True if changes are delivered by the OS rather than by polling.
+        inline bool IsEventDriven() const { return m_InotifyFd >= 0; }
+
+    private:
+        struct PendingClip {
+            std::chrono::steady_clock::time_point LastChange {};
+            uintmax_t Size              {0};
+            fs::file_time_type WriteTime {};
+            bool Closed                 {false}; // The writer has closed it at least once
+        };
+
+    private:
+        /// Picks up clip files that appeared without an event
+        /// (already there at start-up, or the polling fallback).
+        void ScanDirectory();
+
+        /// Reads the pending inotify events, waiting up to the timeout.
+        void ReadEvents(const std::chrono::milliseconds timeout);
+
+        void Touch(const std::string& name, const bool closed);
+
+        /// Moves the clips that stayed unchanged for the quiet period into the result.
+        void CollectSettled(std::vector<fs::path>& settled);
+
+        static bool IsClipName(std::string_view name);
+
+    private:
+        const fs::path m_ClipDir;
+        std::map<std::string, PendingClip> m_Pending;
+        std::set<std::string> m_Reported;
+        std::chrono::steady_clock::time_point m_LastScan {};
+
+        int m_InotifyFd {-1};
+        int m_WatchFd   {-1};
+    };
+}
\ No newline at end of file
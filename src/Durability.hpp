@@ -0,0 +1,44 @@
+/*
+* Project: p2mark
+* File:    Durability.hpp
+* Desc:    Describes how hard the application tries to get XMPs onto the disk
+* Created: 2026-10-17
+*/
+
+#pragma once
+
+#include <optional>
+#include <string_view>
+
+namespace p2mark {
+    /// Every XMP is written to a temporary file and renamed into place,
+    /// so it's always either the old file or the complete new one.
+    /// This is about what survives a power cut or a yanked card.
+    enum class Durability {
+        DURABILITY_NONE = 0, // Leave it to the OS to write the files out
+        DURABILITY_BATCH,    // Sync once per batch of files (and at the end of a shoot)
+        DURABILITY_FULL      // Sync every file before it replaces the old one
+    };
+
+    constexpr inline std::string_view DurabilityToString(const Durability durability) {
+        if(durability == Durability::DURABILITY_FULL) {
+            return "full";
+        } else if(durability == Durability::DURABILITY_BATCH) {
+            return "batch";
+        } else {
+            return "none";
+        }
+    }
+
+    constexpr inline std::optional<Durability> DurabilityFromString(std::string_view name) {
+        for(const Durability durability : {Durability::DURABILITY_NONE,
+                                           Durability::DURABILITY_BATCH,
+                                           Durability::DURABILITY_FULL}) {
+            if(DurabilityToString(durability) == name) {
+                return durability;
+            }
+        }
+
+        return std::nullopt;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,230 @@
+/*
+* Project: p2mark
+* File:    GuidGenerator.cpp
+* Desc:    Portable GUID generator implementation file
+* Created: 2026-10-17
+*/
+
+#include "GuidGenerator.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+
+#include "P2Exception.hpp"
+#include "StageMetrics.hpp"
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <bcrypt.h>
+#elif defined(__linux__)
+#include <sys/random.h>
+#else
+#include <random>
+#endif
+
+namespace p2mark {
+    /// ChaCha20 (RFC 8439) used as a keystream generator.
+    class ChaChaStream {
+    public:
+        ChaChaStream() {
+            // "expand 32-byte k"
+            m_State[0] = 0x61707865;
+            m_State[1] = 0x3320646E;
+            m_State[2] = 0x79622D32;
+            m_State[3] = 0x6B206574;
+
+            // 256-bit key and 96-bit nonce from the OS, the block counter starts at zero
+            uint8_t seed[44] {};
+            FillFromOs(seed, sizeof(seed));
+
+            for(size_t i {0}; i < 8; i++) {
+                m_State[4 + i] = LoadWord(seed + i * 4);
+            }
+
+            m_State[12] = 0;
+            for(size_t i {0}; i < 3; i++) {
+                m_State[13 + i] = LoadWord(seed + 32 + i * 4);
+            }
+
+            std::memset(seed, 0, sizeof(seed));
+        }
+
+        void Fill(uint8_t* out, size_t length) {
+            while(length > 0) {
+                if(m_Used == sizeof(m_Block)) {
+                    Refill();
+                }
+
+                const size_t chunk {std::min(length, sizeof(m_Block) - m_Used)};
+                std::memcpy(out, m_Block + m_Used, chunk);
+
+                // Never hand out the same keystream bytes twice
+                std::memset(m_Block + m_Used, 0, chunk);
+
+                m_Used += chunk;
+                out    += chunk;
+                length -= chunk;
+            }
+        }
+
+    private:
+        static inline uint32_t LoadWord(const uint8_t* p) {
+            return static_cast<uint32_t>(p[0]) | static_cast<uint32_t>(p[1]) << 8 |
+                   static_cast<uint32_t>(p[2]) << 16 | static_cast<uint32_t>(p[3]) << 24;
+        }
+
+        static inline void QuarterRound(uint32_t* x, const int a, const int b, const int c, const int d) {
+            x[a] += x[b]; x[d] = std::rotl(x[d] ^ x[a], 16);
+            x[c] += x[d]; x[b] = std::rotl(x[b] ^ x[c], 12);
+            x[a] += x[b]; x[d] = std::rotl(x[d] ^ x[a], 8);
+            x[c] += x[d]; x[b] = std::rotl(x[b] ^ x[c], 7);
+        }
+
+        void Refill() {
+            uint32_t x[16] {};
+            std::memcpy(x, m_State, sizeof(x));
+
+            for(int round {0}; round < 10; round++) {
+                QuarterRound(x, 0, 4, 8, 12);
+                QuarterRound(x, 1, 5, 9, 13);
+                QuarterRound(x, 2, 6, 10, 14);
+                QuarterRound(x, 3, 7, 11, 15);
+                QuarterRound(x, 0, 5, 10, 15);
+                QuarterRound(x, 1, 6, 11, 12);
+                QuarterRound(x, 2, 7, 8, 13);
+                QuarterRound(x, 3, 4, 9, 14);
+            }
+
+            for(size_t i {0}; i < 16; i++) {
+                const uint32_t word {x[i] + m_State[i]};
+                m_Block[i * 4 + 0] = static_cast<uint8_t>(word);
+                m_Block[i * 4 + 1] = static_cast<uint8_t>(word >> 8);
+                m_Block[i * 4 + 2] = static_cast<uint8_t>(word >> 16);
+                m_Block[i * 4 + 3] = static_cast<uint8_t>(word >> 24);
+            }
+
+            // 2^32 blocks (256 GB) per key is far more than a run will ever need,
+            // but don't wrap around into a keystream that was already used
+            if(++m_State[12] == 0) {
+                uint8_t seed[32] {};
+                FillFromOs(seed, sizeof(seed));
+                for(size_t i {0}; i < 8; i++) {
+                    m_State[4 + i] ^= LoadWord(seed + i * 4);
+                }
+            }
+
+            m_Used = 0;
+        }
+
+        static void FillFromOs(uint8_t* out, size_t length) {
+            const auto failed = []() {
+                return P2Exception("Can\'t get random bytes from the OS to generate GUIDs",
+                                   P2ExceptionCode::CODE_GENERIC);
+            };
+
+#ifdef _WIN32
+            if(!BCRYPT_SUCCESS(BCryptGenRandom(nullptr, out, static_cast<ULONG>(length),
+                                               BCRYPT_USE_SYSTEM_PREFERRED_RNG))) {
+                throw failed();
+            }
+#elif defined(__linux__)
+            while(length > 0) {
+                const ssize_t got {getrandom(out, length, 0)};
+                if(got < 0) {
+                    if(errno == EINTR) continue;
+                    throw failed();
+                }
+
+                out    += got;
+                length -= static_cast<size_t>(got);
+            }
+#else
+            try {
+                std::random_device device {};
+                for(size_t i {0}; i < length; i++) {
+                    out[i] = static_cast<uint8_t>(device());
+                }
+            } catch(const std::exception&) {
+                throw failed();
+            }
+#endif
+        }
+
+    private:
+        uint32_t m_State[16] {};
+        uint8_t m_Block[64]  {};
+        size_t m_Used        {sizeof(m_Block)};
+    };
+
+    static ChaChaStream& ThreadStream() {
+        thread_local ChaChaStream stream {};
+        return stream;
+    }
+
+    static uint64_t UnixTimeMs() {
+        const auto now {std::chrono::system_clock::now().time_since_epoch()};
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(now).count());
+    }
+
+    std::string_view GuidGenerator::Generate(GuidString& out, const GuidVersion version) {
+        uint8_t bytes[16] {};
+        ThreadStream().Fill(bytes, sizeof(bytes));
+
+        FormatGuid(bytes, version, version == GuidVersion::V7 ? UnixTimeMs() : 0, out.data());
+        return {out.data(), GuidGenerator::GUID_LENGTH};
+    }
+
+    void GuidGenerator::GenerateBatch(std::span<GuidString> out, const GuidVersion version) {
+        StageTimer timer(Stage::STAGE_GUID);
+
+        constexpr size_t CHUNK {16};
+        uint8_t bytes[CHUNK * 16] {};
+
+        const uint64_t unixMs {version == GuidVersion::V7 ? UnixTimeMs() : 0};
+
+        for(size_t done {0}; done < out.size();) {
+            const size_t count {std::min(CHUNK, out.size() - done)};
+            ThreadStream().Fill(bytes, count * 16);
+
+            for(size_t i {0}; i < count; i++) {
+                FormatGuid(bytes + i * 16, version, unixMs, out[done + i].data());
+            }
+
+            done += count;
+        }
+    }
+
+    std::string GuidGenerator::GenerateString(const GuidVersion version) {
+        GuidString guid {};
+        return std::string(Generate(guid, version));
+    }
+
+    void GuidGenerator::FormatGuid(uint8_t* bytes, const GuidVersion version, const uint64_t unixMs, char* out) {
+        constexpr char hexDigits[] {"0123456789abcdef"};
+
+        // The top 48 bits are a big-endian millisecond timestamp in v7
+        if(version == GuidVersion::V7) {
+            for(size_t i {0}; i < 6; i++) {
+                bytes[i] = static_cast<uint8_t>(unixMs >> (40 - i * 8));
+            }
+        }
+
+        bytes[6] = static_cast<uint8_t>((bytes[6] & 0x0F) | (static_cast<uint8_t>(version) << 4));
+        bytes[8] = static_cast<uint8_t>((bytes[8] & 0x3F) | 0x80); // RFC 4122 variant
+
+        size_t pos {0};
+        for(size_t i {0}; i < 16; i++) {
+            if(i == 4 || i == 6 || i == 8 || i == 10) {
+                out[pos++] = '-';
+            }
+
+            out[pos++] = hexDigits[bytes[i] >> 4];
+            out[pos++] = hexDigits[bytes[i] & 0x0F];
+        }
+
+        out[pos] = '\0';
+    }
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+/*
+* Project: p2mark
+* File:    GuidGenerator.hpp
+* Desc:    Portable GUID generator header file
+* Created: 2026-10-17
+*/
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace p2mark {
+    enum class GuidVersion : uint8_t {
+        V4 = 4, // Random
+        V7 = 7  // Unix time in milliseconds, then random
+    };
+
+    /// Generates RFC 4122 (RFC 9562) GUIDs without COM or any other OS service.
+    /// The random bits come from a ChaCha20 stream keyed from the OS entropy
+    /// source; every thread has its own stream, so generating a GUID takes
+    /// no locks, no allocations and no system calls (apart from seeding,
+    /// once per thread).
+    class GuidGenerator {
+    public:
+        /// xxxxxxxx-xxxx-Vxxx-Nxxx-xxxxxxxxxxxx, lowercase, as Adobe writes them
+        static inline constexpr size_t GUID_LENGTH {36};
+
+        /// Null-terminated, so it can be passed straight to C APIs (tinyxml2).
+        using GuidString = std::array<char, GUID_LENGTH + 1>;
+
+        /// How many GUIDs the writers ask GenerateBatch for at a time.
+        static inline constexpr size_t BATCH_SIZE {16};
+
+    public:
+        /// Formats a new GUID into the buffer and returns a view of it.
+        static std::string_view Generate(GuidString& out, const GuidVersion version = GuidVersion::V4);
+
+        /// Fills every buffer with a new GUID; the random bytes
+        /// for all of them are drawn in one go.
+        static void GenerateBatch(std::span<GuidString> out, const GuidVersion version = GuidVersion::V4);
+
+        /// For the callers that need a string anyway.
+        static std::string GenerateString(const GuidVersion version = GuidVersion::V4);
+
+    private:
+        /// Stamps the version and variant bits (and the timestamp for v7)
+        /// into 16 random bytes and formats them.
+        static void FormatGuid(uint8_t* bytes, const GuidVersion version, const uint64_t unixMs, char* out);
+    };
+}
\ No newline at end of file
@@ -0,0 +1,287 @@
+/*
+* Project: p2mark
+* File:    IoRing.cpp
+* Desc:    Minimal io_uring submission queue implementation file
+* Created: 2026-10-17
+*/
+
+#include "IoRing.hpp"
+
+#ifdef __linux__
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "StageMetrics.hpp"
+
+namespace p2mark {
+    static inline unsigned LoadAcquire(const unsigned* p) {
+        return std::atomic_ref<const unsigned>(*p).load(std::memory_order_acquire);
+    }
+
+    static inline void StoreRelease(unsigned* p, const unsigned value) {
+        std::atomic_ref<unsigned>(*p).store(value, std::memory_order_release);
+    }
+
+    IoRing::IoRing(const unsigned entries) {
+        io_uring_params params {};
+
+        m_RingFd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        StageMetrics::CountSyscalls(Syscall::SYSCALL_RING);
+        if(m_RingFd < 0) {
+            m_RingFd = -1;
+            return;
+        }
+
+        m_SqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        m_CqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+        // Newer kernels map both rings with one mmap()
+        const bool singleMap {(params.features & IORING_FEAT_SINGLE_MMAP) != 0};
+        if(singleMap) {
+            m_SqRingSize = m_CqRingSize = std::max(m_SqRingSize, m_CqRingSize);
+        }
+
+        m_SqRing = mmap(nullptr, m_SqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        m_RingFd, IORING_OFF_SQ_RING);
+        StageMetrics::CountSyscalls(Syscall::SYSCALL_MAP);
+        if(m_SqRing == MAP_FAILED) {
+            m_SqRing = nullptr;
+            Close();
+            return;
+        }
+
+        if(singleMap) {
+            m_CqRing = m_SqRing;
+        } else {
+            m_CqRing = mmap(nullptr, m_CqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                            m_RingFd, IORING_OFF_CQ_RING);
+            StageMetrics::CountSyscalls(Syscall::SYSCALL_MAP);
+            if(m_CqRing == MAP_FAILED) {
+                m_CqRing = nullptr;
+                Close();
+                return;
+            }
+        }
+
+        m_SqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        void* sqes {mmap(nullptr, m_SqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         m_RingFd, IORING_OFF_SQES)};
+        StageMetrics::CountSyscalls(Syscall::SYSCALL_MAP);
+        if(sqes == MAP_FAILED) {
+            Close();
+            return;
+        }
+        m_Sqes = static_cast<io_uring_sqe*>(sqes);
+
+        char* sq {static_cast<char*>(m_SqRing)};
+        m_SqHead    = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        m_SqTail    = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        m_SqArray   = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        m_SqMask    = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        m_SqEntries = params.sq_entries;
+
+        char* cq {static_cast<char*>(m_CqRing)};
+        m_CqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        m_CqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        m_Cqes   = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        m_CqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+
+        if(!ProbeOperations()) {
+            Close();
+        }
+    }
+
+    IoRing::~IoRing() {
+        Close();
+    }
+
+    void IoRing::Close() {
+        if(m_Sqes) {
+            munmap(m_Sqes, m_SqesSize);
+            StageMetrics::CountSyscalls(Syscall::SYSCALL_MAP);
+            m_Sqes = nullptr;
+        }
+
+        if(m_CqRing && m_CqRing != m_SqRing) {
+            munmap(m_CqRing, m_CqRingSize);
+            StageMetrics::CountSyscalls(Syscall::SYSCALL_MAP);
+        }
+        m_CqRing = nullptr;
+
+        if(m_SqRing) {
+            munmap(m_SqRing, m_SqRingSize);
+            StageMetrics::CountSyscalls(Syscall::SYSCALL_MAP);
+            m_SqRing = nullptr;
+        }
+
+        if(m_RingFd >= 0) {
+            close(m_RingFd);
+            StageMetrics::CountSyscalls(Syscall::SYSCALL_OPEN);
+            m_RingFd = -1;
+        }
+    }
+
+    bool IoRing::ProbeOperations() {
+        constexpr unsigned OP_COUNT {256};
+
+        // io_uring_probe ends in a flexible array of OP_COUNT entries
+        std::vector<uint8_t> storage(sizeof(io_uring_probe) + OP_COUNT * sizeof(io_uring_probe_op));
+        io_uring_probe* probe {reinterpret_cast<io_uring_probe*>(storage.data())};
+
+        StageMetrics::CountSyscalls(Syscall::SYSCALL_RING);
+        if(syscall(__NR_io_uring_register, m_RingFd, IORING_REGISTER_PROBE, probe, OP_COUNT) < 0) {
+            return false;
+        }
+
+        for(const uint8_t op : {IORING_OP_OPENAT, IORING_OP_STATX, IORING_OP_READ,
+                                IORING_OP_CLOSE, IORING_OP_RENAMEAT}) {
+            if(op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    unsigned IoRing::FreeEntries() const {
+        return m_SqEntries - (*m_SqTail + m_Queued - LoadAcquire(m_SqHead));
+    }
+
+    io_uring_sqe* IoRing::NextSqe(const uint8_t opcode, const uint64_t tag) {
+        if(FreeEntries() == 0) {
+            return nullptr;
+        }
+
+        const unsigned tail {*m_SqTail + m_Queued};
+
+        const unsigned index {tail & m_SqMask};
+        io_uring_sqe* sqe {&m_Sqes[index]};
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode    = opcode;
+        sqe->user_data = tag;
+
+        m_SqArray[index] = index;
+        m_Queued++;
+        return sqe;
+    }
+
+    bool IoRing::PrepareOpen(const char* path, const int flags, const uint64_t tag) {
+        if(io_uring_sqe* sqe {NextSqe(IORING_OP_OPENAT, tag)}) {
+            sqe->fd         = AT_FDCWD;
+            sqe->addr       = reinterpret_cast<uint64_t>(path);
+            sqe->open_flags = static_cast<uint32_t>(flags | O_CLOEXEC);
+            return true;
+        }
+
+        return false;
+    }
+
+    bool IoRing::PrepareStatx(const char* path, const unsigned mask, struct statx* out, const uint64_t tag) {
+        if(io_uring_sqe* sqe {NextSqe(IORING_OP_STATX, tag)}) {
+            sqe->fd  = AT_FDCWD;
+            sqe->addr = reinterpret_cast<uint64_t>(path);
+            sqe->len = mask;
+            sqe->off = reinterpret_cast<uint64_t>(out);
+            return true;
+        }
+
+        return false;
+    }
+
+    bool IoRing::PrepareRead(const int fd, void* buffer, const unsigned length, const uint64_t tag,
+                             const bool linkNext) {
+        // A linked read is no use without the request it's linked to
+        if(linkNext && FreeEntries() < 2) {
+            return false;
+        }
+
+        if(io_uring_sqe* sqe {NextSqe(IORING_OP_READ, tag)}) {
+            sqe->fd   = fd;
+            sqe->addr = reinterpret_cast<uint64_t>(buffer);
+            sqe->len  = length;
+            sqe->off  = 0;
+
+            if(linkNext) {
+                sqe->flags |= IOSQE_IO_HARDLINK;
+            }
+            return true;
+        }
+
+        return false;
+    }
+
+    bool IoRing::PrepareClose(const int fd, const uint64_t tag) {
+        if(io_uring_sqe* sqe {NextSqe(IORING_OP_CLOSE, tag)}) {
+            sqe->fd = fd;
+            return true;
+        }
+
+        return false;
+    }
+
+    bool IoRing::PrepareRename(const char* from, const char* to, const uint64_t tag) {
+        if(io_uring_sqe* sqe {NextSqe(IORING_OP_RENAMEAT, tag)}) {
+            sqe->fd   = AT_FDCWD;
+            sqe->addr = reinterpret_cast<uint64_t>(from);
+            sqe->len  = static_cast<uint32_t>(AT_FDCWD);
+            sqe->off  = reinterpret_cast<uint64_t>(to); // addr2
+            return true;
+        }
+
+        return false;
+    }
+
+    bool IoRing::SubmitAndWait(std::span<int32_t> results) {
+        if(m_Queued > 0) {
+            StoreRelease(m_SqTail, *m_SqTail + m_Queued);
+            m_ToSubmit += m_Queued;
+            m_InFlight += m_Queued;
+            m_Queued = 0;
+        }
+
+        return WaitForAll(results);
+    }
+
+    bool IoRing::Drain(std::span<int32_t> results) {
+        return WaitForAll(results);
+    }
+
+    bool IoRing::WaitForAll(std::span<int32_t> results) {
+        while(m_InFlight > 0) {
+            const long entered {syscall(__NR_io_uring_enter, m_RingFd, m_ToSubmit, m_InFlight,
+                                        IORING_ENTER_GETEVENTS, nullptr, 0)};
+            StageMetrics::CountSyscalls(Syscall::SYSCALL_RING);
+            if(entered < 0) {
+                if(errno == EINTR || errno == EAGAIN || errno == EBUSY) continue;
+                return false;
+            }
+
+            m_ToSubmit -= std::min(m_ToSubmit, static_cast<unsigned>(entered));
+
+            unsigned head {*m_CqHead};
+            const unsigned tail {LoadAcquire(m_CqTail)};
+
+            for(; head != tail; head++) {
+                const io_uring_cqe& cqe {m_Cqes[head & m_CqMask]};
+                if(cqe.user_data < results.size()) {
+                    results[cqe.user_data] = cqe.res;
+                }
+                m_InFlight--;
+            }
+
+            StoreRelease(m_CqHead, head);
+        }
+
+        return true;
+    }
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,113 @@
+/*
+* Project: p2mark
+* File:    IoRing.hpp
+* Desc:    Minimal io_uring submission queue header file
+* Created: 2026-10-17
+*/
+
+#pragma once
+
+// io_uring is Linux only; everything that uses it has a plain fallback
+#ifdef __linux__
+
+#include <cstdint>
+#include <span>
+
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/stat.h>
+
+namespace p2mark {
+    /// A bare-bones io_uring on top of the raw system calls (no liburing):
+    /// requests are queued with the Prepare*() calls, then submitted and
+    /// waited for in one go, so the latencies of a whole batch of file
+    /// operations overlap instead of adding up.
+    /// Every request carries a tag, the index its result is stored at.
+    /// Not thread-safe, every thread needs its own ring.
+    class IoRing {
+    public:
+        static inline constexpr unsigned DEFAULT_ENTRIES {64};
+
+    public:
+        /// Check IsOpen(): the kernel may be too old, or io_uring may be
+        /// disabled (sysctl, seccomp), in which case it simply isn't used.
+        explicit IoRing(const unsigned entries = DEFAULT_ENTRIES);
+        ~IoRing();
+
+        IoRing(const IoRing&) = delete;
+        IoRing& operator=(const IoRing&) = delete;
+
+    public:
+        inline bool IsOpen() const { return m_RingFd >= 0; }
+
+        /// How many requests can be queued before they have to be submitted.
+        inline unsigned Capacity() const { return m_SqEntries; }
+
+        /// The Prepare*() calls return false if the queue is full,
+        /// in which case the request isn't queued (nor ever carried out).
+        /// The path has to stay valid until the request is completed.
+        bool PrepareOpen(const char* path, const int flags, const uint64_t tag);
+        bool PrepareStatx(const char* path, const unsigned mask, struct statx* out, const uint64_t tag);
+
+        /// With linkNext the following request only starts once this one is done,
+        /// whether it succeeded or not; the read is then only queued if there's
+        /// room for that request as well.
+        bool PrepareRead(const int fd, void* buffer, const unsigned length, const uint64_t tag,
+                         const bool linkNext = false);
+        bool PrepareClose(const int fd, const uint64_t tag);
+        bool PrepareRename(const char* from, const char* to, const uint64_t tag);
+
+        /// Submits everything queued and waits until all of it is done.
+        /// results[tag] gets what the system call would have returned,
+        /// with -errno for errors. Returns false if the ring itself failed.
+        bool SubmitAndWait(std::span<int32_t> results);
+
+        /// After SubmitAndWait() failed, some requests may still be in flight,
+        /// and the kernel may still write to what they point to. Tries once more
+        /// to wait for them all; returns false if they can't be waited for,
+        /// in which case nothing they point to may ever be freed.
+        bool Drain(std::span<int32_t> results);
+
+    private:
+        /// Returns nullptr if the queue is full.
+        io_uring_sqe* NextSqe(const uint8_t opcode, const uint64_t tag);
+
+        /// How many more requests fit in the submission queue.
+        unsigned FreeEntries() const;
+
+        /// Submits what's left to submit and reaps until nothing is in flight.
+        bool WaitForAll(std::span<int32_t> results);
+
+        /// True if the kernel knows every operation the ring is used for.
+        bool ProbeOperations();
+
+        void Close();
+
+    private:
+        int m_RingFd {-1};
+
+        void* m_SqRing      {nullptr};
+        void* m_CqRing      {nullptr};
+        size_t m_SqRingSize {0};
+        size_t m_CqRingSize {0};
+        io_uring_sqe* m_Sqes {nullptr};
+        size_t m_SqesSize    {0};
+
+        unsigned* m_SqHead  {nullptr};
+        unsigned* m_SqTail  {nullptr};
+        unsigned* m_SqArray {nullptr};
+        unsigned m_SqMask    {0};
+        unsigned m_SqEntries {0};
+
+        unsigned* m_CqHead  {nullptr};
+        unsigned* m_CqTail  {nullptr};
+        io_uring_cqe* m_Cqes {nullptr};
+        unsigned m_CqMask    {0};
+
+        unsigned m_Queued   {0}; // Prepared, not handed to the kernel yet
+        unsigned m_ToSubmit {0}; // Handed over, but not taken by io_uring_enter() yet
+        unsigned m_InFlight {0}; // Handed over, not completed yet
+    };
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,80 @@
+/*
+* Project: p2mark
+* File:    JobRequest.cpp
+* Desc:    A job for the daemon, as it travels over its socket
+* Created: 2026-10-17
+*/
+
+#include "JobRequest.hpp"
+
+#include <format>
+
+namespace p2mark {
+    std::string JobRequest::Serialize() const {
+        std::string text {std::format("mode {}\n", AppModeToString(Mode))};
+
+        for(const std::string& path : ContentsPaths) {
+            text.append(std::format("path {}\n", path));
+        }
+
+        if(Force) {
+            text.append("force\n");
+        }
+
+        text.append(std::format("durability {}\n", DurabilityToString(XmpDurability)));
+        text.append(std::format("priority {}\n", JobPriorityToString(Priority)));
+
+        if(!IndexPath.empty()) {
+            text.append(std::format("index {}\n", IndexPath.string()));
+        }
+
+        text.push_back('\n');
+        return text;
+    }
+
+    std::optional<JobRequest> JobRequest::Parse(std::string_view text, std::string& error) {
+        JobRequest request {};
+
+        while(!text.empty()) {
+            const size_t end {text.find('\n')};
+            std::string_view line {text.substr(0, end)};
+            text.remove_prefix(end == std::string_view::npos ? text.size() : end + 1);
+
+            if(!line.empty() && line.back() == '\r') {
+                line.remove_suffix(1);
+            }
+
+            if(line.empty()) {
+                break;
+            }
+
+            const size_t space {line.find(' ')};
+            const std::string_view key {line.substr(0, space)};
+            const std::string_view value {space == std::string_view::npos ? std::string_view {} : line.substr(space + 1)};
+
+            if(key == "mode" && (value == "write" || value == "list")) {
+                request.Mode = value == "write" ? AppMode::MODE_WRITE_MARKERS : AppMode::MODE_LIST_MARKERS;
+            } else if(key == "path" && !value.empty()) {
+                request.ContentsPaths.emplace_back(value);
+            } else if(key == "force" && value.empty()) {
+                request.Force = true;
+            } else if(key == "durability" && DurabilityFromString(value)) {
+                request.XmpDurability = *DurabilityFromString(value);
+            } else if(key == "priority" && JobPriorityFromString(value)) {
+                request.Priority = *JobPriorityFromString(value);
+            } else if(key == "index" && !value.empty()) {
+                request.IndexPath = value;
+            } else {
+                error = std::format("Invalid request line: {}", line);
+                return std::nullopt;
+            }
+        }
+
+        if(request.ContentsPaths.empty()) {
+            error = "The request has no path";
+            return std::nullopt;
+        }
+
+        return request;
+    }
+}
\ No newline at end of file
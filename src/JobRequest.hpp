@@ -0,0 +1,73 @@
+/*
+* Project: p2mark
+* File:    JobRequest.hpp
+* Desc:    A job for the daemon, as it travels over its socket
+* Created: 2026-10-17
+*/
+
+#pragma once
+
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "AppMode.hpp"
+#include "Durability.hpp"
+
+namespace fs = std::filesystem;
+
+namespace p2mark {
+    /// Queued jobs are taken by priority, then in the order they came in.
+    enum class JobPriority {
+        PRIORITY_LOW = 0,
+        PRIORITY_NORMAL,
+        PRIORITY_HIGH
+    };
+
+    constexpr inline std::string_view JobPriorityToString(const JobPriority priority) {
+        if(priority == JobPriority::PRIORITY_HIGH) {
+            return "high";
+        } else if(priority == JobPriority::PRIORITY_LOW) {
+            return "low";
+        } else {
+            return "normal";
+        }
+    }
+
+    constexpr inline std::optional<JobPriority> JobPriorityFromString(std::string_view name) {
+        for(const JobPriority priority : {JobPriority::PRIORITY_LOW,
+                                          JobPriority::PRIORITY_NORMAL,
+                                          JobPriority::PRIORITY_HIGH}) {
+            if(JobPriorityToString(priority) == name) {
+                return priority;
+            }
+        }
+
+        return std::nullopt;
+    }
+
+    /// What a client asks the daemon to do: the same as a command line would.
+    /// On the socket it's one "key value" line per field (a line per shoot),
+    /// ended by an empty line:
+    ///
+    ///   mode write
+    ///   path /media/card1/CONTENTS
+    ///   durability batch
+    ///   priority high
+    ///
+    struct JobRequest {
+        AppMode Mode {AppMode::MODE_WRITE_MARKERS};
+        std::vector<std::string> ContentsPaths {};
+        bool Force {false};
+        Durability XmpDurability {Durability::DURABILITY_BATCH};
+        JobPriority Priority {JobPriority::PRIORITY_NORMAL};
+        fs::path IndexPath {};
+
+        std::string Serialize() const;
+
+        /// Returns nothing (and says why in error) if the text isn't a valid request.
+        static std::optional<JobRequest> Parse(std::string_view text, std::string& error);
+    };
+}
\ No newline at end of file
@@ -0,0 +1,485 @@
+/*
+* Project: p2mark
+* File:    JobServer.cpp
+* Desc:    Daemon mode: jobs taken over a local socket implementation file
+* Created: 2026-10-17
+*/
+
+#include "JobServer.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <format>
+#include <iostream>
+#include <sstream>
+#include <streambuf>
+#include <thread>
+
+#include "Application.hpp"
+#include "Utils.hpp"
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace p2mark {
+    namespace {
+        /// Lets the record writer stream straight into the client's socket.
+        /// Once the client is gone, everything written is dropped.
+        class SocketStreamBuf : public std::streambuf {
+        public:
+            explicit SocketStreamBuf(const int socket, bool (*send)(const int, std::string_view)) :
+                m_Socket(socket), m_Send(send) {}
+
+            /// False once a send failed or timed out (see JobServer::SEND_TIMEOUT).
+            inline bool Connected() const { return m_Connected; }
+
+        protected:
+            std::streamsize xsputn(const char* data, const std::streamsize count) override {
+                m_Connected = m_Connected && m_Send(m_Socket, {data, static_cast<size_t>(count)});
+                return m_Connected ? count : 0;
+            }
+
+            int_type overflow(const int_type c) override {
+                if(traits_type::eq_int_type(c, traits_type::eof())) {
+                    return traits_type::not_eof(c);
+                }
+
+                const char ch {traits_type::to_char_type(c)};
+                return xsputn(&ch, 1) == 1 ? c : traits_type::eof();
+            }
+
+        private:
+            const int m_Socket;
+            bool (*m_Send)(const int, std::string_view);
+            bool m_Connected {true};
+        };
+
+        /// The pretty-printed stats on one line, for an NDJSON record.
+        std::string CompactJson(const std::string& json) {
+            std::string compact {};
+            compact.reserve(json.size());
+
+            std::istringstream lines(json);
+            std::string line {};
+            while(std::getline(lines, line)) {
+                compact.append(line, std::min(line.find_first_not_of(' '), line.size()));
+            }
+
+            return compact;
+        }
+
+#ifdef __linux__
+        bool MakeAddress(const fs::path& socketPath, sockaddr_un& address) {
+            const std::string path {socketPath.string()};
+            if(path.size() >= sizeof(address.sun_path)) {
+                return false;
+            }
+
+            std::memset(&address, 0, sizeof(address));
+            address.sun_family = AF_UNIX;
+            std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+            return true;
+        }
+
+        int Connect(const fs::path& socketPath) {
+            sockaddr_un address {};
+            if(!MakeAddress(socketPath, address)) {
+                return -1;
+            }
+
+            const int fd {socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)};
+            if(fd >= 0 && connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+                close(fd);
+                return -1;
+            }
+
+            return fd;
+        }
+#endif
+    }
+
+    JobServer::JobServer(const fs::path& socketPath, const unsigned int jobs) :
+        m_SocketPath(socketPath),
+        m_Pool(jobs == 0 ? std::max(1U, std::thread::hardware_concurrency()) : jobs),
+        m_Contexts(m_Pool.WorkerCount()) {}
+
+    JobServer::~JobServer() = default;
+
+    bool JobServer::Run(const std::function<bool()>& stopRequested) {
+#ifdef __linux__
+        sockaddr_un address {};
+        if(!MakeAddress(m_SocketPath, address)) {
+            std::cerr << std::format("The socket path {} is too long.\n", m_SocketPath.string());
+            return false;
+        }
+
+        // A socket file nobody answers on was left behind by a daemon that didn't stop cleanly
+        if(const int other {Connect(m_SocketPath)}; other >= 0) {
+            close(other);
+            std::cerr << std::format("Another daemon is already listening on {}.\n", m_SocketPath.string());
+            return false;
+        }
+        unlink(address.sun_path);
+
+        const int listener {socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)};
+        if(listener < 0 ||
+           bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 ||
+           listen(listener, static_cast<int>(JobServer::MAX_QUEUED_JOBS)) != 0) {
+            std::cerr << std::format("Cannot listen on {}: {}.\n", m_SocketPath.string(), std::strerror(errno));
+            if(listener >= 0) {
+                close(listener);
+            }
+            return false;
+        }
+
+        std::cerr << std::format("Listening on {} with {} workers, press Ctrl+C to stop.\n",
+                                 m_SocketPath.string(), m_Pool.WorkerCount());
+
+        std::thread jobThread(&JobServer::RunJobs, this);
+
+        std::vector<PendingClient> pending {};
+        std::vector<pollfd> polled {};
+
+        while(!stopRequested()) {
+            const std::chrono::steady_clock::time_point now {std::chrono::steady_clock::now()};
+            std::chrono::milliseconds tick {JobServer::ACCEPT_TICK};
+
+            // A request that took too long is taken as it is (and most likely turned down)
+            std::erase_if(pending, [&](const PendingClient& client) {
+                if(client.Deadline <= now) {
+                    QueueRequest(client.Client, client.Text);
+                    return true;
+                }
+
+                tick = std::min(tick, std::chrono::ceil<std::chrono::milliseconds>(client.Deadline - now));
+                return false;
+            });
+
+            polled.assign(1, pollfd {listener, POLLIN, 0});
+            for(const PendingClient& client : pending) {
+                polled.push_back(pollfd {client.Client, POLLIN, 0});
+            }
+
+            if(poll(polled.data(), polled.size(), static_cast<int>(tick.count())) <= 0) {
+                continue;
+            }
+
+            // polled has the listener first, then the pending clients in order
+            for(size_t i {0}; i < pending.size(); i++) {
+                if(polled[i + 1].revents != 0 && ReadRequest(pending[i])) {
+                    QueueRequest(pending[i].Client, pending[i].Text);
+                    pending[i].Client = -1;
+                }
+            }
+            std::erase_if(pending, [](const PendingClient& client) { return client.Client < 0; });
+
+            if(polled.front().revents & POLLIN) {
+                const int client {accept4(listener, nullptr, nullptr, SOCK_CLOEXEC)};
+                if(client < 0) {
+                    continue;
+                }
+
+                // A client that stops reading is given up on, instead of holding up the job thread
+                const timeval sendTimeout {static_cast<time_t>(JobServer::SEND_TIMEOUT.count()), 0};
+                setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &sendTimeout, sizeof(sendTimeout));
+
+                // As many clients may be sending as there are places in the queue
+                if(pending.size() >= JobServer::MAX_QUEUED_JOBS) {
+                    Reply(client, JobRecord(0, "rejected", "Too many clients are sending jobs"));
+                } else {
+                    pending.push_back({client, {}, now + JobServer::REQUEST_TIMEOUT});
+                }
+            }
+        }
+
+        close(listener);
+        unlink(address.sun_path);
+
+        for(const PendingClient& client : pending) {
+            Reply(client.Client, JobRecord(0, "rejected", "The daemon was stopped"));
+        }
+
+        std::deque<QueuedJob> cancelled {};
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Stopping = true;
+
+            for(std::deque<QueuedJob>& queue : m_Queues) {
+                cancelled.insert(cancelled.end(), queue.begin(), queue.end());
+                queue.clear();
+            }
+            m_QueuedJobs = 0;
+        }
+        m_JobReady.notify_all();
+
+        for(const QueuedJob& job : cancelled) {
+            Reply(job.Client, JobRecord(job.Id, "cancelled", "The daemon was stopped"));
+        }
+
+        // The job that is running is finished first
+        jobThread.join();
+        return true;
+#else
+        std::cerr << "The daemon needs Unix domain sockets, it only runs on Linux.\n";
+        return false;
+#endif
+    }
+
+    bool JobServer::Submit(const fs::path& socketPath, const JobRequest& request, std::ostream& out) {
+#ifdef __linux__
+        const int server {Connect(socketPath)};
+        if(server < 0) {
+            std::cerr << std::format("No daemon is listening on {}.\n", socketPath.string());
+            return false;
+        }
+
+        if(!SendAll(server, request.Serialize())) {
+            close(server);
+            std::cerr << "The daemon hung up before it got the job.\n";
+            return false;
+        }
+        shutdown(server, SHUT_WR);
+
+        // The last line says how the job ended
+        std::string line {};
+        std::string lastJobRecord {};
+        char buffer[64 * 1024];
+
+        while(true) {
+            const ssize_t got {recv(server, buffer, sizeof(buffer), 0)};
+            if(got < 0 && errno == EINTR) {
+                continue;
+            }
+            if(got <= 0) {
+                break;
+            }
+
+            out.write(buffer, got);
+
+            for(const char c : std::string_view(buffer, static_cast<size_t>(got))) {
+                if(c != '\n') {
+                    line.push_back(c);
+                    continue;
+                }
+
+                if(line.starts_with("{\"record\":\"job\"")) {
+                    lastJobRecord.swap(line);
+                }
+                line.clear();
+            }
+        }
+
+        close(server);
+        out.flush();
+
+        return lastJobRecord.find("\"status\":\"done\"") != std::string::npos;
+#else
+        std::cerr << "The daemon needs Unix domain sockets, it only runs on Linux.\n";
+        return false;
+#endif
+    }
+
+    bool JobServer::ReadRequest(PendingClient& pending) {
+#ifdef __linux__
+        char buffer[4096];
+
+        // The request ends with an empty line (or when the client stops sending)
+        while(pending.Text.size() <= JobServer::MAX_REQUEST_SIZE &&
+              pending.Text.find("\n\n") == std::string::npos) {
+            const ssize_t got {recv(pending.Client, buffer, sizeof(buffer), MSG_DONTWAIT)};
+            if(got < 0 && errno == EINTR) {
+                continue;
+            }
+            if(got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                return false;
+            }
+            if(got <= 0) {
+                return true;
+            }
+
+            pending.Text.append(buffer, static_cast<size_t>(got));
+        }
+
+        return true;
+#else
+        (void)pending;
+        return true;
+#endif
+    }
+
+    void JobServer::QueueRequest(const int client, std::string_view text) {
+#ifdef __linux__
+        std::string error {};
+        std::optional<JobRequest> request {JobRequest::Parse(text, error)};
+        if(!request) {
+            Reply(client, JobRecord(0, "rejected", error));
+            return;
+        }
+
+        // Only this thread queues jobs, so the place can't be taken in the meantime
+        std::unique_lock<std::mutex> lock(m_Mutex);
+
+        if(m_QueuedJobs >= JobServer::MAX_QUEUED_JOBS) {
+            lock.unlock();
+            Reply(client, JobRecord(0, "rejected", "The queue is full"));
+            return;
+        }
+
+        QueuedJob job {m_NextJobId++, client, std::move(*request)};
+        const std::string queued {std::format("{{\"record\":\"job\",\"id\":{},\"status\":\"queued\",\"position\":{}}}\n",
+                                              job.Id, m_QueuedJobs + 1)};
+        lock.unlock();
+
+        // Sent before it's queued: once it is, the job thread owns the socket.
+        // The connection hasn't had anything sent on it yet, so this never waits for the client
+        SendAll(client, queued);
+
+        lock.lock();
+        m_Queues[static_cast<size_t>(job.Request.Priority)].push_back(std::move(job));
+        m_QueuedJobs++;
+
+        lock.unlock();
+        m_JobReady.notify_one();
+#else
+        (void)client;
+        (void)text;
+#endif
+    }
+
+    void JobServer::RunJobs() {
+        while(true) {
+            QueuedJob job {};
+
+            {
+                std::unique_lock<std::mutex> lock(m_Mutex);
+                m_JobReady.wait(lock, [this]() { return m_Stopping || m_QueuedJobs > 0; });
+
+                if(m_Stopping) {
+                    return;
+                }
+
+                // The most urgent queue that has something
+                for(size_t i {m_Queues.size()}; i-- > 0;) {
+                    if(!m_Queues[i].empty()) {
+                        job = std::move(m_Queues[i].front());
+                        m_Queues[i].pop_front();
+                        m_QueuedJobs--;
+                        break;
+                    }
+                }
+            }
+
+            RunJob(job);
+        }
+    }
+
+    void JobServer::RunJob(const QueuedJob& job) {
+        SocketStreamBuf socketBuffer(job.Client, &JobServer::SendAll);
+        std::ostream records(&socketBuffer);
+
+        AppOptions options {};
+        options.Jobs          = static_cast<unsigned int>(m_Pool.WorkerCount());
+        options.Force         = job.Request.Force;
+        options.XmpDurability = job.Request.XmpDurability;
+        options.Format        = OutputFormat::FORMAT_NDJSON;
+        options.IndexPath     = job.Request.IndexPath;
+
+        std::string status {"done"};
+        std::string message {};
+        std::string stats {};
+
+        // The counters are process-wide; jobs run one at a time, so each one starts them over
+        StageMetrics::Reset();
+
+        std::cerr << std::format("Job {}: {} mode, {} {}.\n", job.Id, AppModeToString(job.Request.Mode),
+                                 job.Request.ContentsPaths.size(),
+                                 job.Request.ContentsPaths.size() == 1 ? "shoot" : "shoots");
+
+        try {
+            Application app(job.Request.Mode, job.Request.ContentsPaths, options, records);
+
+            app.UseWorkers(m_Pool, m_Contexts);
+            app.RetrieveClipFiles();
+            app.SortClipFiles();
+            app.BatchProcessClips();
+
+            if(!app.SaveMarkerIndex()) {
+                status  = "failed";
+                message = "The marker index couldn't be written";
+            }
+
+            std::ostringstream json {};
+            app.WriteStatsJson(json);
+            stats = CompactJson(json.str());
+        } catch(const P2Exception& e) {
+            status  = "failed";
+            message = e.what();
+        } catch(const fs::filesystem_error& e) {
+            status  = "failed";
+            message = std::format("Cannot access path: {}", e.path1().string());
+        } catch(const std::exception&) {
+            status  = "failed";
+            message = "Unexpected error occured during processing";
+        }
+
+        std::cerr << std::format("Job {}: {}{}{}.\n", job.Id, status, message.empty() ? "" : ", ", message);
+
+        // A client that stopped reading would only hold up the next job once more
+        if(socketBuffer.Connected()) {
+            Reply(job.Client, JobRecord(job.Id, status, message, stats));
+        } else {
+            std::cerr << std::format("Job {}: the client is gone or stopped reading, its reply was cut short.\n", job.Id);
+#ifdef __linux__
+            close(job.Client);
+#endif
+        }
+    }
+
+    std::string JobServer::JobRecord(const uint64_t id,
+                                     std::string_view status,
+                                     std::string_view message,
+                                     std::string_view stats) {
+        std::string record {"{\"record\":\"job\",\"id\":"};
+        record.append(id == 0 ? "null" : std::to_string(id));
+        record.append(",\"status\":");
+        StringUtils::AppendQuotedJson(status, record);
+        record.append(",\"message\":");
+        record.append(message.empty() ? "null" : StringUtils::QuoteJson(message));
+        record.append(",\"stats\":");
+        record.append(stats.empty() ? "null" : stats);
+        record.append("}\n");
+        return record;
+    }
+
+    bool JobServer::SendAll(const int socket, std::string_view data) {
+#ifdef __linux__
+        while(!data.empty()) {
+            // A client that hung up mustn't take the daemon down with SIGPIPE
+            const ssize_t sent {send(socket, data.data(), data.size(), MSG_NOSIGNAL)};
+            if(sent < 0 && errno == EINTR) {
+                continue;
+            }
+            if(sent <= 0) {
+                return false;
+            }
+
+            data.remove_prefix(static_cast<size_t>(sent));
+        }
+
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    void JobServer::Reply(const int client, std::string_view record) {
+#ifdef __linux__
+        SendAll(client, record);
+        close(client);
+#endif
+    }
+}
\ No newline at end of file
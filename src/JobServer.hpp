@@ -0,0 +1,127 @@
+/*
+* Project: p2mark
+* File:    JobServer.hpp
+* Desc:    Daemon mode: jobs taken over a local socket header file
+* Created: 2026-10-17
+*/
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "JobRequest.hpp"
+#include "ParseContext.hpp"
+#include "WorkerPool.hpp"
+
+namespace fs = std::filesystem;
+
+namespace p2mark {
+    /// Keeps p2mark running and takes jobs over a Unix domain socket,
+    /// so an ingest system doesn't pay for a new process (and cold caches)
+    /// for every card. Each connection carries one JobRequest; the jobs wait
+    /// in a bounded queue and are run one at a time, by priority, on one
+    /// worker pool whose threads and parse contexts are kept from job to job.
+    /// The reply is NDJSON: a "queued" job record, the records of the job's
+    /// clips and markers (as --format ndjson writes them), then a final job
+    /// record with the outcome and the job's stats (see WriteStatsJson()).
+    /// The messages meant for people go to the daemon's standard error.
+    class JobServer {
+    public:
+        /// Jobs waiting to be run; a client that comes when the queue is full is turned down.
+        static inline constexpr size_t MAX_QUEUED_JOBS {32};
+
+        /// How long the server waits for a connection before checking for Ctrl+C.
+        static inline constexpr std::chrono::milliseconds ACCEPT_TICK {200};
+
+        /// A client has this long to send its whole request. The requests are read
+        /// as they come in, so a slow client only ever holds up itself.
+        static inline constexpr std::chrono::seconds REQUEST_TIMEOUT {5};
+
+        static inline constexpr size_t MAX_REQUEST_SIZE {64 * 1024};
+
+        /// A client that doesn't take any of its reply for this long is treated
+        /// as gone: the job goes on without it and the rest of the reply is dropped.
+        static inline constexpr std::chrono::seconds SEND_TIMEOUT {30};
+
+    public:
+        /// The pool has jobs workers (0 means every CPU core).
+        JobServer(const fs::path& socketPath, const unsigned int jobs);
+        ~JobServer();
+
+        JobServer(const JobServer&) = delete;
+        JobServer& operator=(const JobServer&) = delete;
+
+    public:
+        /// Serves until stopRequested() returns true; the job that is running
+        /// is finished, the queued ones are cancelled. Returns false (and says
+        /// why) if the socket can't be listened on.
+        bool Run(const std::function<bool()>& stopRequested);
+
+        /// Sends the request to the daemon listening on the socket and copies
+        /// its reply to out. Returns false if the job couldn't be submitted
+        /// or didn't finish.
+        static bool Submit(const fs::path& socketPath, const JobRequest& request, std::ostream& out);
+
+    private:
+        struct QueuedJob {
+            uint64_t Id        {0};
+            int Client         {-1};
+            JobRequest Request {};
+        };
+
+        /// A connection whose request hasn't been read in full yet.
+        struct PendingClient {
+            int Client {-1};
+            std::string Text {};
+            std::chrono::steady_clock::time_point Deadline {};
+        };
+
+    private:
+        /// Reads whatever the client has sent so far without waiting for more.
+        /// Returns true once the request is complete (or the client is done sending).
+        static bool ReadRequest(PendingClient& pending);
+
+        /// Parses the client's request and queues it, or turns it down.
+        void QueueRequest(const int client, std::string_view text);
+
+        /// The job thread: runs the queued jobs until the server stops.
+        void RunJobs();
+
+        void RunJob(const QueuedJob& job);
+
+        /// One line of the reply; stats is a JSON object (or empty for null).
+        static std::string JobRecord(const uint64_t id,
+                                     std::string_view status,
+                                     std::string_view message = {},
+                                     std::string_view stats = {});
+
+        /// Sends everything, even if it takes several calls.
+        static bool SendAll(const int socket, std::string_view data);
+
+        /// Sends the line and hangs up.
+        static void Reply(const int client, std::string_view record);
+
+    private:
+        const fs::path m_SocketPath;
+        WorkerPool m_Pool;
+        std::vector<ParseContext> m_Contexts;
+
+        std::mutex m_Mutex;
+        std::condition_variable m_JobReady;
+        std::array<std::deque<QueuedJob>, 3> m_Queues {}; // One per JobPriority
+        size_t m_QueuedJobs {0};
+        uint64_t m_NextJobId {1};
+        bool m_Stopping {false};
+    };
+}
\ No newline at end of file
@@ -0,0 +1,139 @@
+/*
+* Project: p2mark
+* File:    MappedFile.cpp
+* Desc:    Read-only memory-mapped file implementation file
+* Created: 2026-10-17
+*/
+
+#include "MappedFile.hpp"
+
+#include "StageMetrics.hpp"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace p2mark {
+    MappedFile::~MappedFile() {
+        Close();
+    }
+
+    MappedFile::MappedFile(MappedFile&& other) noexcept :
+        m_Data(other.m_Data), m_Size(other.m_Size) {
+        other.m_Data = nullptr;
+        other.m_Size = 0;
+    }
+
+    MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+        if(this != &other) {
+            Close();
+            m_Data = other.m_Data;
+            m_Size = other.m_Size;
+            other.m_Data = nullptr;
+            other.m_Size = 0;
+        }
+
+        return *this;
+    }
+
+#ifdef _WIN32
+    bool MappedFile::Open(const fs::path& path) {
+        Close();
+
+        HANDLE file {CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                 OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr)};
+        if(file == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+
+        LARGE_INTEGER size {};
+        if(!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+            CloseHandle(file);
+            return false;
+        }
+
+        HANDLE mapping {CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr)};
+        if(!mapping) {
+            CloseHandle(file);
+            return false;
+        }
+
+        // The view keeps the mapping alive, the handles aren't needed anymore
+        void* view {MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)};
+        CloseHandle(mapping);
+        CloseHandle(file);
+
+        if(!view) {
+            return false;
+        }
+
+        m_Data = static_cast<const char*>(view);
+        m_Size = static_cast<size_t>(size.QuadPart);
+
+        // Mapped bytes count as read, whether or not all of them get touched
+        StageMetrics::CountSyscalls(Syscall::SYSCALL_OPEN, 2);
+        StageMetrics::CountSyscalls(Syscall::SYSCALL_STAT);
+        StageMetrics::CountSyscalls(Syscall::SYSCALL_MAP, 3);
+        StageMetrics::CountBytesRead(m_Size);
+        return true;
+    }
+
+    void MappedFile::Close() {
+        if(m_Data) {
+            UnmapViewOfFile(m_Data);
+            StageMetrics::CountSyscalls(Syscall::SYSCALL_MAP);
+        }
+
+        m_Data = nullptr;
+        m_Size = 0;
+    }
+#else
+    bool MappedFile::Open(const fs::path& path) {
+        Close();
+
+        const int fd {::open(path.c_str(), O_RDONLY | O_CLOEXEC)};
+        if(fd < 0) {
+            return false;
+        }
+
+        struct stat st {};
+        if(::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+
+        // The mapping stays valid after the descriptor is closed
+        void* view {::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0)};
+        ::close(fd);
+
+        if(view == MAP_FAILED) {
+            return false;
+        }
+
+        m_Data = static_cast<const char*>(view);
+        m_Size = static_cast<size_t>(st.st_size);
+
+        // Mapped bytes count as read, whether or not all of them get touched
+        StageMetrics::CountSyscalls(Syscall::SYSCALL_OPEN, 2);
+        StageMetrics::CountSyscalls(Syscall::SYSCALL_STAT);
+        StageMetrics::CountSyscalls(Syscall::SYSCALL_MAP);
+        StageMetrics::CountBytesRead(m_Size);
+        return true;
+    }
+
+    void MappedFile::Close() {
+        if(m_Data) {
+            ::munmap(const_cast<char*>(m_Data), m_Size);
+            StageMetrics::CountSyscalls(Syscall::SYSCALL_MAP);
+        }
+
+        m_Data = nullptr;
+        m_Size = 0;
+    }
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+/*
+* Project: p2mark
+* File:    MappedFile.hpp
+* Desc:    Read-only memory-mapped file header file
+* Created: 2026-10-17
+*/
+
+#pragma once
+
+#include <filesystem>
+#include <string_view>
+
+namespace fs = std::filesystem;
+
+namespace p2mark {
+    /// A read-only view of a whole file mapped into memory.
+    /// Only the pages that are actually touched get read from disk,
+    /// and the data can be parsed in place without copying it anywhere.
+    class MappedFile {
+    public:
+        MappedFile() = default;
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        MappedFile(MappedFile&& other) noexcept;
+        MappedFile& operator=(MappedFile&& other) noexcept;
+
+    public:
+        /// Maps the file. Returns false if it can't be mapped
+        /// (doesn't exist, is empty, or lives on something that can't do it),
+        /// so the caller can fall back to reading it the usual way.
+        bool Open(const fs::path& path);
+        void Close();
+
+        inline bool IsOpen() const { return m_Data != nullptr; }
+        inline std::string_view View() const { return {m_Data, m_Size}; }
+
+    private:
+        const char* m_Data {nullptr};
+        size_t m_Size      {0};
+    };
+}
\ No newline at end of file
@@ -8,13 +8,16 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 
 namespace p2mark {
     /// A P2 marker. The actual marker data has an additional
     /// 'MemoID' attribute, but it serves no purpose for us;
     /// this is for addressing markers in the camcorder.
+    /// The text isn't owned: it points into the clip data
+    /// held by the XmlReader that produced the marker.
     struct Marker {
-        int offset       {};
-        std::string text {};
+        int offset            {};
+        std::string_view text {};
     };
 }
\ No newline at end of file
@@ -0,0 +1,234 @@
+/*
+* Project: p2mark
+* File:    MarkerIndex.cpp
+* Desc:    Memory-mapped marker index implementation file
+* Created: 2026-10-17
+*/
+
+#include "MarkerIndex.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <iterator>
+
+namespace p2mark {
+    bool MarkerIndex::Open(const fs::path& path) {
+        m_File.Close();
+        m_ClipCount   = 0;
+        m_MarkerCount = 0;
+        m_TokenCount  = 0;
+        std::fill(std::begin(m_Sections), std::end(m_Sections), SectionView {});
+
+        // The arrays are read in place
+        if constexpr(std::endian::native != std::endian::little) {
+            return false;
+        }
+
+        if(!m_File.Open(path)) {
+            return false;
+        }
+
+        const std::string_view file {m_File.View()};
+        if(file.size() < MarkerIndex::HEADER_SIZE || !file.starts_with(MarkerIndex::MAGIC)) {
+            m_File.Close();
+            return false;
+        }
+
+        const SectionView header {file.data() + MarkerIndex::MAGIC.size(),
+                                  MarkerIndex::HEADER_SIZE - MarkerIndex::MAGIC.size()};
+        const uint16_t version      {Load<uint16_t>(header, 0)};
+        const uint16_t sectionCount {Load<uint16_t>(header, 1)};
+
+        if(version != MarkerIndex::VERSION || sectionCount != static_cast<uint16_t>(Section::SECTION_COUNT)) {
+            m_File.Close();
+            return false;
+        }
+
+        // The counts start at byte 8 of the header (after the magic), the sections at byte 32
+        const SectionView counts {header.Data + 8, 24};
+        m_ClipCount   = Load<uint64_t>(counts, 0);
+        m_MarkerCount = Load<uint64_t>(counts, 1);
+        m_TokenCount  = Load<uint64_t>(counts, 2);
+
+        const SectionView table {header.Data + 32, static_cast<uint64_t>(sectionCount) * 16};
+        for(size_t i {0}; i < static_cast<size_t>(Section::SECTION_COUNT); i++) {
+            const uint64_t offset {Load<uint64_t>(table, i * 2)};
+            const uint64_t size   {Load<uint64_t>(table, i * 2 + 1)};
+
+            if(offset % 8 != 0 || offset > file.size() || size > file.size() - offset) {
+                m_File.Close();
+                return false;
+            }
+
+            m_Sections[i] = {file.data() + offset, size};
+        }
+
+        // Marker numbers are 32-bit; every array has to be as long as the counts say
+        const bool sized {
+            m_MarkerCount <= std::numeric_limits<uint32_t>::max() &&
+            m_ClipCount <= m_MarkerCount &&
+            Get(Section::SECTION_CLIP_PATHS).Size == (m_ClipCount + 1) * sizeof(uint64_t) &&
+            Get(Section::SECTION_CLIP_MARKERS).Size == (m_ClipCount + 1) * sizeof(uint32_t) &&
+            Get(Section::SECTION_OFFSETS).Size == m_MarkerCount * sizeof(int32_t) &&
+            Get(Section::SECTION_TEXTS).Size == (m_MarkerCount + 1) * sizeof(uint64_t) &&
+            Get(Section::SECTION_TOKENS).Size == (m_TokenCount + 1) * sizeof(uint64_t) &&
+            Get(Section::SECTION_POSTINGS).Size == (m_TokenCount + 1) * sizeof(uint64_t) &&
+            Get(Section::SECTION_MARKER_LIST).Size % sizeof(uint32_t) == 0
+        };
+
+        if(!sized) {
+            m_File.Close();
+            return false;
+        }
+
+        return true;
+    }
+
+    std::string_view MarkerIndex::ClipPath(const uint32_t clip) const {
+        if(clip >= m_ClipCount) {
+            return {};
+        }
+
+        return Slice(Get(Section::SECTION_CLIP_PATHS), Get(Section::SECTION_PATH_BLOB), clip);
+    }
+
+    uint32_t MarkerIndex::ClipOf(const uint32_t marker) const {
+        // The last clip whose first marker isn't past this one
+        const SectionView& firsts {Get(Section::SECTION_CLIP_MARKERS)};
+        uint64_t low  {0};
+        uint64_t high {m_ClipCount};
+
+        while(low < high) {
+            const uint64_t middle {low + (high - low) / 2};
+            if(Load<uint32_t>(firsts, middle + 1) <= marker) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+
+        return static_cast<uint32_t>(low);
+    }
+
+    int32_t MarkerIndex::Offset(const uint32_t marker) const {
+        return marker < m_MarkerCount ? Load<int32_t>(Get(Section::SECTION_OFFSETS), marker) : 0;
+    }
+
+    std::string_view MarkerIndex::Text(const uint32_t marker) const {
+        if(marker >= m_MarkerCount) {
+            return {};
+        }
+
+        return Slice(Get(Section::SECTION_TEXTS), Get(Section::SECTION_TEXT_BLOB), marker);
+    }
+
+    std::vector<uint32_t> MarkerIndex::Find(const MarkerQuery& query) const {
+        std::vector<std::string> words {};
+        ForEachToken(query.Text, [&words](std::string_view token) {
+            words.emplace_back(token);
+        });
+
+        const auto inRange = [this, &query](const uint32_t marker) {
+            const int32_t offset {Offset(marker)};
+            return offset >= query.MinOffset && offset <= query.MaxOffset;
+        };
+
+        std::vector<uint32_t> found {};
+
+        // No words: only the offsets, which are one flat array
+        if(words.empty()) {
+            for(uint32_t marker {0}; marker < m_MarkerCount; marker++) {
+                if(inRange(marker)) {
+                    found.push_back(marker);
+                }
+            }
+            return found;
+        }
+
+        // The rarest words first keep the intersections small
+        std::vector<std::vector<uint32_t>> lists {};
+        lists.reserve(words.size());
+        for(const std::string& word : words) {
+            lists.emplace_back(MarkersWithPrefix(word));
+            if(lists.back().empty()) {
+                return found;
+            }
+        }
+
+        std::sort(lists.begin(), lists.end(), [](const std::vector<uint32_t>& a, const std::vector<uint32_t>& b) {
+            return a.size() < b.size();
+        });
+
+        found = std::move(lists.front());
+        std::vector<uint32_t> both {};
+
+        for(size_t i {1}; i < lists.size() && !found.empty(); i++) {
+            both.clear();
+            std::set_intersection(found.begin(), found.end(), lists[i].begin(), lists[i].end(),
+                                  std::back_inserter(both));
+            found.swap(both);
+        }
+
+        std::erase_if(found, [&inRange](const uint32_t marker) { return !inRange(marker); });
+        return found;
+    }
+
+    std::string_view MarkerIndex::Slice(const SectionView& offsets, const SectionView& blob, const uint64_t index) {
+        const uint64_t begin {Load<uint64_t>(offsets, index)};
+        const uint64_t end   {Load<uint64_t>(offsets, index + 1)};
+
+        if(begin > end || end > blob.Size) {
+            return {};
+        }
+
+        return {blob.Data + begin, static_cast<size_t>(end - begin)};
+    }
+
+    std::string_view MarkerIndex::Token(const uint64_t token) const {
+        return Slice(Get(Section::SECTION_TOKENS), Get(Section::SECTION_TOKEN_BLOB), token);
+    }
+
+    std::vector<uint32_t> MarkerIndex::MarkersWithPrefix(std::string_view prefix) const {
+        // The words are sorted, so the ones with the prefix are next to each other
+        uint64_t low  {0};
+        uint64_t high {m_TokenCount};
+
+        while(low < high) {
+            const uint64_t middle {low + (high - low) / 2};
+            if(Token(middle) < prefix) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+
+        const SectionView& postings {Get(Section::SECTION_POSTINGS)};
+        const SectionView& list     {Get(Section::SECTION_MARKER_LIST)};
+        const uint64_t listLength   {list.Size / sizeof(uint32_t)};
+
+        std::vector<uint32_t> markers {};
+        size_t words {0};
+
+        for(uint64_t token {low}; token < m_TokenCount && Token(token).starts_with(prefix); token++) {
+            const uint64_t begin {Load<uint64_t>(postings, token)};
+            const uint64_t end   {std::min(Load<uint64_t>(postings, token + 1), listLength)};
+
+            for(uint64_t i {begin}; i < end; i++) {
+                const uint32_t marker {Load<uint32_t>(list, i)};
+                if(marker < m_MarkerCount) {
+                    markers.push_back(marker);
+                }
+            }
+
+            words++;
+        }
+
+        // Each word's markers are sorted already; several words have to be merged
+        if(words > 1) {
+            std::sort(markers.begin(), markers.end());
+            markers.erase(std::unique(markers.begin(), markers.end()), markers.end());
+        }
+
+        return markers;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,164 @@
+/*
+* Project: p2mark
+* File:    MarkerIndex.hpp
+* Desc:    Memory-mapped marker index header file
+* Created: 2026-10-17
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "MappedFile.hpp"
+
+namespace fs = std::filesystem;
+
+namespace p2mark {
+    /// What a query asks for; every part of it has to match.
+    struct MarkerQuery {
+        /// Every word of it has to begin a word of the memo text (ignoring
+        /// the case of ASCII letters): "gran canyon" finds "Grand Canyon at dusk".
+        /// Empty: any text.
+        std::string Text {};
+        int32_t MinOffset {std::numeric_limits<int32_t>::min()};
+        int32_t MaxOffset {std::numeric_limits<int32_t>::max()};
+    };
+
+    /// The markers of many shoots in one file, laid out to be mapped
+    /// and searched in place: nothing is parsed or copied when it's opened.
+    /// All numbers are little-endian, every section starts 8-byte aligned.
+    ///
+    ///   header        magic, version, counts and a table of the sections
+    ///   clip paths    uint64[clips + 1], where each path begins in the path blob
+    ///   clip markers  uint32[clips + 1], the first marker of each clip
+    ///   path blob     the full paths of the clip files
+    ///   offsets       int32[markers], the frame offset of each marker
+    ///   texts         uint64[markers + 1], where each text begins in the text blob
+    ///   text blob     the memo texts
+    ///   tokens        uint64[tokens + 1], where each word begins in the token blob
+    ///   token blob    the words of all the memos, lowercased and sorted
+    ///   postings      uint64[tokens + 1], where the markers of each word begin
+    ///                 in the marker list
+    ///   marker list   uint32[], the markers that have each word, ascending
+    ///
+    /// The clips are sorted by path, their markers stay in clip order, so
+    /// marker numbers ascend with the clip path and then with the position.
+    class MarkerIndex {
+    public:
+        static inline constexpr std::string_view MAGIC {"P2MARKIX"};
+        static inline constexpr uint16_t VERSION       {1};
+
+        /// A word is a run of ASCII letters and digits, and of any bytes
+        /// above ASCII (so UTF-8 letters don't split words). Longer ones
+        /// are cut off at this length, in the index and in queries alike.
+        static inline constexpr size_t MAX_TOKEN_LENGTH {64};
+
+        enum class Section : uint8_t {
+            SECTION_CLIP_PATHS = 0,
+            SECTION_CLIP_MARKERS,
+            SECTION_PATH_BLOB,
+            SECTION_OFFSETS,
+            SECTION_TEXTS,
+            SECTION_TEXT_BLOB,
+            SECTION_TOKENS,
+            SECTION_TOKEN_BLOB,
+            SECTION_POSTINGS,
+            SECTION_MARKER_LIST,
+            SECTION_COUNT
+        };
+
+        /// Magic (8), version (2), section count (2), reserved (4),
+        /// clip, marker and token counts (8 each), then an offset and a size
+        /// (8 each) per section.
+        static inline constexpr size_t HEADER_SIZE {
+            MAGIC.size() + 8 + 3 * 8 + static_cast<size_t>(Section::SECTION_COUNT) * 16
+        };
+
+    public:
+        /// Returns false if the file can't be mapped, isn't an index
+        /// or is damaged; a damaged section can't make a query read
+        /// outside the file, it only makes the answers wrong.
+        bool Open(const fs::path& path);
+
+        inline uint64_t ClipCount() const { return m_ClipCount; }
+        inline uint64_t MarkerCount() const { return m_MarkerCount; }
+        inline uint64_t TokenCount() const { return m_TokenCount; }
+
+        std::string_view ClipPath(const uint32_t clip) const;
+        uint32_t ClipOf(const uint32_t marker) const;
+        int32_t Offset(const uint32_t marker) const;
+        std::string_view Text(const uint32_t marker) const;
+
+        /// The markers that match, ascending.
+        std::vector<uint32_t> Find(const MarkerQuery& query) const;
+
+        /// Calls onToken(word) with every word of the text, lowercased
+        /// into a buffer that is reused for the next one.
+        template<typename OnToken>
+        static void ForEachToken(std::string_view text, OnToken&& onToken);
+
+    private:
+        struct SectionView {
+            const char* Data {nullptr};
+            uint64_t Size    {0};
+        };
+
+        template<typename T>
+        static inline T Load(const SectionView& section, const uint64_t index) {
+            T value {};
+            std::memcpy(&value, section.Data + index * sizeof(T), sizeof(T));
+            return value;
+        }
+
+        inline const SectionView& Get(const Section section) const {
+            return m_Sections[static_cast<size_t>(section)];
+        }
+
+        /// A slice of a blob, or nothing if the offsets make no sense.
+        static std::string_view Slice(const SectionView& offsets, const SectionView& blob, const uint64_t index);
+
+        std::string_view Token(const uint64_t token) const;
+
+        /// The markers of every word that begins with the prefix, ascending.
+        std::vector<uint32_t> MarkersWithPrefix(std::string_view prefix) const;
+
+    private:
+        MappedFile m_File {};
+        SectionView m_Sections[static_cast<size_t>(Section::SECTION_COUNT)] {};
+        uint64_t m_ClipCount   {0};
+        uint64_t m_MarkerCount {0};
+        uint64_t m_TokenCount  {0};
+    };
+
+    template<typename OnToken>
+    void MarkerIndex::ForEachToken(std::string_view text, OnToken&& onToken) {
+        char token[MarkerIndex::MAX_TOKEN_LENGTH] {};
+        size_t length {0};
+        bool inToken  {false};
+
+        const auto isTokenByte = [](const unsigned char c) {
+            return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c >= 0x80;
+        };
+
+        for(size_t i {0}; i <= text.size(); i++) {
+            const unsigned char c {i < text.size() ? static_cast<unsigned char>(text[i]) : static_cast<unsigned char>(' ')};
+
+            if(isTokenByte(c)) {
+                if(length < MarkerIndex::MAX_TOKEN_LENGTH) {
+                    token[length++] = static_cast<char>(c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c);
+                }
+                inToken = true;
+            } else if(inToken) {
+                onToken(std::string_view(token, length));
+                length  = 0;
+                inToken = false;
+            }
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,202 @@
+/*
+* Project: p2mark
+* File:    MarkerIndexBuilder.cpp
+* Desc:    Marker index builder implementation file
+* Created: 2026-10-17
+*/
+
+#include "MarkerIndexBuilder.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <unordered_map>
+
+#include "AtomicFileWriter.hpp"
+
+namespace p2mark {
+    namespace {
+        template<typename T>
+        void Append(std::string& out, const T value) {
+            char bytes[sizeof(T)] {};
+            std::memcpy(bytes, &value, sizeof(T));
+            out.append(bytes, sizeof(T));
+        }
+
+        template<typename T>
+        void Store(std::string& out, const size_t at, const T value) {
+            std::memcpy(out.data() + at, &value, sizeof(T));
+        }
+
+        void AlignTo8(std::string& out) {
+            out.resize((out.size() + 7) / 8 * 8, '\0');
+        }
+    }
+
+    void MarkerIndexBuilder::AddClip(std::string_view clipPath, std::span<const Marker> markers) {
+        if(markers.empty()) {
+            return;
+        }
+
+        std::scoped_lock lock {m_Mutex};
+
+        m_Clips.push_back({std::string(clipPath), m_Markers.Append(markers)});
+    }
+
+    bool MarkerIndexBuilder::Save(const fs::path& path, const Durability durability) {
+        std::scoped_lock lock {m_Mutex};
+
+        if(m_Markers.Size() > std::numeric_limits<uint32_t>::max()) {
+            return false;
+        }
+
+        const std::string data {Serialize()};
+
+        AtomicFileWriter writer(durability);
+        return writer.Write(path, data) && writer.Commit().empty();
+    }
+
+    std::string MarkerIndexBuilder::Serialize() const {
+        using Section = MarkerIndex::Section;
+
+        // Workers finish clips in any order; the index doesn't depend on it
+        std::vector<size_t> clipOrder(m_Clips.size());
+        std::iota(clipOrder.begin(), clipOrder.end(), size_t {0});
+        std::sort(clipOrder.begin(), clipOrder.end(), [this](const size_t a, const size_t b) {
+            return m_Clips[a].Path < m_Clips[b].Path;
+        });
+
+        // Markers in their final order, by where they were added
+        std::vector<uint64_t> markerOrder {};
+        markerOrder.reserve(m_Markers.Size());
+        for(const size_t clip : clipOrder) {
+            for(uint64_t i {0}; i < m_Clips[clip].Markers.Count; i++) {
+                markerOrder.push_back(m_Clips[clip].Markers.First + i);
+            }
+        }
+
+        // Every word, with the (renumbered, so ascending) markers that have it
+        std::unordered_map<std::string, uint32_t> tokenIds {};
+        std::vector<std::vector<uint32_t>> postings {};
+
+        for(uint32_t marker {0}; marker < markerOrder.size(); marker++) {
+            MarkerIndex::ForEachToken(m_Markers.Text(markerOrder[marker]), [&](std::string_view token) {
+                const auto [it, added] {tokenIds.try_emplace(std::string(token), static_cast<uint32_t>(postings.size()))};
+                if(added) {
+                    postings.emplace_back();
+                }
+
+                std::vector<uint32_t>& markers {postings[it->second]};
+                if(markers.empty() || markers.back() != marker) {
+                    markers.push_back(marker);
+                }
+            });
+        }
+
+        std::vector<const std::pair<const std::string, uint32_t>*> tokens {};
+        tokens.reserve(tokenIds.size());
+        for(const auto& token : tokenIds) {
+            tokens.push_back(&token);
+        }
+        std::sort(tokens.begin(), tokens.end(), [](const auto* a, const auto* b) { return a->first < b->first; });
+
+        // The header is filled in once the sections are where they'll stay
+        std::string out(MarkerIndex::HEADER_SIZE, '\0');
+        std::memcpy(out.data(), MarkerIndex::MAGIC.data(), MarkerIndex::MAGIC.size());
+        Store<uint16_t>(out, 8, MarkerIndex::VERSION);
+        Store<uint16_t>(out, 10, static_cast<uint16_t>(Section::SECTION_COUNT));
+        Store<uint64_t>(out, 16, clipOrder.size());
+        Store<uint64_t>(out, 24, markerOrder.size());
+        Store<uint64_t>(out, 32, tokens.size());
+
+        size_t sectionStart {0};
+        const auto beginSection = [&out, &sectionStart]() {
+            AlignTo8(out);
+            sectionStart = out.size();
+        };
+        const auto endSection = [&out, &sectionStart](const Section section) {
+            const size_t entry {40 + static_cast<size_t>(section) * 16};
+            Store<uint64_t>(out, entry, sectionStart);
+            Store<uint64_t>(out, entry + 8, out.size() - sectionStart);
+        };
+
+        beginSection();
+        uint64_t blobOffset {0};
+        for(const size_t clip : clipOrder) {
+            Append<uint64_t>(out, blobOffset);
+            blobOffset += m_Clips[clip].Path.size();
+        }
+        Append<uint64_t>(out, blobOffset);
+        endSection(Section::SECTION_CLIP_PATHS);
+
+        beginSection();
+        uint32_t firstMarker {0};
+        for(const size_t clip : clipOrder) {
+            Append<uint32_t>(out, firstMarker);
+            firstMarker += m_Clips[clip].Markers.Count;
+        }
+        Append<uint32_t>(out, firstMarker);
+        endSection(Section::SECTION_CLIP_MARKERS);
+
+        beginSection();
+        for(const size_t clip : clipOrder) {
+            out.append(m_Clips[clip].Path);
+        }
+        endSection(Section::SECTION_PATH_BLOB);
+
+        beginSection();
+        for(const uint64_t marker : markerOrder) {
+            Append<int32_t>(out, m_Markers.Offset(marker));
+        }
+        endSection(Section::SECTION_OFFSETS);
+
+        beginSection();
+        blobOffset = 0;
+        for(const uint64_t marker : markerOrder) {
+            Append<uint64_t>(out, blobOffset);
+            blobOffset += m_Markers.Text(marker).size();
+        }
+        Append<uint64_t>(out, blobOffset);
+        endSection(Section::SECTION_TEXTS);
+
+        beginSection();
+        for(const uint64_t marker : markerOrder) {
+            out.append(m_Markers.Text(marker));
+        }
+        endSection(Section::SECTION_TEXT_BLOB);
+
+        beginSection();
+        blobOffset = 0;
+        for(const auto* token : tokens) {
+            Append<uint64_t>(out, blobOffset);
+            blobOffset += token->first.size();
+        }
+        Append<uint64_t>(out, blobOffset);
+        endSection(Section::SECTION_TOKENS);
+
+        beginSection();
+        for(const auto* token : tokens) {
+            out.append(token->first);
+        }
+        endSection(Section::SECTION_TOKEN_BLOB);
+
+        beginSection();
+        uint64_t listOffset {0};
+        for(const auto* token : tokens) {
+            Append<uint64_t>(out, listOffset);
+            listOffset += postings[token->second].size();
+        }
+        Append<uint64_t>(out, listOffset);
+        endSection(Section::SECTION_POSTINGS);
+
+        beginSection();
+        for(const auto* token : tokens) {
+            for(const uint32_t marker : postings[token->second]) {
+                Append<uint32_t>(out, marker);
+            }
+        }
+        endSection(Section::SECTION_MARKER_LIST);
+
+        return out;
+    }
+}
\ No newline at end of file
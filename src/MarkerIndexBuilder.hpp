@@ -0,0 +1,57 @@
+/*
+* Project: p2mark
+* File:    MarkerIndexBuilder.hpp
+* Desc:    Marker index builder header file
+* Created: 2026-10-17
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Durability.hpp"
+#include "Marker.hpp"
+#include "MarkerIndex.hpp"
+#include "MarkerStore.hpp"
+
+namespace fs = std::filesystem;
+
+namespace p2mark {
+    /// Collects the markers of every clip read during a run and writes
+    /// them out as a MarkerIndex. Clips can be added from any worker,
+    /// in any order: they are sorted by path when the index is written,
+    /// so the same shoots always give the same file.
+    class MarkerIndexBuilder {
+    public:
+        /// Copies the markers (their texts included); clips without markers are left out.
+        /// Can be called from several threads.
+        void AddClip(std::string_view clipPath, std::span<const Marker> markers);
+
+        /// Writes the index (through a temporary file, like the XMPs).
+        /// Returns false if it couldn't be written.
+        bool Save(const fs::path& path, const Durability durability);
+
+        inline size_t ClipCount() const { return m_Clips.size(); }
+        inline size_t MarkerCount() const { return m_Markers.Size(); }
+
+    private:
+        struct PendingClip {
+            std::string Path    {};
+            MarkerRange Markers {};
+        };
+
+        /// The whole file, in memory.
+        std::string Serialize() const;
+
+    private:
+        std::mutex m_Mutex;
+        std::vector<PendingClip> m_Clips {};
+        MarkerStore m_Markers {};
+    };
+}
\ No newline at end of file
@@ -0,0 +1,35 @@
+/*
+* Project: p2mark
+* File:    MarkerStore.cpp
+* Desc:    Structure-of-arrays marker storage implementation file
+* Created: 2026-10-17
+*/
+
+#include "MarkerStore.hpp"
+
+namespace p2mark {
+    MarkerRange MarkerStore::Append(std::span<const Marker> markers) {
+        const MarkerRange range {m_Offsets.size(), static_cast<uint32_t>(markers.size())};
+
+        // The arrays grow geometrically, like any vector: a store that holds
+        // a whole archive reallocates a few dozen times, not once per clip
+        for(const Marker& marker : markers) {
+            m_Texts.append(marker.text);
+            m_Offsets.push_back(marker.offset);
+            m_TextEnds.push_back(m_Texts.size());
+        }
+
+        return range;
+    }
+
+    std::string_view MarkerStore::Text(const uint64_t marker) const {
+        const uint64_t begin {marker == 0 ? 0 : m_TextEnds[marker - 1]};
+        return {m_Texts.data() + begin, static_cast<size_t>(m_TextEnds[marker] - begin)};
+    }
+
+    void MarkerStore::Clear() {
+        m_Offsets.clear();
+        m_TextEnds.clear();
+        m_Texts.clear();
+    }
+}
\ No newline at end of file
@@ -0,0 +1,105 @@
+/*
+* Project: p2mark
+* File:    MarkerStore.hpp
+* Desc:    Structure-of-arrays marker storage header file
+* Created: 2026-10-17
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <iterator>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Marker.hpp"
+
+namespace p2mark {
+    /// Where the markers of one clip are in a MarkerStore.
+    struct MarkerRange {
+        uint64_t First {0};
+        uint32_t Count {0};
+
+        inline bool IsEmpty() const { return Count == 0; }
+    };
+
+    class MarkerStore;
+
+    /// The markers of one clip in a store, read like a std::span<const Marker>;
+    /// the texts point into the store, so it mustn't grow while they're in use.
+    class MarkerView {
+    public:
+        class Iterator {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type        = Marker;
+            using difference_type   = std::ptrdiff_t;
+            using pointer           = void;
+            using reference         = Marker;
+
+            Iterator() = default;
+            Iterator(const MarkerStore* store, const uint64_t index) : m_Store(store), m_Index(index) {}
+
+            Marker operator*() const;
+            inline Iterator& operator++() { m_Index++; return *this; }
+            inline Iterator operator++(int) { Iterator old {*this}; m_Index++; return old; }
+            inline bool operator==(const Iterator& other) const { return m_Index == other.m_Index; }
+
+        private:
+            const MarkerStore* m_Store {nullptr};
+            uint64_t m_Index {0};
+        };
+
+    public:
+        MarkerView(const MarkerStore& store, const MarkerRange range) : m_Store(&store), m_Range(range) {}
+
+        inline size_t size() const { return m_Range.Count; }
+        inline bool empty() const { return m_Range.Count == 0; }
+        Marker operator[](const size_t i) const;
+
+        inline Iterator begin() const { return {m_Store, m_Range.First}; }
+        inline Iterator end() const { return {m_Store, m_Range.First + m_Range.Count}; }
+
+    private:
+        const MarkerStore* m_Store;
+        MarkerRange m_Range;
+    };
+
+    /// The markers of many clips (a whole shoot, archive or index) in three
+    /// flat arrays: the offsets, where each text ends, and the texts one
+    /// after another. A clip is a range of them; holding on to a clip's
+    /// markers costs no allocation of its own, and 100k clips with a memo
+    /// each take a few MB. Not thread-safe: the owner locks it if it has to.
+    class MarkerStore {
+    public:
+        /// Copies the markers (their texts included) to the end of the store.
+        MarkerRange Append(std::span<const Marker> markers);
+
+        inline uint64_t Size() const { return m_Offsets.size(); }
+        inline bool IsEmpty() const { return m_Offsets.empty(); }
+
+        inline int Offset(const uint64_t marker) const { return m_Offsets[marker]; }
+        std::string_view Text(const uint64_t marker) const;
+        inline Marker At(const uint64_t marker) const { return {Offset(marker), Text(marker)}; }
+
+        inline MarkerView View(const MarkerRange range) const { return {*this, range}; }
+
+        /// Forgets every marker, keeping the memory.
+        void Clear();
+
+    private:
+        std::vector<int32_t> m_Offsets {};
+        std::vector<uint64_t> m_TextEnds {}; // Where each text ends in m_Texts (and the next one begins)
+        std::string m_Texts {};
+    };
+
+    inline Marker MarkerView::Iterator::operator*() const {
+        return m_Store->At(m_Index);
+    }
+
+    inline Marker MarkerView::operator[](const size_t i) const {
+        return m_Store->At(m_Range.First + i);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+/*
+* Project: p2mark
+* File:    OutputFormat.hpp
+* Desc:    Describes what the application writes to the standard output
+* Created: 2026-10-17
+*/
+
+#pragma once
+
+#include <optional>
+#include <string_view>
+
+namespace p2mark {
+    /// Text is for people. The other formats are for other programs:
+    /// one record per clip and per marker, and nothing else on the standard
+    /// output (the messages meant for people go to the standard error).
+    enum class OutputFormat {
+        FORMAT_TEXT = 0, // The usual messages and stats
+        FORMAT_NDJSON,   // One JSON object per line
+        FORMAT_CSV       // A header line, then one row per record
+    };
+
+    constexpr inline std::string_view OutputFormatToString(const OutputFormat format) {
+        if(format == OutputFormat::FORMAT_NDJSON) {
+            return "ndjson";
+        } else if(format == OutputFormat::FORMAT_CSV) {
+            return "csv";
+        } else {
+            return "text";
+        }
+    }
+
+    constexpr inline std::optional<OutputFormat> OutputFormatFromString(std::string_view name) {
+        for(const OutputFormat format : {OutputFormat::FORMAT_TEXT,
+                                         OutputFormat::FORMAT_NDJSON,
+                                         OutputFormat::FORMAT_CSV}) {
+            if(OutputFormatToString(format) == name) {
+                return format;
+            }
+        }
+
+        return std::nullopt;
+    }
+}
\ No newline at end of file
@@ -9,6 +9,7 @@
 
 #include <exception>
 #include <string>
+#include <string_view>
 
 namespace p2mark {
     /// Specifies the kind of exception
@@ -21,6 +22,13 @@ namespace p2mark {
         CODE_XMP_WRITE_ERROR
     };
 
+    constexpr inline std::string_view P2ExceptionCodeToString(const P2ExceptionCode code) {
+        constexpr std::string_view names[] {
+            "generic", "filesystem_error", "xml_read_error", "xmp_read_error", "xmp_write_error"
+        };
+        return code <= P2ExceptionCode::CODE_XMP_WRITE_ERROR ? names[static_cast<size_t>(code)] : "unknown";
+    }
+
     class P2Exception : public std::exception {
     public:
         P2Exception(const std::string& message)
@@ -26,10 +26,17 @@ namespace p2mark {
     }
 
     ClipValidationResult P2Validator::ValidateClip(const fs::directory_entry& clipFile) {
+        StageTimer timer(Stage::STAGE_VALIDATE);
+        StageMetrics::CountSyscalls(Syscall::SYSCALL_STAT);
+
         const bool regular {clipFile.is_regular_file()};
         const bool hasRightExt {clipFile.path().extension().string() == XML_EXT};
         const uintmax_t fileSize {clipFile.file_size()};
 
+        return ValidateClip(regular, fileSize, hasRightExt);
+    }
+
+    ClipValidationResult P2Validator::ValidateClip(const bool regular, const uintmax_t fileSize, const bool hasRightExt) {
         if(fileSize == 0) {
             return ClipValidationResult::EMPTY_CLIP_FILE; // Useless empty file
         } else if(fileSize >= P2Validator::CLIP_SIZE_LIMIT) {
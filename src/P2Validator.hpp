@@ -10,6 +10,7 @@
 #include <filesystem>
 
 #include "Constants.hpp"
+#include "StageMetrics.hpp"
 
 namespace fs = std::filesystem;
 
@@ -46,6 +47,10 @@ namespace p2mark {
         static P2ValidationResult Validate(const fs::path& contentsDirPath);
         static ClipValidationResult ValidateClip(const fs::directory_entry& clipFile);
 
+        /// The same checks for an entry whose type and size are already known
+        /// (ClipScanner gets them straight from the directory listing).
+        static ClipValidationResult ValidateClip(const bool regular, const uintmax_t fileSize, const bool hasRightExt);
+
     private:
         static P2ValidationResult ValidateContentsDir(const fs::path& contentsDirPath);
         static P2ValidationResult ValidateClipsDir(const fs::path& clipsDirPath);
@@ -0,0 +1,40 @@
+/*
+* Project: p2mark
+* File:    ParseContext.cpp
+* Desc:    Reusable per-worker parsing state implementation file
+* Created: 2026-10-17
+*/
+
+#include "ParseContext.hpp"
+
+namespace p2mark {
+    ParseContext::ParseContext() {
+        m_Markers.reserve(ParseContext::MARKERS_RESERVE);
+    }
+
+    void ParseContext::BeginClip() {
+        m_Markers.clear();
+        m_OwnedTextCount = 0;
+
+        Trim(m_ReadBuffer);
+        Trim(m_OutputBuffer);
+    }
+
+    std::string& ParseContext::NextOwnedText() {
+        if(m_OwnedTextCount == m_OwnedTexts.size()) {
+            m_OwnedTexts.emplace_back();
+        }
+
+        std::string& text {m_OwnedTexts[m_OwnedTextCount++]};
+        text.clear();
+        return text;
+    }
+
+    void ParseContext::Trim(std::string& buffer) {
+        if(buffer.capacity() > ParseContext::BUFFER_KEEP_LIMIT) {
+            std::string {}.swap(buffer);
+        } else {
+            buffer.clear();
+        }
+    }
+}
\ No newline at end of file
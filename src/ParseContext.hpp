@@ -0,0 +1,70 @@
+/*
+* Project: p2mark
+* File:    ParseContext.hpp
+* Desc:    Reusable per-worker parsing state header file
+* Created: 2026-10-17
+*/
+
+#pragma once
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "tinyxml2.h"
+
+#include "Marker.hpp"
+
+namespace p2mark {
+    /// Everything reading and writing a clip needs memory for, kept by one
+    /// worker from one clip to the next: the documents (tinyxml2 keeps the
+    /// memory pools of a cleared document), the read buffer, the markers
+    /// and the decoded memo texts. Once a worker has seen a few clips,
+    /// processing another one hardly allocates anything.
+    /// One context serves one clip at a time; the markers of a clip
+    /// stay valid until the next clip begins.
+    class alignas(64) ParseContext {
+    public:
+        /// Per P2 standard, this is max markers per clip.
+        static inline constexpr size_t MARKERS_RESERVE {100};
+
+        /// A buffer that grew past this (an unusually large clip or XMP)
+        /// is given back instead of being kept for the next clip.
+        static inline constexpr size_t BUFFER_KEEP_LIMIT {1024 * 1024};
+
+    public:
+        ParseContext();
+
+        ParseContext(const ParseContext&) = delete;
+        ParseContext& operator=(const ParseContext&) = delete;
+
+    public:
+        /// Forgets the previous clip (its markers and texts), keeping the memory.
+        void BeginClip();
+
+        /// An empty string for a decoded memo text; it doesn't move
+        /// until the next clip begins, so views of it can be handed out.
+        std::string& NextOwnedText();
+
+        inline std::vector<Marker>& Markers() { return m_Markers; }
+        inline std::string& ReadBuffer() { return m_ReadBuffer; }
+        inline std::string& OutputBuffer() { return m_OutputBuffer; }
+        inline tinyxml2::XMLDocument& ClipDocument() { return m_ClipDoc; }
+        inline tinyxml2::XMLDocument& XmpDocument() { return m_XmpDoc; }
+
+    private:
+        static void Trim(std::string& buffer);
+
+    private:
+        tinyxml2::XMLDocument m_ClipDoc {};
+        tinyxml2::XMLDocument m_XmpDoc {};
+        std::string m_ReadBuffer {};   // The clip, when it isn't mapped
+        std::string m_OutputBuffer {}; // The XMP being written
+        std::vector<Marker> m_Markers {};
+
+        /// A deque never moves its elements, and the strings keep their
+        /// capacity; only the first m_OwnedTextCount belong to this clip.
+        std::deque<std::string> m_OwnedTexts {};
+        size_t m_OwnedTextCount {0};
+    };
+}
\ No newline at end of file
@@ -0,0 +1,152 @@
+/*
+* Project: p2mark
+* File:    RecordWriter.cpp
+* Desc:    Buffered NDJSON/CSV record writer implementation file
+* Created: 2026-10-17
+*/
+
+#include "RecordWriter.hpp"
+
+#include <charconv>
+
+#include "StageMetrics.hpp"
+#include "Utils.hpp"
+
+namespace p2mark {
+    RecordWriter::RecordWriter(const OutputFormat format, std::ostream& out) :
+        m_Format(format), m_Out(out) {
+
+        m_Buffer.reserve(RecordWriter::BUFFER_SIZE);
+
+        if(m_Format == OutputFormat::FORMAT_CSV) {
+            m_Buffer.append(RecordWriter::CSV_HEADER);
+        }
+    }
+
+    RecordWriter::~RecordWriter() {
+        try {
+            Flush();
+        } catch(...) {
+            // Nothing can be done about it this late
+        }
+    }
+
+    void RecordWriter::FormatMarkers(const OutputFormat format,
+                                     std::string_view clip,
+                                     std::string_view xmp,
+                                     std::span<const Marker> markers,
+                                     std::string& out) {
+        for(const Marker& mark : markers) {
+            if(format == OutputFormat::FORMAT_NDJSON) {
+                out.append("{\"record\":\"marker\",\"clip\":");
+                StringUtils::AppendQuotedJson(clip, out);
+                out.append(",\"xmp\":");
+                AppendJsonOrNull(xmp, out);
+                out.append(",\"offset\":");
+                AppendNumber(mark.offset, out);
+                out.append(",\"text\":");
+                StringUtils::AppendQuotedJson(mark.text, out);
+                out.append("}\n");
+            } else if(format == OutputFormat::FORMAT_CSV) {
+                out.append("marker,");
+                StringUtils::AppendQuotedCsv(clip, out);
+                out.push_back(',');
+                StringUtils::AppendQuotedCsv(xmp, out);
+                out.append(",,,");
+                AppendNumber(mark.offset, out);
+                out.push_back(',');
+                StringUtils::AppendQuotedCsv(mark.text, out);
+                out.append(",,\n");
+            }
+        }
+    }
+
+    void RecordWriter::WriteMarkers(std::string_view markerRecords) {
+        Append(markerRecords);
+    }
+
+    void RecordWriter::WriteClip(const ClipRecord& clip, std::string_view markerRecords) {
+        Append(markerRecords);
+
+        const std::string_view error {clip.ErrorCode ? P2ExceptionCodeToString(*clip.ErrorCode) : std::string_view {}};
+
+        if(m_Format == OutputFormat::FORMAT_NDJSON) {
+            m_Buffer.append("{\"record\":\"clip\",\"clip\":");
+            StringUtils::AppendQuotedJson(clip.Clip, m_Buffer);
+            m_Buffer.append(",\"xmp\":");
+            AppendJsonOrNull(clip.Xmp, m_Buffer);
+            m_Buffer.append(",\"outcome\":");
+            StringUtils::AppendQuotedJson(clip.Outcome, m_Buffer);
+            m_Buffer.append(",\"markers\":");
+            AppendNumber(static_cast<long long>(clip.MarkerCount), m_Buffer);
+            m_Buffer.append(",\"error\":");
+            AppendJsonOrNull(error, m_Buffer);
+            m_Buffer.append(",\"message\":");
+            AppendJsonOrNull(clip.ErrorMessage, m_Buffer);
+            m_Buffer.append("}\n");
+        } else if(m_Format == OutputFormat::FORMAT_CSV) {
+            m_Buffer.append("clip,");
+            StringUtils::AppendQuotedCsv(clip.Clip, m_Buffer);
+            m_Buffer.push_back(',');
+            StringUtils::AppendQuotedCsv(clip.Xmp, m_Buffer);
+            m_Buffer.push_back(',');
+            StringUtils::AppendQuotedCsv(clip.Outcome, m_Buffer);
+            m_Buffer.push_back(',');
+            AppendNumber(static_cast<long long>(clip.MarkerCount), m_Buffer);
+            m_Buffer.append(",,,");
+            StringUtils::AppendQuotedCsv(error, m_Buffer);
+            m_Buffer.push_back(',');
+            StringUtils::AppendQuotedCsv(clip.ErrorMessage, m_Buffer);
+            m_Buffer.push_back('\n');
+        }
+
+        if(m_Buffer.size() >= RecordWriter::BUFFER_SIZE) {
+            WriteOut();
+        }
+    }
+
+    void RecordWriter::Flush() {
+        WriteOut();
+        m_Out.flush();
+    }
+
+    void RecordWriter::Append(std::string_view data) {
+        if(m_Buffer.size() + data.size() > RecordWriter::BUFFER_SIZE) {
+            WriteOut();
+        }
+
+        // Too big to be worth copying
+        if(data.size() >= RecordWriter::BUFFER_SIZE) {
+            m_Out.write(data.data(), static_cast<std::streamsize>(data.size()));
+            StageMetrics::CountSyscalls(Syscall::SYSCALL_WRITE);
+            return;
+        }
+
+        m_Buffer.append(data);
+    }
+
+    void RecordWriter::WriteOut() {
+        if(m_Buffer.empty()) {
+            return;
+        }
+
+        m_Out.write(m_Buffer.data(), static_cast<std::streamsize>(m_Buffer.size()));
+        StageMetrics::CountSyscalls(Syscall::SYSCALL_WRITE);
+
+        m_Buffer.clear();
+    }
+
+    void RecordWriter::AppendNumber(const long long number, std::string& out) {
+        char digits[24] {};
+        const auto [end, error] {std::to_chars(digits, digits + sizeof(digits), number)};
+        out.append(digits, static_cast<size_t>(end - digits));
+    }
+
+    void RecordWriter::AppendJsonOrNull(std::string_view str, std::string& out) {
+        if(str.empty()) {
+            out.append("null");
+        } else {
+            StringUtils::AppendQuotedJson(str, out);
+        }
+    }
+}
\ No newline at end of file
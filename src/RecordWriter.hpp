@@ -0,0 +1,91 @@
+/*
+* Project: p2mark
+* File:    RecordWriter.hpp
+* Desc:    Buffered NDJSON/CSV record writer header file
+* Created: 2026-10-17
+*/
+
+#pragma once
+
+#include <optional>
+#include <ostream>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include "Marker.hpp"
+#include "OutputFormat.hpp"
+#include "P2Exception.hpp"
+
+namespace p2mark {
+    /// What the record of one clip says.
+    struct ClipRecord {
+        std::string_view Clip    {}; // The full path of the clip file
+        std::string_view Xmp     {}; // The full path of the XMP, if there is one
+        std::string_view Outcome {};
+        size_t MarkerCount       {0};
+        std::optional<P2ExceptionCode> ErrorCode {};
+        std::string_view ErrorMessage {};
+    };
+
+    /// Streams records (NDJSON or CSV) through one large buffer: nothing
+    /// is flushed per line, the buffer is written out when it's full
+    /// and when Flush() is called (at the end of a run or of a watch batch).
+    /// The marker records are formatted by the workers into a string of the
+    /// clip's, then written together with the clip's record in clip order.
+    class RecordWriter {
+    public:
+        /// The buffer is written out once it holds this many bytes.
+        static inline constexpr size_t BUFFER_SIZE {256 * 1024};
+
+        /// Every CSV row has all the columns; a record fills in the ones that apply to it.
+        static inline constexpr std::string_view CSV_HEADER {
+            "record,clip,xmp,outcome,markers,offset,text,error,message\n"
+        };
+
+    public:
+        /// The CSV header goes into the buffer right away.
+        RecordWriter(const OutputFormat format, std::ostream& out);
+        ~RecordWriter();
+
+        RecordWriter(const RecordWriter&) = delete;
+        RecordWriter& operator=(const RecordWriter&) = delete;
+
+    public:
+        inline OutputFormat Format() const { return m_Format; }
+
+        /// Appends the records of a clip's markers to out.
+        /// Touches nothing else, so any worker can call it.
+        static void FormatMarkers(const OutputFormat format,
+                                  std::string_view clip,
+                                  std::string_view xmp,
+                                  std::span<const Marker> markers,
+                                  std::string& out);
+
+        /// Writes the marker records (from FormatMarkers()), then the clip's own record.
+        void WriteClip(const ClipRecord& clip, std::string_view markerRecords);
+
+        /// Writes marker records that don't belong to a processed clip
+        /// (the answers of an index query).
+        void WriteMarkers(std::string_view markerRecords);
+
+        /// Writes out the buffer and flushes the output.
+        void Flush();
+
+    private:
+        void Append(std::string_view data);
+
+        /// Hands the buffer over to the output, without flushing it.
+        void WriteOut();
+
+        static void AppendNumber(const long long number, std::string& out);
+
+        /// A JSON string, or null if it's empty.
+        static void AppendJsonOrNull(std::string_view str, std::string& out);
+
+    private:
+        const OutputFormat m_Format;
+        std::ostream& m_Out;
+        std::string m_Buffer {};
+    };
+}
\ No newline at end of file
@@ -0,0 +1,190 @@
+/*
+* Project: p2mark
+* File:    ShootFinder.cpp
+* Desc:    Parallel discovery of P2 shoots in a directory tree implementation file
+* Created: 2026-10-17
+*/
+
+#include "ShootFinder.hpp"
+
+#include <algorithm>
+#include <thread>
+
+#include "Constants.hpp"
+#include "StageMetrics.hpp"
+
+namespace p2mark {
+    ShootFinder::ShootFinder(const unsigned int walkers) :
+    m_Walkers(std::max(1U, walkers)) {
+    }
+
+    void ShootFinder::Walk(const fs::path& root, const OnShoot& onShoot, const OnError& onError) {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Pending.clear();
+            m_Busy = 0;
+            m_Stopped = false;
+            m_Error = nullptr;
+        }
+
+        // "CONTENTS/" has to be recognised as well
+        fs::path start {root.lexically_normal()};
+        if(start.filename().empty() && start.has_relative_path()) {
+            start = start.parent_path();
+        }
+
+        if(IsShoot(start)) {
+            m_ShootsFound++;
+            onShoot(start);
+            return;
+        }
+
+        m_Pending.push_back(std::move(start));
+
+        // The calling thread walks too
+        std::vector<std::thread> walkers {};
+        try {
+            for(unsigned int i {1}; i < m_Walkers; i++) {
+                walkers.emplace_back(&ShootFinder::WalkerLoop, this, std::cref(onShoot), std::cref(onError));
+            }
+        } catch(...) {
+            // The walkers already started can't be left running
+            Stop();
+            for(std::thread& t : walkers) {
+                t.join();
+            }
+
+            throw;
+        }
+
+        WalkerLoop(onShoot, onError);
+
+        for(std::thread& t : walkers) {
+            t.join();
+        }
+
+        if(m_Error) {
+            std::rethrow_exception(m_Error);
+        }
+    }
+
+    void ShootFinder::Stop() {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Stopped = true;
+        }
+
+        m_Condition.notify_all();
+    }
+
+    void ShootFinder::WalkerLoop(const OnShoot& onShoot, const OnError& onError) {
+        std::vector<fs::path> subdirs {};
+
+        while(true) {
+            fs::path dir {};
+
+            {
+                std::unique_lock<std::mutex> lock(m_Mutex);
+
+                // An empty stack only means the end once nobody can add to it any more
+                m_Condition.wait(lock, [this]() { return m_Stopped || !m_Pending.empty() || m_Busy == 0; });
+                if(m_Stopped || m_Pending.empty()) {
+                    return;
+                }
+
+                dir = std::move(m_Pending.back());
+                m_Pending.pop_back();
+                m_Busy++;
+            }
+
+            subdirs.clear();
+
+            // Nothing may escape a walker thread: the first error stops the walk and goes to Walk()
+            try {
+                ListDirectory(dir, subdirs, onShoot, onError);
+            } catch(...) {
+                {
+                    std::lock_guard<std::mutex> lock(m_Mutex);
+                    if(!m_Error) {
+                        m_Error = std::current_exception();
+                    }
+
+                    m_Stopped = true;
+                    m_Busy--;
+                }
+
+                m_Condition.notify_all();
+                return;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+
+                // Reversed, so that they come off the stack in listing order
+                m_Pending.insert(m_Pending.end(), std::make_move_iterator(subdirs.rbegin()),
+                                 std::make_move_iterator(subdirs.rend()));
+                m_Busy--;
+            }
+
+            m_Condition.notify_all();
+        }
+    }
+
+    void ShootFinder::ListDirectory(const fs::path& dir, std::vector<fs::path>& subdirs,
+                                    const OnShoot& onShoot, const OnError& onError) {
+        StageTimer timer(Stage::STAGE_DISCOVER);
+        StageMetrics::CountSyscalls(Syscall::SYSCALL_OPEN);
+        StageMetrics::CountSyscalls(Syscall::SYSCALL_READ);
+        m_DirectoriesListed++;
+
+        std::error_code ec {};
+        fs::directory_iterator it(dir, ec);
+
+        for(; !ec && it != fs::directory_iterator(); it.increment(ec)) {
+            const fs::directory_entry& entry {*it};
+            std::error_code typeError {};
+
+            // The types come with the listing; only the odd file system makes them cost a stat
+            if(entry.is_symlink(typeError) || !entry.is_directory(typeError) || typeError) {
+                continue;
+            }
+
+            const fs::path name {entry.path().filename()};
+
+            if(name == CONTENTS_DIR && IsShoot(entry.path())) {
+                m_ShootsFound++;
+                onShoot(entry.path());
+            } else if(!IsPruned(dir, name)) {
+                subdirs.push_back(entry.path());
+            }
+        }
+
+        if(ec) {
+            onError(dir, ec);
+        }
+    }
+
+    bool ShootFinder::IsShoot(const fs::path& dir) {
+        if(dir.filename() != CONTENTS_DIR) {
+            return false;
+        }
+
+        std::error_code ec {};
+        StageMetrics::CountSyscalls(Syscall::SYSCALL_STAT);
+        return fs::is_directory(dir / CLIP_DIR, ec);
+    }
+
+    bool ShootFinder::IsPruned(const fs::path& parent, const fs::path& name) {
+        // Compared as native names: some of them may not convert to a narrow string
+        if(name.native().starts_with('.')) {
+            return true;
+        }
+
+        // A CONTENTS without a CLIP (a shoot is never walked into); anywhere else
+        // they're just names, VIDEO/2024/card01/CONTENTS is a shoot like any other
+        return parent.filename() == CONTENTS_DIR &&
+               std::any_of(PRUNED_DIRS.begin(), PRUNED_DIRS.end(), [&name](std::string_view pruned) {
+                   return name == fs::path(pruned);
+               });
+    }
+}
\ No newline at end of file
@@ -0,0 +1,96 @@
+/*
+* Project: p2mark
+* File:    ShootFinder.hpp
+* Desc:    Parallel discovery of P2 shoots in a directory tree header file
+* Created: 2026-10-17
+*/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace p2mark {
+    /// Walks a directory tree (an archive volume, typically) and finds
+    /// the P2 shoots in it: every CONTENTS directory with a CLIP directory
+    /// inside. A few walkers list directories at the same time, which is
+    /// what keeps a network share busy; the rest of the tree waits on
+    /// a shared stack, so the walk goes depth first and the stack stays small.
+    /// A shoot is reported as soon as it's found and never walked into,
+    /// the media directories of a CONTENTS without a CLIP (VIDEO, AUDIO...)
+    /// aren't listed either, and neither are hidden ones (.snapshot, .Trash...)
+    /// or symlinks. Elsewhere those names are ordinary directories:
+    /// an archive may well keep its cards under VIDEO/2024.
+    class ShootFinder {
+    public:
+        using OnShoot = std::function<void(const fs::path& contentsDir)>;
+        using OnError = std::function<void(const fs::path& dir, const std::error_code& error)>;
+
+        /// Enough directory listings in flight to hide the latency
+        /// of a NAS, not so many that it starts to thrash.
+        static inline constexpr unsigned int DEFAULT_WALKERS {8};
+
+        /// The other directories of a P2 CONTENTS; they only hold media.
+        /// Only pruned right below a CONTENTS directory.
+        static inline constexpr std::array<std::string_view, 5> PRUNED_DIRS {
+            "AUDIO", "ICON", "PROXY", "VIDEO", "VOICE"
+        };
+
+    public:
+        explicit ShootFinder(const unsigned int walkers = ShootFinder::DEFAULT_WALKERS);
+
+    public:
+        /// Walks everything under root (root itself may be a CONTENTS directory)
+        /// and returns once it's all been walked. onShoot and onError are called
+        /// from the walkers, several at a time; a directory that can't be read
+        /// is reported to onError and skipped. If a walker throws (a callback, say),
+        /// the others stop and the first exception is rethrown here once they've all ended.
+        void Walk(const fs::path& root, const OnShoot& onShoot, const OnError& onError);
+
+        /// Makes a running Walk() return as soon as its walkers are done
+        /// with the directories they're listing. Safe to call from any thread.
+        void Stop();
+
+        inline uint64_t DirectoriesListed() const { return m_DirectoriesListed.load(); }
+        inline uint64_t ShootsFound() const { return m_ShootsFound.load(); }
+
+    private:
+        /// Takes directories off the stack until the whole tree has been walked.
+        void WalkerLoop(const OnShoot& onShoot, const OnError& onError);
+
+        /// Lists one directory: reports the shoots in it and
+        /// appends the subdirectories that are worth walking to subdirs.
+        void ListDirectory(const fs::path& dir, std::vector<fs::path>& subdirs,
+                           const OnShoot& onShoot, const OnError& onError);
+
+        /// A CONTENTS directory with a CLIP directory in it.
+        static bool IsShoot(const fs::path& dir);
+
+        /// Whether a subdirectory (named name) of parent isn't worth walking.
+        static bool IsPruned(const fs::path& parent, const fs::path& name);
+
+    private:
+        const unsigned int m_Walkers;
+
+        std::mutex m_Mutex;
+        std::condition_variable m_Condition;
+        std::vector<fs::path> m_Pending {}; // Directories still to be listed
+        unsigned int m_Busy {0};            // Walkers listing a directory (that may add more)
+        bool m_Stopped {false};
+        std::exception_ptr m_Error {};      // The first exception a walker ran into
+
+        std::atomic<uint64_t> m_DirectoriesListed {0};
+        std::atomic<uint64_t> m_ShootsFound {0};
+    };
+}
\ No newline at end of file
@@ -0,0 +1,169 @@
+/*
+* Project: p2mark
+* File:    StageMetrics.cpp
+* Desc:    Always-on per-stage latency and I/O counters implementation file
+* Created: 2026-10-17
+*/
+
+#include "StageMetrics.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+
+#include "ThreadSlotRegistry.hpp"
+
+namespace p2mark {
+    size_t LatencyHistogram::BucketOf(const uint64_t ns) {
+        if(ns < SUB_BUCKETS) {
+            return static_cast<size_t>(ns);
+        }
+
+        // The top bit picks the power of two, the next three bits the bucket within it
+        const size_t exponent {static_cast<size_t>(std::bit_width(ns)) - 1};
+        const size_t sub {static_cast<size_t>(ns >> (exponent - SUB_BUCKET_BITS)) - SUB_BUCKETS};
+        return (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + sub;
+    }
+
+    uint64_t LatencyHistogram::BucketLimit(const size_t bucket) {
+        if(bucket < SUB_BUCKETS) {
+            return bucket;
+        }
+
+        const size_t exponent {bucket / SUB_BUCKETS + SUB_BUCKET_BITS - 1};
+        const size_t shift {exponent - SUB_BUCKET_BITS};
+        const uint64_t lower {static_cast<uint64_t>(SUB_BUCKETS + bucket % SUB_BUCKETS) << shift};
+        return lower + ((uint64_t {1} << shift) - 1);
+    }
+
+    uint64_t LatencyHistogram::Percentile(const double percentile) const {
+        if(Count == 0) {
+            return 0;
+        }
+
+        // The rank of the sample, counting from 1
+        const uint64_t rank {std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(percentile / 100.0 * Count)))};
+        uint64_t seen {0};
+
+        for(size_t i {0}; i < Buckets.size(); i++) {
+            seen += Buckets[i];
+            if(seen >= rank) {
+                return std::min(BucketLimit(i), MaxNs);
+            }
+        }
+
+        return MaxNs;
+    }
+
+    LatencyHistogram& LatencyHistogram::operator+=(const LatencyHistogram& other) {
+        for(size_t i {0}; i < Buckets.size(); i++) {
+            Buckets[i] += other.Buckets[i];
+        }
+
+        Count   += other.Count;
+        TotalNs += other.TotalNs;
+        MaxNs    = std::max(MaxNs, other.MaxNs);
+        return *this;
+    }
+
+    /// One thread's counters. Only the owning thread ever writes to them,
+    /// so a relaxed load and store is enough (no read-modify-write);
+    /// they're atomics only so that snapshots can read them at any time.
+    struct alignas(64) MetricsShard {
+        struct StageCounters {
+            std::array<std::atomic<uint64_t>, LatencyHistogram::BUCKET_COUNT> Buckets {};
+            std::atomic<uint64_t> Count   {0};
+            std::atomic<uint64_t> TotalNs {0};
+            std::atomic<uint64_t> MaxNs   {0};
+        };
+
+        std::array<StageCounters, static_cast<size_t>(Stage::STAGE_COUNT)> Stages {};
+        std::array<std::atomic<uint64_t>, static_cast<size_t>(Syscall::SYSCALL_COUNT)> Syscalls {};
+        std::atomic<uint64_t> BytesRead    {0};
+        std::atomic<uint64_t> BytesWritten {0};
+    };
+
+    static inline void Bump(std::atomic<uint64_t>& counter, const uint64_t amount) {
+        counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    using ShardRegistry = ThreadSlotRegistry<MetricsShard>;
+
+    static MetricsShard& CurrentShard() {
+        return ShardRegistry::Current();
+    }
+
+    void StageMetrics::RecordLatency(const Stage stage, const uint64_t ns) {
+        MetricsShard::StageCounters& counters {CurrentShard().Stages[static_cast<size_t>(stage)]};
+
+        Bump(counters.Buckets[LatencyHistogram::BucketOf(ns)], 1);
+        Bump(counters.Count, 1);
+        Bump(counters.TotalNs, ns);
+
+        if(ns > counters.MaxNs.load(std::memory_order_relaxed)) {
+            counters.MaxNs.store(ns, std::memory_order_relaxed);
+        }
+    }
+
+    void StageMetrics::CountSyscalls(const Syscall call, const uint64_t count) {
+        Bump(CurrentShard().Syscalls[static_cast<size_t>(call)], count);
+    }
+
+    void StageMetrics::CountBytesRead(const uint64_t bytes) {
+        Bump(CurrentShard().BytesRead, bytes);
+    }
+
+    void StageMetrics::CountBytesWritten(const uint64_t bytes) {
+        Bump(CurrentShard().BytesWritten, bytes);
+    }
+
+    MetricsSnapshot StageMetrics::Snapshot() {
+        MetricsSnapshot snapshot {};
+
+        ShardRegistry::Instance().ForEach([&snapshot](const MetricsShard& shard) {
+            for(size_t s {0}; s < shard.Stages.size(); s++) {
+                const MetricsShard::StageCounters& counters {shard.Stages[s]};
+                LatencyHistogram& histogram {snapshot.Stages[s]};
+
+                for(size_t i {0}; i < histogram.Buckets.size(); i++) {
+                    histogram.Buckets[i] += counters.Buckets[i].load(std::memory_order_relaxed);
+                }
+
+                histogram.Count   += counters.Count.load(std::memory_order_relaxed);
+                histogram.TotalNs += counters.TotalNs.load(std::memory_order_relaxed);
+                histogram.MaxNs    = std::max(histogram.MaxNs, counters.MaxNs.load(std::memory_order_relaxed));
+            }
+
+            for(size_t i {0}; i < shard.Syscalls.size(); i++) {
+                snapshot.Syscalls[i] += shard.Syscalls[i].load(std::memory_order_relaxed);
+            }
+
+            snapshot.BytesRead    += shard.BytesRead.load(std::memory_order_relaxed);
+            snapshot.BytesWritten += shard.BytesWritten.load(std::memory_order_relaxed);
+        });
+
+        return snapshot;
+    }
+
+    void StageMetrics::Reset() {
+        ShardRegistry::Instance().ForEach([](MetricsShard& shard) {
+            for(MetricsShard::StageCounters& counters : shard.Stages) {
+                for(std::atomic<uint64_t>& bucket : counters.Buckets) {
+                    bucket.store(0, std::memory_order_relaxed);
+                }
+
+                counters.Count.store(0, std::memory_order_relaxed);
+                counters.TotalNs.store(0, std::memory_order_relaxed);
+                counters.MaxNs.store(0, std::memory_order_relaxed);
+            }
+
+            for(std::atomic<uint64_t>& syscalls : shard.Syscalls) {
+                syscalls.store(0, std::memory_order_relaxed);
+            }
+
+            shard.BytesRead.store(0, std::memory_order_relaxed);
+            shard.BytesWritten.store(0, std::memory_order_relaxed);
+        });
+    }
+}
\ No newline at end of file
@@ -0,0 +1,150 @@
+/*
+* Project: p2mark
+* File:    StageMetrics.hpp
+* Desc:    Always-on per-stage latency and I/O counters header file
+* Created: 2026-10-17
+*/
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string_view>
+
+#include "TraceRecorder.hpp"
+
+namespace p2mark {
+    /// The parts of a run that get timed. Some of them nest: SCAN includes VALIDATE,
+    /// CLIP includes READ to XMP_SAVE, and XMP_WRITE includes GUID, XMP_LOAD and XMP_SAVE.
+    enum class Stage : uint8_t {
+        STAGE_SCAN = 0,   // Listing one CLIP directory
+        STAGE_VALIDATE,   // Checking one directory entry
+        STAGE_SORT,       // Sorting the clips of one shoot
+        STAGE_MANIFEST,   // Checking one clip against the manifest
+        STAGE_PREFETCH,   // Taking one clip from the prefetcher (waiting for it to be read)
+        STAGE_CLIP,       // Reading, parsing and writing one clip
+        STAGE_READ,       // Stamping, hashing and loading one clip
+        STAGE_PARSE,      // Finding the memos of one clip
+        STAGE_GUID,       // Generating one batch of GUIDs
+        STAGE_XMP_WRITE,  // Serializing or patching one XMP and saving it
+        STAGE_XMP_LOAD,   // Mapping and parsing the XMP that is already there
+        STAGE_XMP_SAVE,   // Handing one XMP over to the file writer
+        STAGE_COMMIT,     // Putting a batch of XMPs in place and saving the manifest
+        STAGE_INDEX,      // Building and saving the marker index
+        STAGE_DISCOVER,   // Listing one directory while looking for shoots (--recursive)
+        STAGE_COUNT
+    };
+
+    /// System calls by kind. The ones p2mark makes itself are counted exactly;
+    /// the ones behind std::filesystem, iostreams and tinyxml2 are counted
+    /// once per call, which makes the totals a lower bound.
+    enum class Syscall : uint8_t {
+        SYSCALL_OPEN = 0, // Includes closing
+        SYSCALL_STAT,     // Includes the existence checks
+        SYSCALL_READ,     // Includes directory reads
+        SYSCALL_WRITE,
+        SYSCALL_MAP,      // Includes unmapping
+        SYSCALL_SYNC,
+        SYSCALL_RENAME,
+        SYSCALL_UNLINK,   // Removing a file
+        SYSCALL_CHMOD,    // Setting a file's permissions
+        SYSCALL_RING,     // io_uring calls; one submission may carry many operations
+        SYSCALL_COUNT
+    };
+
+    constexpr inline std::string_view StageToString(const Stage stage) {
+        constexpr std::string_view names[] {
+            "scan", "validate", "sort", "manifest", "prefetch", "clip", "read",
+            "parse", "guid", "xmp_write", "xmp_load", "xmp_save", "commit", "index", "discover"
+        };
+        return stage < Stage::STAGE_COUNT ? names[static_cast<size_t>(stage)] : "unknown";
+    }
+
+    constexpr inline std::string_view SyscallToString(const Syscall call) {
+        constexpr std::string_view names[] {
+            "open", "stat", "read", "write", "map", "sync", "rename", "unlink", "chmod", "io_uring"
+        };
+        return call < Syscall::SYSCALL_COUNT ? names[static_cast<size_t>(call)] : "unknown";
+    }
+
+    /// A log-linear latency histogram: 8 buckets per power of two,
+    /// so any percentile is off by at most 12.5%.
+    struct LatencyHistogram {
+        static inline constexpr size_t SUB_BUCKET_BITS {3};
+        static inline constexpr size_t SUB_BUCKETS     {1U << SUB_BUCKET_BITS};
+        static inline constexpr size_t BUCKET_COUNT    {(64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS};
+
+        std::array<uint64_t, BUCKET_COUNT> Buckets {};
+        uint64_t Count   {0};
+        uint64_t TotalNs {0};
+        uint64_t MaxNs   {0};
+
+        static size_t BucketOf(const uint64_t ns);
+
+        /// The highest value that falls into the bucket.
+        static uint64_t BucketLimit(const size_t bucket);
+
+        /// The upper bound of the bucket the percentile falls into, never above the maximum.
+        uint64_t Percentile(const double percentile) const;
+
+        LatencyHistogram& operator+=(const LatencyHistogram& other);
+    };
+
+    struct MetricsSnapshot {
+        std::array<LatencyHistogram, static_cast<size_t>(Stage::STAGE_COUNT)> Stages {};
+        std::array<uint64_t, static_cast<size_t>(Syscall::SYSCALL_COUNT)> Syscalls {};
+        uint64_t BytesRead    {0};
+        uint64_t BytesWritten {0};
+
+        inline const LatencyHistogram& Of(const Stage stage) const { return Stages[static_cast<size_t>(stage)]; }
+        inline uint64_t Of(const Syscall call) const { return Syscalls[static_cast<size_t>(call)]; }
+    };
+
+    /// Process-wide counters that are always collected, even in release builds.
+    /// Every thread records into its own shard with plain (relaxed) stores,
+    /// so recording never takes a lock or bounces a cache line between
+    /// workers; the shards are only added up when a snapshot is taken.
+    class StageMetrics {
+    public:
+        static void RecordLatency(const Stage stage, const uint64_t ns);
+        static void CountSyscalls(const Syscall call, const uint64_t count = 1);
+        static void CountBytesRead(const uint64_t bytes);
+        static void CountBytesWritten(const uint64_t bytes);
+
+        /// Adds up the shards of every thread that recorded anything so far.
+        /// Exact once the threads are idle, approximate while they're busy.
+        static MetricsSnapshot Snapshot();
+
+        /// Forgets everything recorded so far (between the jobs of the daemon).
+        static void Reset();
+    };
+
+    /// Times the scope it lives in as one sample of the stage
+    /// (and as one span of the trace, while there's one).
+    class StageTimer {
+    public:
+        /// The detail (the clip's path, say) only goes into the trace;
+        /// it has to outlive the timer.
+        explicit StageTimer(const Stage stage, std::string_view detail = {}) :
+            m_Stage(stage), m_Detail(detail), m_StartTime(std::chrono::steady_clock::now()) {}
+
+        ~StageTimer() {
+            const auto endTime {std::chrono::steady_clock::now()};
+            StageMetrics::RecordLatency(m_Stage, static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(endTime - m_StartTime).count()));
+
+            if(TraceRecorder::IsRecording()) {
+                TraceRecorder::Record(m_Stage, m_StartTime, endTime, m_Detail);
+            }
+        }
+
+        StageTimer(const StageTimer&) = delete;
+        StageTimer& operator=(const StageTimer&) = delete;
+
+    private:
+        const Stage m_Stage;
+        const std::string_view m_Detail;
+        const std::chrono::steady_clock::time_point m_StartTime;
+    };
+}
\ No newline at end of file
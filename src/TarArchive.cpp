@@ -0,0 +1,347 @@
+/*
+* Project: p2mark
+* File:    TarArchive.cpp
+* Desc:    Clip reader for tar archives of P2 cards implementation file
+* Created: 2026-10-17
+*/
+
+#include "TarArchive.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <format>
+#include <limits>
+#include <system_error>
+
+#include "Constants.hpp"
+#include "P2Exception.hpp"
+#include "P2Validator.hpp"
+#include "StageMetrics.hpp"
+
+namespace p2mark {
+    namespace {
+        // Where the fields of a header are (the name, size, mtime... of POSIX ustar)
+        inline constexpr size_t NAME_OFFSET     {0};
+        inline constexpr size_t NAME_LENGTH     {100};
+        inline constexpr size_t SIZE_OFFSET     {124};
+        inline constexpr size_t SIZE_LENGTH     {12};
+        inline constexpr size_t MTIME_OFFSET    {136};
+        inline constexpr size_t MTIME_LENGTH    {12};
+        inline constexpr size_t CHECKSUM_OFFSET {148};
+        inline constexpr size_t CHECKSUM_LENGTH {8};
+        inline constexpr size_t TYPE_OFFSET     {156};
+        inline constexpr size_t MAGIC_OFFSET    {257};
+        inline constexpr size_t PREFIX_OFFSET   {345};
+        inline constexpr size_t PREFIX_LENGTH   {155};
+
+        /// POSIX ustar; GNU tar writes "ustar " and has no prefix field
+        inline constexpr std::string_view USTAR_MAGIC {"ustar\0", 6};
+
+        // Member types
+        inline constexpr char TYPE_REGULAR     {'0'};
+        inline constexpr char TYPE_OLD_REGULAR {'\0'};
+        inline constexpr char TYPE_CONTIGUOUS  {'7'};
+        inline constexpr char TYPE_DIRECTORY   {'5'};
+        inline constexpr char TYPE_GNU_LONG    {'L'}; // The data is the next member's name
+        inline constexpr char TYPE_PAX         {'x'}; // The data is records about the next member
+        inline constexpr char TYPE_PAX_GLOBAL  {'g'};
+
+        inline uint64_t RoundUpToBlock(const uint64_t size) {
+            return (size + TarArchive::BLOCK_SIZE - 1) / TarArchive::BLOCK_SIZE * TarArchive::BLOCK_SIZE;
+        }
+
+        bool EndsWith(std::string_view text, std::string_view suffix) {
+            return text.size() >= suffix.size() && text.substr(text.size() - suffix.size()) == suffix;
+        }
+    }
+
+    bool TarArchive::IsArchivePath(const fs::path& path) {
+        std::string extension {path.extension().string()};
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](const unsigned char c) {
+            return static_cast<char>(std::tolower(c));
+        });
+
+        return extension == ".tar";
+    }
+
+    void TarArchive::Scan(const fs::path& archive) {
+        m_Path = archive;
+        m_Clips.clear();
+        m_ContentsDirs.clear();
+        m_TooLarge.clear();
+
+        m_File = std::ifstream(archive, std::ios::binary);
+        StageMetrics::CountSyscalls(Syscall::SYSCALL_OPEN);
+
+        if(!m_File.is_open()) {
+            throw fs::filesystem_error("Cannot open the archive", archive, std::error_code(errno, std::generic_category()));
+        }
+
+        const auto damaged = [&archive]() {
+            return P2Exception(std::format("{} isn\'t a tar archive, or it\'s damaged", archive.filename().string()),
+                               P2ExceptionCode::CODE_FILESYSTEM_ERROR);
+        };
+
+        Header header {};
+        Overrides overrides {};
+        uint64_t offset {0};
+
+        while(true) {
+            m_File.seekg(static_cast<std::streamoff>(offset));
+            m_File.read(header.data(), static_cast<std::streamsize>(header.size()));
+            StageMetrics::CountSyscalls(Syscall::SYSCALL_READ);
+
+            // An archive that ends without its end blocks still ends at a member boundary
+            if(m_File.gcount() != static_cast<std::streamsize>(header.size())) {
+                if(offset == 0) {
+                    throw damaged();
+                }
+                break;
+            }
+
+            // The end: a block of zeros (followed by another one)
+            if(std::all_of(header.begin(), header.end(), [](const char c) { return c == '\0'; })) {
+                break;
+            }
+
+            uint64_t size  {0};
+            uint64_t mtime {0};
+            if(!ChecksumMatches(header) ||
+               !ParseNumber(Field(header, SIZE_OFFSET, SIZE_LENGTH), size) ||
+               !ParseNumber(Field(header, MTIME_OFFSET, MTIME_LENGTH), mtime)) {
+                throw damaged();
+            }
+
+            const char type {header[TYPE_OFFSET]};
+            const uint64_t dataOffset {offset + TarArchive::BLOCK_SIZE};
+
+            if(type == TYPE_GNU_LONG || type == TYPE_PAX || type == TYPE_PAX_GLOBAL) {
+                if(size > TarArchive::MAX_EXTENDED_HEADER_SIZE) {
+                    throw damaged();
+                }
+
+                // Global records (defaults for the whole archive) don't carry paths
+                if(type != TYPE_PAX_GLOBAL) {
+                    const std::string data {ReadData(dataOffset, size)};
+
+                    if(type == TYPE_GNU_LONG) {
+                        overrides.Path = data.substr(0, data.find('\0'));
+                    } else if(!ParsePaxRecords(data, overrides)) {
+                        throw damaged();
+                    }
+                }
+            } else {
+                std::string path {Field(header, NAME_OFFSET, NAME_LENGTH)};
+
+                const std::string_view prefix {Field(header, PREFIX_OFFSET, PREFIX_LENGTH)};
+                if(std::string_view(header.data() + MAGIC_OFFSET, USTAR_MAGIC.size()) == USTAR_MAGIC && !prefix.empty()) {
+                    path = std::string(prefix) + "/" + path;
+                }
+
+                if(!overrides.Path.empty()) {
+                    path = std::move(overrides.Path);
+                }
+
+                size = overrides.Size.value_or(size);
+                overrides = {};
+
+                AddMember(std::move(path), type, size, static_cast<int64_t>(mtime), dataOffset);
+            }
+
+            // The data of anything else is never read, only skipped
+            if(size > std::numeric_limits<uint64_t>::max() / 2 - dataOffset) {
+                throw damaged();
+            }
+
+            offset = dataOffset + RoundUpToBlock(size);
+        }
+
+        std::sort(m_Clips.begin(), m_Clips.end(), [](const ArchivedClip& a, const ArchivedClip& b) {
+            return a.ContentsDir != b.ContentsDir ? a.ContentsDir < b.ContentsDir : a.Name < b.Name;
+        });
+
+        m_File.close();
+    }
+
+    void TarArchive::AddMember(std::string path, const char type, const uint64_t size, const int64_t mtime,
+                               const uint64_t dataOffset) {
+        // "./card1/CONTENTS/CLIP/" and "card1/CONTENTS/CLIP" are the same directory
+        while(path.starts_with("./")) {
+            path.erase(0, 2);
+        }
+        while(path.starts_with('/')) {
+            path.erase(0, 1);
+        }
+        while(path.ends_with('/')) {
+            path.pop_back();
+        }
+
+        const std::string clipDirSuffix {std::format("{}/{}", CONTENTS_DIR, CLIP_DIR)};
+
+        // The path of a CLIP directory, or of the directory a file is in
+        const auto isClipDir = [&clipDirSuffix](std::string_view dir) {
+            return dir == clipDirSuffix || EndsWith(dir, "/" + clipDirSuffix);
+        };
+
+        if(type == TYPE_DIRECTORY) {
+            if(isClipDir(path)) {
+                m_ContentsDirs.insert(path.substr(0, path.size() - CLIP_DIR.size() - 1));
+            }
+            return;
+        }
+
+        const size_t slash {path.rfind('/')};
+        if(slash == std::string::npos || !isClipDir(std::string_view(path).substr(0, slash))) {
+            return;
+        }
+
+        std::string contentsDir {path.substr(0, slash - CLIP_DIR.size() - 1)};
+        std::string name {path.substr(slash + 1)};
+        m_ContentsDirs.insert(contentsDir);
+
+        // The same checks as ClipScanner's: only the *.XML names count
+        if(name.size() <= XML_EXT.size() || !EndsWith(name, XML_EXT)) {
+            return;
+        }
+
+        const bool regular {type == TYPE_REGULAR || type == TYPE_OLD_REGULAR || type == TYPE_CONTIGUOUS};
+        const ClipValidationResult result {P2Validator::ValidateClip(regular, size, true)};
+
+        if(result == ClipValidationResult::SUSPICIOUSLY_LARGE_CLIP_FILE) {
+            m_TooLarge.emplace_back(std::move(path));
+            return;
+        } else if(result != ClipValidationResult::CORRECT_CLIP_FILE) {
+            return;
+        }
+
+        ArchivedClip& clip {m_Clips.emplace_back()};
+        clip.ContentsDir = std::move(contentsDir);
+        clip.Name        = std::move(name);
+        clip.Clip.Stamp  = {size, mtime};
+        clip.Clip.Data   = ReadData(dataOffset, size);
+    }
+
+    std::string TarArchive::ReadData(const uint64_t offset, const uint64_t size) {
+        std::string data(static_cast<size_t>(size), '\0');
+
+        m_File.seekg(static_cast<std::streamoff>(offset));
+        m_File.read(data.data(), static_cast<std::streamsize>(size));
+        StageMetrics::CountSyscalls(Syscall::SYSCALL_READ);
+        StageMetrics::CountBytesRead(size);
+
+        if(m_File.gcount() != static_cast<std::streamsize>(size)) {
+            throw P2Exception(std::format("{} ends in the middle of a file", m_Path.filename().string()),
+                              P2ExceptionCode::CODE_FILESYSTEM_ERROR);
+        }
+
+        return data;
+    }
+
+    bool TarArchive::ChecksumMatches(const Header& header) {
+        uint64_t expected {0};
+        if(!ParseNumber(Field(header, CHECKSUM_OFFSET, CHECKSUM_LENGTH), expected)) {
+            return false;
+        }
+
+        // The checksum field itself counts as spaces; some old tars summed signed bytes
+        uint64_t sum       {0};
+        int64_t signedSum  {0};
+        for(size_t i {0}; i < header.size(); i++) {
+            const bool inField {i >= CHECKSUM_OFFSET && i < CHECKSUM_OFFSET + CHECKSUM_LENGTH};
+            const char c {inField ? ' ' : header[i]};
+
+            sum       += static_cast<unsigned char>(c);
+            signedSum += static_cast<signed char>(c);
+        }
+
+        return sum == expected || static_cast<uint64_t>(signedSum) == expected;
+    }
+
+    bool TarArchive::ParseNumber(std::string_view field, uint64_t& value) {
+        value = 0;
+
+        // Base-256: the rest of the field is a big-endian number (negative ones aren't sizes)
+        if(!field.empty() && (static_cast<unsigned char>(field[0]) & 0x80) != 0) {
+            if(static_cast<unsigned char>(field[0]) != 0x80) {
+                return false;
+            }
+
+            for(const char c : field.substr(1)) {
+                if(value >> 56 != 0) {
+                    return false;
+                }
+                value = value << 8 | static_cast<unsigned char>(c);
+            }
+            return true;
+        }
+
+        size_t i {0};
+        while(i < field.size() && field[i] == ' ') {
+            i++;
+        }
+
+        for(; i < field.size() && field[i] >= '0' && field[i] <= '7'; i++) {
+            if(value >> 61 != 0) {
+                return false;
+            }
+            value = value << 3 | static_cast<uint64_t>(field[i] - '0');
+        }
+
+        // Only padding may follow the digits
+        return std::all_of(field.begin() + static_cast<std::ptrdiff_t>(i), field.end(), [](const char c) {
+            return c == ' ' || c == '\0';
+        });
+    }
+
+    std::string_view TarArchive::Field(const Header& header, const size_t offset, const size_t length) {
+        const std::string_view field {header.data() + offset, length};
+        return field.substr(0, field.find('\0'));
+    }
+
+    bool TarArchive::ParsePaxRecords(std::string_view records, Overrides& overrides) {
+        // "<length> <key>=<value>\n", where the length counts the whole record
+        while(!records.empty() && records.front() != '\0') {
+            size_t length {0};
+            size_t i {0};
+
+            for(; i < records.size() && records[i] >= '0' && records[i] <= '9'; i++) {
+                length = length * 10 + static_cast<size_t>(records[i] - '0');
+                if(length > records.size()) {
+                    return false;
+                }
+            }
+
+            if(i == 0 || i >= records.size() || records[i] != ' ' || length <= i + 1 || records[length - 1] != '\n') {
+                return false;
+            }
+
+            const std::string_view record {records.substr(i + 1, length - i - 2)};
+            const size_t equals {record.find('=')};
+            if(equals == std::string_view::npos) {
+                return false;
+            }
+
+            const std::string_view key   {record.substr(0, equals)};
+            const std::string_view value {record.substr(equals + 1)};
+
+            if(key == "path") {
+                overrides.Path = value;
+            } else if(key == "size") {
+                uint64_t size {0};
+                for(const char c : value) {
+                    if(c < '0' || c > '9' || size > std::numeric_limits<uint64_t>::max() / 10 - 9) {
+                        return false;
+                    }
+                    size = size * 10 + static_cast<uint64_t>(c - '0');
+                }
+                overrides.Size = size;
+            }
+
+            records.remove_prefix(length);
+        }
+
+        return true;
+    }
+}
\ No newline at end of file
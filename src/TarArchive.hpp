@@ -0,0 +1,99 @@
+/*
+* Project: p2mark
+* File:    TarArchive.hpp
+* Desc:    Clip reader for tar archives of P2 cards header file
+* Created: 2026-10-17
+*/
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <set>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "ClipPrefetcher.hpp"
+
+namespace fs = std::filesystem;
+
+namespace p2mark {
+    /// A clip file found in an archive, already read.
+    struct ArchivedClip {
+        std::string ContentsDir {}; // The member path of its CONTENTS directory ("card1/CONTENTS")
+        std::string Name {};        // "0000AB.XML"
+        PrefetchedClip Clip {};     // Stamped with the member's size and mtime
+    };
+
+    /// Finds the clips of the P2 cards in a tar archive without extracting it.
+    /// Only the 512-byte member headers are read: the media (VIDEO, AUDIO...),
+    /// which is nearly all of a card, is skipped with a seek, and the only
+    /// members whose contents are read are the clip files (CONTENTS/CLIP/*.XML)
+    /// that pass the same checks as on disk. POSIX ustar, GNU tar (long names,
+    /// base-256 sizes) and pax (path and size records) archives are understood.
+    class TarArchive {
+    public:
+        static inline constexpr size_t BLOCK_SIZE {512};
+
+        /// Longer long names or pax headers aren't names, they're damage.
+        static inline constexpr uint64_t MAX_EXTENDED_HEADER_SIZE {64 * 1024};
+
+    public:
+        /// Whether the path names a tar archive (by its extension).
+        static bool IsArchivePath(const fs::path& path);
+
+        /// Reads the archive, forgetting the previous one. Throws fs::filesystem_error
+        /// if it can't be read, and a P2Exception if it isn't a tar archive or is damaged.
+        void Scan(const fs::path& archive);
+
+        /// The valid clips, sorted by CONTENTS directory, then by name.
+        inline std::vector<ArchivedClip>& Clips() { return m_Clips; }
+
+        /// Every CONTENTS directory that has a CLIP directory (even an empty one), sorted.
+        inline const std::set<std::string>& ContentsDirs() const { return m_ContentsDirs; }
+
+        /// The member paths of the clip files skipped for being suspiciously large.
+        inline std::span<const std::string> TooLarge() const { return m_TooLarge; }
+
+    private:
+        using Header = std::array<char, TarArchive::BLOCK_SIZE>;
+
+        /// What the GNU and pax extended headers say about the next member.
+        struct Overrides {
+            std::string Path {};
+            std::optional<uint64_t> Size {};
+        };
+
+        /// Looks at one member; the clip files are read from the file.
+        void AddMember(std::string path, const char type, const uint64_t size, const int64_t mtime,
+                       const uint64_t dataOffset);
+
+        /// Reads size bytes at offset, or throws if the archive ends before that.
+        std::string ReadData(const uint64_t offset, const uint64_t size);
+
+        static bool ChecksumMatches(const Header& header);
+
+        /// A number field: octal text, or base-256 with the top bit set (GNU).
+        /// Returns false if it's neither.
+        static bool ParseNumber(std::string_view field, uint64_t& value);
+
+        /// The text of a field, up to its first null character.
+        static std::string_view Field(const Header& header, const size_t offset, const size_t length);
+
+        /// Applies the path and size records of a pax extended header.
+        static bool ParsePaxRecords(std::string_view records, Overrides& overrides);
+
+    private:
+        fs::path m_Path {};
+        std::ifstream m_File {};
+
+        std::vector<ArchivedClip> m_Clips {};
+        std::set<std::string> m_ContentsDirs {};
+        std::vector<std::string> m_TooLarge {};
+    };
+}
\ No newline at end of file
@@ -0,0 +1,348 @@
+/*
+* Project: p2mark
+* File:    TextEscaper.cpp
+* Desc:    Vectorised text escaping and UTF-8 validation implementation file
+* Created: 2026-10-17
+*/
+
+#include "TextEscaper.hpp"
+
+#include <bit>
+#include <cstdint>
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define P2MARK_SSE2
+    #include <immintrin.h>
+
+    #ifdef _MSC_VER
+        #include <intrin.h>
+        #define P2MARK_TARGET_AVX2
+    #else
+        #define P2MARK_TARGET_AVX2 __attribute__((target("avx2")))
+    #endif
+#endif
+
+namespace p2mark {
+    namespace {
+        struct Appender {
+            std::string& Out;
+            void Put(std::string_view s) { Out.append(s); }
+        };
+
+        struct Counter {
+            size_t Size {0};
+            void Put(std::string_view s) { Size += s.size(); }
+        };
+
+        // The formats. A byte is plain (copied as it is, in bulk) if it's ASCII,
+        // not one of the SPECIALS and, unless CONTROLS_ARE_PLAIN, not a control
+        // character; PutAscii() takes care of the ASCII bytes that aren't.
+
+        struct XmlAttributeFormat {
+            static inline constexpr std::string_view SPECIALS {"\"&'<>"};
+            static inline constexpr bool CONTROLS_ARE_PLAIN {false};
+            static inline constexpr bool XML_CHARS          {true};
+
+            template<typename Sink>
+            static void PutAscii(const char c, Sink& sink) {
+                switch(c) {
+                    case '"':  sink.Put("&quot;"); break;
+                    case '&':  sink.Put("&amp;");  break;
+                    case '\'': sink.Put("&apos;"); break;
+                    case '<':  sink.Put("&lt;");   break;
+                    case '>':  sink.Put("&gt;");   break;
+                    case '\t':
+                    case '\n':
+                    case '\r': sink.Put(std::string_view(&c, 1)); break;
+                    default:   sink.Put(TextEscaper::REPLACEMENT); break; // Not allowed in XML
+                }
+            }
+        };
+
+        struct XmlSafeFormat {
+            static inline constexpr std::string_view SPECIALS {};
+            static inline constexpr bool CONTROLS_ARE_PLAIN {false};
+            static inline constexpr bool XML_CHARS          {true};
+
+            template<typename Sink>
+            static void PutAscii(const char c, Sink& sink) {
+                if(c == '\t' || c == '\n' || c == '\r') {
+                    sink.Put(std::string_view(&c, 1));
+                } else {
+                    sink.Put(TextEscaper::REPLACEMENT);
+                }
+            }
+        };
+
+        struct JsonFormat {
+            static inline constexpr std::string_view SPECIALS {"\"\\"};
+            static inline constexpr bool CONTROLS_ARE_PLAIN {false};
+            static inline constexpr bool XML_CHARS          {false};
+
+            template<typename Sink>
+            static void PutAscii(const char c, Sink& sink) {
+                constexpr std::string_view HEX_DIGITS {"0123456789abcdef"};
+
+                if(c == '"' || c == '\\') {
+                    const char escaped[] {'\\', c};
+                    sink.Put(std::string_view(escaped, 2));
+                } else {
+                    const unsigned char code {static_cast<unsigned char>(c)};
+                    const char escaped[] {'\\', 'u', '0', '0', HEX_DIGITS[code >> 4], HEX_DIGITS[code & 0x0F]};
+                    sink.Put(std::string_view(escaped, 6));
+                }
+            }
+        };
+
+        /// Inside a quoted field; the quotes are doubled, the rest goes as it is.
+        struct CsvFormat {
+            static inline constexpr std::string_view SPECIALS {"\""};
+            static inline constexpr bool CONTROLS_ARE_PLAIN {true};
+            static inline constexpr bool XML_CHARS          {false};
+
+            template<typename Sink>
+            static void PutAscii(const char c, Sink& sink) {
+                sink.Put(c == '"' ? std::string_view("\"\"") : std::string_view(&c, 1));
+            }
+        };
+
+        /// Only checks the UTF-8.
+        struct Utf8Format {
+            static inline constexpr std::string_view SPECIALS {};
+            static inline constexpr bool CONTROLS_ARE_PLAIN {true};
+            static inline constexpr bool XML_CHARS          {false};
+        };
+
+        template<typename Format>
+        inline bool IsPlain(const char c) {
+            const unsigned char code {static_cast<unsigned char>(c)};
+
+            return code < 0x80 && (Format::CONTROLS_ARE_PLAIN || code >= 0x20) &&
+                   Format::SPECIALS.find(c) == std::string_view::npos;
+        }
+
+        /// Where the first byte from `from` on that isn't plain is, or size.
+        template<typename Format>
+        size_t PlainEndScalar(const char* data, const size_t size, size_t from) {
+            while(from < size && IsPlain<Format>(data[from])) {
+                from++;
+            }
+
+            return from;
+        }
+
+#ifdef P2MARK_SSE2
+        template<typename Format>
+        size_t PlainEndSse2(const char* data, const size_t size, size_t from) {
+            const __m128i space {_mm_set1_epi8(0x20)};
+
+            for(; from + 16 <= size; from += 16) {
+                const __m128i bytes {_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + from))};
+
+                // As signed bytes, everything above ASCII is negative: "below a space" covers it too
+                __m128i special {Format::CONTROLS_ARE_PLAIN ? bytes : _mm_cmplt_epi8(bytes, space)};
+                for(const char c : Format::SPECIALS) {
+                    special = _mm_or_si128(special, _mm_cmpeq_epi8(bytes, _mm_set1_epi8(c)));
+                }
+
+                const unsigned int mask {static_cast<unsigned int>(_mm_movemask_epi8(special))};
+                if(mask != 0) {
+                    return from + static_cast<size_t>(std::countr_zero(mask));
+                }
+            }
+
+            return PlainEndScalar<Format>(data, size, from);
+        }
+
+        template<typename Format>
+        P2MARK_TARGET_AVX2 size_t PlainEndAvx2(const char* data, const size_t size, size_t from) {
+            const __m256i space {_mm256_set1_epi8(0x20)};
+
+            for(; from + 32 <= size; from += 32) {
+                const __m256i bytes {_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + from))};
+
+                __m256i special {Format::CONTROLS_ARE_PLAIN ? bytes : _mm256_cmpgt_epi8(space, bytes)};
+                for(const char c : Format::SPECIALS) {
+                    special = _mm256_or_si256(special, _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(c)));
+                }
+
+                const unsigned int mask {static_cast<unsigned int>(_mm256_movemask_epi8(special))};
+                if(mask != 0) {
+                    return from + static_cast<size_t>(std::countr_zero(mask));
+                }
+            }
+
+            return PlainEndSse2<Format>(data, size, from);
+        }
+
+        bool DetectAvx2() {
+    #ifdef _MSC_VER
+            int info[4] {};
+            __cpuid(info, 0);
+            if(info[0] < 7) {
+                return false;
+            }
+
+            // The OS has to save the YMM registers too
+            __cpuid(info, 1);
+            const bool osSavesAvx {(info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 6) == 6};
+            if(!osSavesAvx) {
+                return false;
+            }
+
+            __cpuidex(info, 7, 0);
+            return (info[1] & (1 << 5)) != 0;
+    #else
+            __builtin_cpu_init(); // This runs before main(), maybe before libgcc got to it
+            return __builtin_cpu_supports("avx2");
+    #endif
+        }
+
+        const bool HAS_AVX2 {DetectAvx2()};
+#endif
+
+        template<typename Format>
+        inline size_t PlainEnd(const char* data, const size_t size, const size_t from) {
+#ifdef P2MARK_SSE2
+            // Short memos don't fill a single AVX2 block
+            if(HAS_AVX2 && size - from >= 32) {
+                return PlainEndAvx2<Format>(data, size, from);
+            }
+
+            return PlainEndSse2<Format>(data, size, from);
+#else
+            return PlainEndScalar<Format>(data, size, from);
+#endif
+        }
+
+        inline bool IsContinuation(const unsigned char c) {
+            return (c & 0xC0) == 0x80;
+        }
+
+        /// The length of the valid UTF-8 sequence at the start of data
+        /// (RFC 3629: no overlong forms, surrogates or code points above U+10FFFF),
+        /// or 0 if there's none.
+        size_t SequenceLength(const char* data, const size_t size) {
+            const auto* bytes {reinterpret_cast<const unsigned char*>(data)};
+            const unsigned char lead {bytes[0]};
+
+            if(lead < 0x80) {
+                return 1;
+            } else if(lead < 0xC2) {
+                return 0; // A continuation byte, or an overlong two-byte form
+            } else if(lead < 0xE0) {
+                return size >= 2 && IsContinuation(bytes[1]) ? 2 : 0;
+            } else if(lead < 0xF0) {
+                // The second byte rules out the overlong forms and the surrogates
+                const unsigned char low  {static_cast<unsigned char>(lead == 0xE0 ? 0xA0 : 0x80)};
+                const unsigned char high {static_cast<unsigned char>(lead == 0xED ? 0x9F : 0xBF)};
+
+                return size >= 3 && bytes[1] >= low && bytes[1] <= high && IsContinuation(bytes[2]) ? 3 : 0;
+            } else if(lead < 0xF5) {
+                // And here the overlong forms and what's above U+10FFFF
+                const unsigned char low  {static_cast<unsigned char>(lead == 0xF0 ? 0x90 : 0x80)};
+                const unsigned char high {static_cast<unsigned char>(lead == 0xF4 ? 0x8F : 0xBF)};
+
+                return size >= 4 && bytes[1] >= low && bytes[1] <= high &&
+                       IsContinuation(bytes[2]) && IsContinuation(bytes[3]) ? 4 : 0;
+            }
+
+            return 0;
+        }
+
+        /// U+FFFE and U+FFFF are valid UTF-8 but not allowed in XML.
+        inline bool IsXmlNonCharacter(std::string_view sequence) {
+            return sequence == "\xEF\xBF\xBE" || sequence == "\xEF\xBF\xBF";
+        }
+
+        template<typename Format, typename Sink>
+        void Escape(std::string_view text, Sink& sink) {
+            const char* data {text.data()};
+            const size_t size {text.size()};
+            size_t i {0};
+
+            while(i < size) {
+                const size_t plainEnd {PlainEnd<Format>(data, size, i)};
+                sink.Put(std::string_view(data + i, plainEnd - i));
+                i = plainEnd;
+
+                if(i == size) {
+                    break;
+                } else if(static_cast<unsigned char>(data[i]) < 0x80) {
+                    Format::PutAscii(data[i++], sink);
+                    continue;
+                }
+
+                // Text that isn't ASCII (a Japanese memo) rarely is for just one character
+                while(i < size && static_cast<unsigned char>(data[i]) >= 0x80) {
+                    const size_t length {SequenceLength(data + i, size - i)};
+                    const std::string_view sequence {data + i, length};
+
+                    if(length == 0 || (Format::XML_CHARS && IsXmlNonCharacter(sequence))) {
+                        sink.Put(TextEscaper::REPLACEMENT);
+                        i++;
+                    } else {
+                        sink.Put(sequence);
+                        i += length;
+                    }
+                }
+            }
+        }
+    }
+
+    void TextEscaper::AppendXmlAttribute(std::string_view text, std::string& out) {
+        Appender appender {out};
+        Escape<XmlAttributeFormat>(text, appender);
+    }
+
+    size_t TextEscaper::XmlAttributeLength(std::string_view text) {
+        Counter counter {};
+        Escape<XmlAttributeFormat>(text, counter);
+        return counter.Size;
+    }
+
+    void TextEscaper::AppendXmlSafe(std::string_view text, std::string& out) {
+        Appender appender {out};
+        Escape<XmlSafeFormat>(text, appender);
+    }
+
+    void TextEscaper::AppendJson(std::string_view text, std::string& out) {
+        Appender appender {out};
+        Escape<JsonFormat>(text, appender);
+    }
+
+    void TextEscaper::AppendCsv(std::string_view text, std::string& out) {
+        const bool quoted {text.find_first_of(",\"\r\n") != std::string_view::npos};
+
+        if(quoted) {
+            out.push_back('"');
+        }
+
+        Appender appender {out};
+        Escape<CsvFormat>(text, appender);
+
+        if(quoted) {
+            out.push_back('"');
+        }
+    }
+
+    size_t TextEscaper::ValidUtf8Length(std::string_view text) {
+        const char* data {text.data()};
+        const size_t size {text.size()};
+        size_t i {0};
+
+        while(true) {
+            i = PlainEnd<Utf8Format>(data, size, i);
+            if(i == size) {
+                return size;
+            }
+
+            const size_t length {SequenceLength(data + i, size - i)};
+            if(length == 0) {
+                return i;
+            }
+
+            i += length;
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+/*
+* Project: p2mark
+* File:    TextEscaper.hpp
+* Desc:    Vectorised text escaping and UTF-8 validation header file
+* Created: 2026-10-17
+*/
+
+#pragma once
+
+#include <string>
+#include <string_view>
+
+namespace p2mark {
+    /// Escapes marker texts for the formats they're written in, and makes
+    /// them valid UTF-8 on the way: the memos come from the camera as they
+    /// are, and a single stray byte is enough for Premiere to reject an XMP.
+    /// Every byte that doesn't belong to a valid UTF-8 sequence (a lone
+    /// continuation byte, an overlong form, a surrogate...) becomes U+FFFD.
+    ///
+    /// Runs of plain ASCII (nothing to escape, nothing to check) are found
+    /// 32 bytes at a time with AVX2 when the CPU has it, 16 at a time with SSE2
+    /// otherwise (and one at a time on other CPUs) and copied in one go;
+    /// only what isn't plain goes through the byte by byte path.
+    class TextEscaper {
+    public:
+        /// U+FFFD REPLACEMENT CHARACTER
+        static inline constexpr std::string_view REPLACEMENT {"\xEF\xBF\xBD"};
+
+    public:
+        /// Appends the text escaped for a double-quoted XML attribute (" & ' < >,
+        /// the way tinyxml2 did it). The characters XML doesn't allow at all
+        /// (control characters other than tab and line breaks, U+FFFE, U+FFFF)
+        /// are replaced as well.
+        static void AppendXmlAttribute(std::string_view text, std::string& out);
+
+        /// The exact length of what AppendXmlAttribute() appends.
+        static size_t XmlAttributeLength(std::string_view text);
+
+        /// The same replacements without the escaping, for a DOM that escapes by itself.
+        static void AppendXmlSafe(std::string_view text, std::string& out);
+
+        /// Appends the text escaped for the inside of a JSON string.
+        static void AppendJson(std::string_view text, std::string& out);
+
+        /// Appends the text as a CSV field (RFC 4180): quoted only
+        /// if it contains a comma, a quote or a line break.
+        static void AppendCsv(std::string_view text, std::string& out);
+
+        /// The length of the longest beginning of the text that is valid UTF-8.
+        static size_t ValidUtf8Length(std::string_view text);
+
+        static inline bool IsValidUtf8(std::string_view text) { return ValidUtf8Length(text) == text.size(); }
+    };
+}
\ No newline at end of file
@@ -0,0 +1,86 @@
+/*
+* Project: p2mark
+* File:    ThreadSlotRegistry.hpp
+* Desc:    Per-thread slots handed out from a shared registry
+* Created: 2026-10-17
+*/
+
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace p2mark {
+    /// Every slot of type Slot ever handed out, one per thread that asked
+    /// for one (see Current()). The slots of finished threads are kept
+    /// (with whatever they hold) and handed to the next new thread, so
+    /// a pool that replaces its threads doesn't grow a slot per thread.
+    /// Only the owning thread writes to its slot; ForEach() reads them all.
+    template<typename Slot>
+    class ThreadSlotRegistry {
+    public:
+        static ThreadSlotRegistry& Instance() {
+            static ThreadSlotRegistry registry {};
+            return registry;
+        }
+
+        /// The calling thread's slot, taken from the registry on first use.
+        static Slot& Current() {
+            thread_local ThreadSlot slot {};
+            return slot.Get();
+        }
+
+        /// Calls function with every slot, in the order they were first handed out.
+        template<typename Function>
+        void ForEach(Function&& function) {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            for(const std::unique_ptr<Slot>& slot : m_Slots) {
+                function(*slot);
+            }
+        }
+
+    private:
+        /// Gives the slot back when its thread ends.
+        class ThreadSlot {
+        public:
+            ThreadSlot() :
+                m_Registry(ThreadSlotRegistry::Instance()), m_Slot(m_Registry.Acquire()) {}
+
+            ~ThreadSlot() {
+                m_Registry.Release(m_Slot);
+            }
+
+            ThreadSlot(const ThreadSlot&) = delete;
+            ThreadSlot& operator=(const ThreadSlot&) = delete;
+
+            inline Slot& Get() { return *m_Slot; }
+
+        private:
+            ThreadSlotRegistry& m_Registry;
+            Slot* m_Slot;
+        };
+
+        Slot* Acquire() {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+
+            if(!m_Free.empty()) {
+                Slot* slot {m_Free.back()};
+                m_Free.pop_back();
+                return slot;
+            }
+
+            return m_Slots.emplace_back(std::make_unique<Slot>()).get();
+        }
+
+        void Release(Slot* slot) {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Free.push_back(slot);
+        }
+
+    private:
+        std::mutex m_Mutex {};
+        std::vector<std::unique_ptr<Slot>> m_Slots {};
+        std::vector<Slot*> m_Free {};
+    };
+}
\ No newline at end of file
@@ -0,0 +1,134 @@
+/*
+* Project: p2mark
+* File:    TraceRecorder.cpp
+* Desc:    Per-thread stage timeline recorder (--trace) implementation file
+* Created: 2026-10-17
+*/
+
+#include "TraceRecorder.hpp"
+
+#include <format>
+#include <string>
+#include <vector>
+
+#include "AppInfo.hpp"
+#include "StageMetrics.hpp"
+#include "ThreadSlotRegistry.hpp"
+#include "Utils.hpp"
+
+namespace p2mark {
+    namespace {
+        /// One thread's spans. Only the owning thread writes to it;
+        /// the details of all its spans are kept one after another.
+        /// A buffer handed on to a new thread carries on the same timeline.
+        struct alignas(64) TraceBuffer {
+            struct Event {
+                int64_t StartNs      {0}; // Since the trace began
+                int64_t DurationNs   {0};
+                uint64_t DetailBegin {0};
+                uint32_t DetailSize  {0};
+                Stage Step           {};
+            };
+
+            std::vector<Event> Events {};
+            std::string Details {};
+            uint64_t Dropped {0};
+        };
+
+        using TraceRegistry = ThreadSlotRegistry<TraceBuffer>;
+
+        /// When the trace began; written before recording starts.
+        std::chrono::steady_clock::time_point s_Origin {};
+
+        /// Chrome wants microseconds; the fraction keeps the nanoseconds.
+        std::string Microseconds(const int64_t ns) {
+            return std::format("{}.{:03}", ns / 1000, ns % 1000);
+        }
+    }
+
+    void TraceRecorder::Start() {
+        s_Origin = std::chrono::steady_clock::now();
+        s_Recording.store(true, std::memory_order_relaxed);
+    }
+
+    void TraceRecorder::Record(const Stage stage,
+                               const std::chrono::steady_clock::time_point start,
+                               const std::chrono::steady_clock::time_point end,
+                               std::string_view detail) {
+        TraceBuffer& buffer {TraceRegistry::Current()};
+
+        if(buffer.Events.size() >= TraceRecorder::MAX_EVENTS_PER_THREAD) {
+            buffer.Dropped++;
+            return;
+        }
+
+        // A stage that began before the trace did isn't on the timeline
+        const std::chrono::steady_clock::time_point origin {s_Origin};
+        if(start < origin) {
+            return;
+        }
+
+        TraceBuffer::Event& event {buffer.Events.emplace_back()};
+        event.StartNs     = std::chrono::duration_cast<std::chrono::nanoseconds>(start - origin).count();
+        event.DurationNs  = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+        event.DetailBegin = buffer.Details.size();
+        event.DetailSize  = static_cast<uint32_t>(detail.size());
+        event.Step        = stage;
+
+        buffer.Details.append(detail);
+    }
+
+    void TraceRecorder::WriteChromeJson(std::ostream& out) {
+        // Written in pieces: a long run has millions of spans
+        constexpr size_t FLUSH_AT {64 * 1024};
+
+        std::string chunk {};
+        chunk.reserve(FLUSH_AT * 2);
+
+        uint64_t dropped {0};
+        uint32_t thread {0}; // The buffers' numbers in the trace, in the order they were handed out
+        bool first {true};
+
+        const auto next = [&chunk, &first]() {
+            chunk.append(first ? "\n" : ",\n");
+            first = false;
+        };
+
+        chunk.append("{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+
+        next();
+        chunk.append(std::format("{{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 0, "
+                                 "\"args\": {{\"name\": {}}}}}", StringUtils::QuoteJson(AppInfo::Name)));
+
+        TraceRegistry::Instance().ForEach([&](const TraceBuffer& buffer) {
+            dropped += buffer.Dropped;
+            thread++;
+
+            for(const TraceBuffer::Event& event : buffer.Events) {
+                next();
+                chunk.append(std::format("{{\"name\": \"{}\", \"cat\": \"stage\", \"ph\": \"X\", \"pid\": 1, "
+                                         "\"tid\": {}, \"ts\": {}, \"dur\": {}",
+                                         StageToString(event.Step), thread,
+                                         Microseconds(event.StartNs), Microseconds(event.DurationNs)));
+
+                if(event.DetailSize > 0) {
+                    chunk.append(", \"args\": {\"detail\": ");
+                    StringUtils::AppendQuotedJson(std::string_view(buffer.Details).substr(event.DetailBegin,
+                                                                                          event.DetailSize), chunk);
+                    chunk.append("}");
+                }
+
+                chunk.append("}");
+
+                if(chunk.size() >= FLUSH_AT) {
+                    out << chunk;
+                    chunk.clear();
+                }
+            }
+        });
+
+        chunk.append(std::format("\n], \"otherData\": {{\"version\": {}, \"dropped_events\": {}}}}}\n",
+                                 StringUtils::QuoteJson(AppInfo::Version.ToString()), dropped));
+        out << chunk;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,50 @@
+/*
+* Project: p2mark
+* File:    TraceRecorder.hpp
+* Desc:    Per-thread stage timeline recorder (--trace) header file
+* Created: 2026-10-17
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+
+namespace p2mark {
+    enum class Stage : uint8_t;
+
+    /// Records every timed stage (see StageTimer) as a span on its thread's
+    /// timeline, for --trace: where the aggregate latencies only say that
+    /// some clip took long, the trace says which one and what it waited for.
+    /// Every thread appends to its own buffer without taking a lock;
+    /// the buffers are only read once the threads are idle.
+    class TraceRecorder {
+    public:
+        /// A thread that records more than this drops the rest of its spans
+        /// (about 40 MB of them) and the trace says how many it dropped.
+        static inline constexpr size_t MAX_EVENTS_PER_THREAD {1024 * 1024};
+
+    public:
+        /// Begins recording; the trace's timestamps count from here.
+        static void Start();
+
+        static inline bool IsRecording() { return s_Recording.load(std::memory_order_relaxed); }
+
+        /// The detail (a clip's path, say) is copied into the thread's buffer.
+        static void Record(const Stage stage,
+                           const std::chrono::steady_clock::time_point start,
+                           const std::chrono::steady_clock::time_point end,
+                           std::string_view detail);
+
+        /// Writes everything recorded so far in the Chrome trace-event
+        /// format, which Perfetto and chrome://tracing open.
+        /// Only while no thread is recording.
+        static void WriteChromeJson(std::ostream& out);
+
+    private:
+        static inline std::atomic<bool> s_Recording {false};
+    };
+}
\ No newline at end of file
@@ -7,21 +7,19 @@
 
 #include "Utils.hpp"
 
-namespace p2mark::StringUtils {
-    std::vector<std::string> SplitString(std::string_view str, const char delimeter) {
-        std::vector<std::string> tokens {};
-        std::stringstream ss(str.data());
-        std::string token {};
-
-        tokens.reserve(10);
+#include <bit>
+#include <format>
 
-        while(std::getline(ss, token, delimeter)) {
-            tokens.emplace_back(token);
-        }
+#include "StageMetrics.hpp"
+#include "TextEscaper.hpp"
 
-        return tokens;
-    }
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/stat.h>
+#endif
 
+namespace p2mark::StringUtils {
     std::string& StringToLower(std::string& str) {
         for(char& c : str) {
             c = std::tolower(static_cast<unsigned char>(c));
@@ -33,63 +31,115 @@ namespace p2mark::StringUtils {
     void MakeSingularIfNeeded(std::string& str, const int& count) {
         if(!str.empty() && count == 1) str.pop_back();
     }
+
+    std::string QuoteJson(std::string_view str) {
+        std::string json {};
+        json.reserve(str.size() + 2);
+
+        AppendQuotedJson(str, json);
+        return json;
+    }
+
+    void AppendQuotedJson(std::string_view str, std::string& out) {
+        out.push_back('"');
+        TextEscaper::AppendJson(str, out);
+        out.push_back('"');
+    }
+
+    void AppendQuotedCsv(std::string_view str, std::string& out) {
+        TextEscaper::AppendCsv(str, out);
+    }
 }
 
 namespace p2mark::FilesystemUtils {
     bool IsReadOnly(const std::filesystem::path& path) {
         const fs::perms permissions {fs::status(path).permissions()};
+        StageMetrics::CountSyscalls(Syscall::SYSCALL_STAT);
 
         return (permissions & fs::perms::owner_write) == fs::perms::none &&
             (permissions & fs::perms::group_write) == fs::perms::none &&
             (permissions & fs::perms::others_write) == fs::perms::none;
     }
-}
-
-namespace p2mark::XmlUtils {
-    XMLElement* FindDeepElement(XMLElement* root, std::string_view path) {
-        assert(root != nullptr && "FindDeepElement: root must not be null.");
-        assert(!path.empty() && "FindDeepElement: path must not be empty.");
 
-        if(root->NoChildren()) {
-            return nullptr;
+#ifdef _WIN32
+    uint64_t GetDeviceId(const std::filesystem::path& path) {
+        // FILE_FLAG_BACKUP_SEMANTICS is needed to open a directory
+        HANDLE handle {CreateFileW(path.c_str(), FILE_READ_ATTRIBUTES,
+                                   FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                   nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, nullptr)};
+        if(handle == INVALID_HANDLE_VALUE) {
+            return 0;
         }
 
-        XMLElement* current {root};
-        std::vector<std::string> nodeNames {p2mark::StringUtils::SplitString(path, '/')};
+        BY_HANDLE_FILE_INFORMATION info {};
+        const bool ok {GetFileInformationByHandle(handle, &info) != 0};
+        CloseHandle(handle);
 
-        for(const std::string& n : nodeNames) {
-            if(!current) return nullptr;
-            current = current->FirstChildElement(n.c_str());
+        return ok ? static_cast<uint64_t>(info.dwVolumeSerialNumber) : 0;
+    }
+#else
+    uint64_t GetDeviceId(const std::filesystem::path& path) {
+        struct stat st {};
+        if(::stat(path.c_str(), &st) != 0) {
+            return 0;
         }
 
-        return current;
+        return static_cast<uint64_t>(st.st_dev);
     }
+#endif
 }
 
-namespace p2mark::WindowsUtils {
-    std::string GenerateGuid() {
-        // The GUID should be no more than 40 characters in length
-        // Windows adds hyphens and braces: {xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx}
-        constexpr size_t GUID_LEN {40};
-
-        GUID guid {};
-        if(CoCreateGuid(&guid) != S_OK) {
-            throw P2Exception("Can\'t generate a GUID - check your Windows installation",
-                              P2ExceptionCode::CODE_GENERIC);
+namespace p2mark::XmlUtils {
+    /// Scans the children of parent once for the next element of every active path
+    /// (a bit per path); the ones that end here are stored, the others go one level down.
+    static void ResolvePaths(XMLElement* parent, const size_t level, std::span<const XmlPathView> paths,
+                             const uint64_t active, std::span<XMLElement*> found) {
+        uint64_t pending {active}; // Still looking for their child on this level
+
+        for(XMLElement* child {parent->FirstChildElement()}; child && pending; child = child->NextSiblingElement()) {
+            const char* name {child->Name()};
+            uint64_t picked {0};
+
+            for(uint64_t rest {pending}; rest; rest &= rest - 1) {
+                const size_t i {static_cast<size_t>(std::countr_zero(rest))};
+                if(XMLUtil::StringEqual(name, paths[i].Element(level))) {
+                    picked |= uint64_t {1} << i;
+                }
+            }
+
+            if(!picked) {
+                continue;
+            }
+
+            pending &= ~picked;
+
+            uint64_t deeper {0};
+            for(uint64_t rest {picked}; rest; rest &= rest - 1) {
+                const size_t i {static_cast<size_t>(std::countr_zero(rest))};
+                if(level + 1 == paths[i].Depth) {
+                    found[i] = child;
+                } else {
+                    deeper |= uint64_t {1} << i;
+                }
+            }
+
+            if(deeper) {
+                ResolvePaths(child, level + 1, paths, deeper, found);
+            }
         }
+    }
 
-        WCHAR guidStr[GUID_LEN] {};
-        if(StringFromGUID2(guid, guidStr, GUID_LEN) == 0) {
-            throw P2Exception("Can\'t convert a GUID into string - check your Windows installation",
-                              P2ExceptionCode::CODE_GENERIC);
-        }
+    void FindDeepElements(XMLElement* root, std::span<const XmlPathView> paths, std::span<XMLElement*> found) {
+        assert(root != nullptr && "FindDeepElements: root must not be null.");
+        assert(paths.size() <= 64 && found.size() >= paths.size() && "FindDeepElements: too many paths.");
 
-        // Conversion from a wide string to a short string
-        size_t narrowLen {static_cast<size_t>(WideCharToMultiByte(CP_UTF8, 0, guidStr, -1, nullptr, 0, nullptr, nullptr))};
-        std::string s(narrowLen, 0);
-        WideCharToMultiByte(CP_UTF8, 0, guidStr, -1, s.data(), static_cast<int>(narrowLen), nullptr, nullptr);
+        std::fill(found.begin(), found.end(), nullptr);
+
+        uint64_t active {0};
+        for(size_t i {0}; i < paths.size(); i++) {
+            active |= uint64_t {1} << i;
+        }
 
-        s.resize(narrowLen - 1); // Remove the null terminator
-        return p2mark::StringUtils::StringToLower(s).substr(1, s.size() - 2); // substr removes the braces
+        ResolvePaths(root, 0, paths, active, found);
     }
 }
\ No newline at end of file
@@ -7,38 +7,76 @@
 
 #pragma once
 
+#include <array>
 #include <vector>
 #include <string>
 #include <sstream>
-#include <Windows.h>
-#include <rpcdce.h>
 #include <iostream>
 #include <algorithm>
 #include <cctype>
 #include <filesystem>
 #include <cassert>
+#include <cstdint>
+#include <span>
 
 #include "tinyxml2.h"
 
 #include "P2Exception.hpp"
+#include "XmlPath.hpp"
 
 namespace fs = std::filesystem;
 using namespace tinyxml2;
 
 namespace p2mark::StringUtils {
-    std::vector<std::string> SplitString(std::string_view str, const char delimeter);
     std::string& StringToLower(std::string& str);
     void MakeSingularIfNeeded(std::string& str, const int& count);
+
+    /// The text as a quoted JSON string literal (invalid UTF-8 repaired, see TextEscaper).
+    std::string QuoteJson(std::string_view str);
+
+    /// The same, appended to out.
+    void AppendQuotedJson(std::string_view str, std::string& out);
+
+    /// Appends the text as a CSV field (RFC 4180): quoted only
+    /// if it contains a comma, a quote or a line break. Invalid UTF-8 is repaired.
+    void AppendQuotedCsv(std::string_view str, std::string& out);
 }
 
 namespace p2mark::FilesystemUtils {
     bool IsReadOnly(const fs::path& path);
+
+    /// Identifies the volume (device) the path lives on;
+    /// two paths on the same card reader return the same value.
+    uint64_t GetDeviceId(const fs::path& path);
 }
 
 namespace p2mark::XmlUtils {
-    XMLElement* FindDeepElement(XMLElement* root, std::string_view path);
-}
+    /// The element at the end of the path below root: the first child element
+    /// with the next name on every level. Returns nullptr if there's none.
+    template<size_t Length, size_t Levels>
+    XMLElement* FindDeepElement(XMLElement* root, const XmlPath<Length, Levels>& path) {
+        assert(root != nullptr && "FindDeepElement: root must not be null.");
+
+        XMLElement* current {root};
+        for(size_t level {0}; level < path.Depth() && current; level++) {
+            current = current->FirstChildElement(path.ElementName(level));
+        }
+
+        return current;
+    }
+
+    /// Looks up every path with the same rules as FindDeepElement(),
+    /// but in a single walk down the tree: paths that share a beginning
+    /// share its lookups, and every child list is scanned at most once.
+    /// found[i] is where paths[i] leads, or nullptr. Up to 64 paths.
+    void FindDeepElements(XMLElement* root, std::span<const XmlPathView> paths, std::span<XMLElement*> found);
+
+    template<typename... Paths>
+    std::array<XMLElement*, sizeof...(Paths)> FindDeepElements(XMLElement* root, const Paths&... paths) {
+        const std::array<XmlPathView, sizeof...(Paths)> views {paths.View()...};
+        std::array<XMLElement*, sizeof...(Paths)> found {};
 
-namespace p2mark::WindowsUtils {
-    std::string GenerateGuid();
+        FindDeepElements(root, std::span<const XmlPathView>(views), std::span<XMLElement*>(found));
+        return found;
+    }
 }
\ No newline at end of file
@@ -0,0 +1,135 @@
+/*
+* Project: p2mark
+* File:    WorkerPool.cpp
+* Desc:    Work-stealing thread pool implementation file
+* Created: 2026-10-17
+*/
+
+#include "WorkerPool.hpp"
+
+namespace p2mark {
+    WorkerPool::WorkerPool(const size_t workerCount) {
+        const size_t count {workerCount == 0 ? 1 : workerCount};
+
+        m_Queues.reserve(count);
+        for(size_t i {0}; i < count; i++) {
+            m_Queues.emplace_back(std::make_unique<WorkQueue>());
+        }
+
+        // Worker 0 is the thread that calls ParallelFor()
+        m_Threads.reserve(count - 1);
+        for(size_t i {1}; i < count; i++) {
+            m_Threads.emplace_back(&WorkerPool::WorkerLoop, this, i);
+        }
+    }
+
+    WorkerPool::~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Stopping = true;
+        }
+
+        m_WakeCondition.notify_all();
+
+        for(std::thread& t : m_Threads) {
+            t.join();
+        }
+    }
+
+    void WorkerPool::ParallelFor(const size_t taskCount, const IndexTask& task) {
+        if(taskCount == 0) {
+            return;
+        }
+
+        // Hand out contiguous blocks, so every worker starts on its own
+        // run of neighbouring clips and only steals once it runs dry
+        const size_t workers {WorkerCount()};
+        for(size_t w {0}; w < workers; w++) {
+            const size_t begin {taskCount * w / workers};
+            const size_t end   {taskCount * (w + 1) / workers};
+
+            std::lock_guard<std::mutex> lock(m_Queues[w]->Mutex);
+            for(size_t i {begin}; i < end; i++) {
+                m_Queues[w]->Indices.push_back(i);
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Task = &task;
+            m_BusyWorkers = m_Threads.size();
+            m_Generation++;
+        }
+
+        m_WakeCondition.notify_all();
+        Drain(0);
+
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_DoneCondition.wait(lock, [this]() { return m_BusyWorkers == 0; });
+        m_Task = nullptr;
+    }
+
+    void WorkerPool::WorkerLoop(const size_t worker) {
+        size_t seenGeneration {0};
+
+        while(true) {
+            {
+                std::unique_lock<std::mutex> lock(m_Mutex);
+                m_WakeCondition.wait(lock, [this, &seenGeneration]() {
+                    return m_Stopping || m_Generation != seenGeneration;
+                });
+
+                if(m_Stopping) {
+                    return;
+                }
+
+                seenGeneration = m_Generation;
+            }
+
+            Drain(worker);
+
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            if(--m_BusyWorkers == 0) {
+                m_DoneCondition.notify_one();
+            }
+        }
+    }
+
+    void WorkerPool::Drain(const size_t worker) {
+        size_t index {0};
+
+        while(PopLocal(worker, index) || Steal(worker, index)) {
+            (*m_Task)(index, worker);
+        }
+    }
+
+    bool WorkerPool::PopLocal(const size_t worker, size_t& index) {
+        WorkQueue& queue {*m_Queues[worker]};
+        std::lock_guard<std::mutex> lock(queue.Mutex);
+
+        if(queue.Indices.empty()) {
+            return false;
+        }
+
+        index = queue.Indices.front();
+        queue.Indices.pop_front();
+        return true;
+    }
+
+    bool WorkerPool::Steal(const size_t thief, size_t& index) {
+        const size_t workers {WorkerCount()};
+
+        for(size_t i {1}; i < workers; i++) {
+            WorkQueue& victim {*m_Queues[(thief + i) % workers]};
+            std::lock_guard<std::mutex> lock(victim.Mutex);
+
+            if(!victim.Indices.empty()) {
+                index = victim.Indices.back();
+                victim.Indices.pop_back();
+                return true;
+            }
+        }
+
+        return false;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,72 @@
+/*
+* Project: p2mark
+* File:    WorkerPool.hpp
+* Desc:    Work-stealing thread pool header file
+* Created: 2026-10-17
+*/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace p2mark {
+    /// A small work-stealing pool for running independent per-clip tasks.
+    /// Every worker owns a queue of task indices and pops from its front,
+    /// so neighbouring clips stay on the same worker; an idle worker steals
+    /// from the back of someone else's queue. The calling thread takes part
+    /// as worker 0, so a pool of one worker spawns no threads at all.
+    class WorkerPool {
+    public:
+        using IndexTask = std::function<void(const size_t index, const size_t worker)>;
+
+    public:
+        explicit WorkerPool(const size_t workerCount);
+        ~WorkerPool();
+
+        WorkerPool(const WorkerPool&) = delete;
+        WorkerPool& operator=(const WorkerPool&) = delete;
+
+    public:
+        inline size_t WorkerCount() const { return m_Queues.size(); }
+
+        /// Runs task(index, worker) for every index in [0, taskCount)
+        /// and blocks until all of them are finished.
+        /// Tasks must not throw; catch everything inside the task.
+        void ParallelFor(const size_t taskCount, const IndexTask& task);
+
+    private:
+        struct WorkQueue {
+            std::mutex Mutex;
+            std::deque<size_t> Indices;
+        };
+
+    private:
+        void WorkerLoop(const size_t worker);
+
+        /// Keeps running tasks until there is nothing left to take or steal.
+        void Drain(const size_t worker);
+
+        bool PopLocal(const size_t worker, size_t& index);
+        bool Steal(const size_t thief, size_t& index);
+
+    private:
+        std::vector<std::unique_ptr<WorkQueue>> m_Queues;
+        std::vector<std::thread> m_Threads;
+
+        std::mutex m_Mutex;
+        std::condition_variable m_WakeCondition;
+        std::condition_variable m_DoneCondition;
+
+        const IndexTask* m_Task {nullptr};
+        size_t m_Generation     {0};
+        size_t m_BusyWorkers    {0};
+        bool m_Stopping         {false};
+    };
+}
\ No newline at end of file
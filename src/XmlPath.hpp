@@ -0,0 +1,102 @@
+/*
+* Project: p2mark
+* File:    XmlPath.hpp
+* Desc:    Element paths parsed at compile time
+* Created: 2026-10-17
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace p2mark {
+    /// A string literal that can be passed as a template argument.
+    template<size_t N>
+    struct XmlPathText {
+        char Chars[N] {};
+
+        consteval XmlPathText(const char (&text)[N]) {
+            std::copy_n(text, N, Chars);
+        }
+
+        constexpr std::string_view View() const { return {Chars, N - 1}; }
+    };
+
+    /// What the lookups need from a path of any length.
+    struct XmlPathView {
+        const char* Names       {nullptr};
+        const uint16_t* Offsets {nullptr};
+        size_t Depth            {0};
+
+        inline const char* Element(const size_t level) const { return Names + Offsets[level]; }
+    };
+
+    /// An element path ("a/b/c", relative to the element it's looked up from),
+    /// split into null-terminated element names once, at compile time.
+    /// Make one with CompileXmlPath<"a/b/c">(); an empty path or an empty
+    /// element name doesn't compile.
+    template<size_t Length, size_t Levels>
+    class XmlPath {
+    public:
+        consteval explicit XmlPath(std::string_view text) {
+            size_t level {0};
+            size_t start {0};
+
+            for(size_t i {0}; i <= text.size(); i++) {
+                if(i < text.size() && text[i] != '/') {
+                    m_Names[i] = text[i];
+                    continue;
+                }
+
+                if(i == start || level == Levels) {
+                    throw "XmlPath: every element of the path needs a name";
+                }
+
+                m_Offsets[level] = static_cast<uint16_t>(start);
+                m_Lengths[level] = static_cast<uint16_t>(i - start);
+                m_Names[i] = '\0';
+
+                level++;
+                start = i + 1;
+            }
+
+            if(level != Levels) {
+                throw "XmlPath: wrong number of elements";
+            }
+        }
+
+    public:
+        constexpr size_t Depth() const { return Levels; }
+
+        constexpr std::string_view Element(const size_t level) const {
+            return {m_Names.data() + m_Offsets[level], m_Lengths[level]};
+        }
+
+        /// The same name, null-terminated, for tinyxml2.
+        constexpr const char* ElementName(const size_t level) const {
+            return m_Names.data() + m_Offsets[level];
+        }
+
+        constexpr XmlPathView View() const {
+            return {m_Names.data(), m_Offsets.data(), Levels};
+        }
+
+    private:
+        std::array<char, Length + 1> m_Names   {}; // Every '/' becomes a '\0'
+        std::array<uint16_t, Levels> m_Offsets {};
+        std::array<uint16_t, Levels> m_Lengths {};
+    };
+
+    template<XmlPathText Text>
+    consteval auto CompileXmlPath() {
+        constexpr std::string_view text {Text.View()};
+        static_assert(!text.empty(), "XmlPath: the path is empty");
+        static_assert(text.size() < UINT16_MAX, "XmlPath: the path is too long");
+
+        return XmlPath<text.size(), static_cast<size_t>(std::count(text.begin(), text.end(), '/')) + 1>(text);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,326 @@
+/*
+* Project: p2mark
+* File:    XmlPullParser.cpp
+* Desc:    Minimal streaming XML tokenizer implementation file
+* Created: 2026-10-17
+*/
+
+#include "XmlPullParser.hpp"
+
+namespace p2mark {
+    namespace {
+        constexpr std::string_view UTF8_BOM {"\xEF\xBB\xBF"};
+
+        constexpr bool IsSpaceChar(const char c) {
+            return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+        }
+
+        void AppendUtf8(const unsigned long codePoint, std::string& out) {
+            if(codePoint < 0x80) {
+                out.push_back(static_cast<char>(codePoint));
+            } else if(codePoint < 0x800) {
+                out.push_back(static_cast<char>(0xC0 | (codePoint >> 6)));
+                out.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+            } else if(codePoint < 0x10000) {
+                out.push_back(static_cast<char>(0xE0 | (codePoint >> 12)));
+                out.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+                out.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+            } else if(codePoint < 0x110000) {
+                out.push_back(static_cast<char>(0xF0 | (codePoint >> 18)));
+                out.push_back(static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F)));
+                out.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+                out.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+            }
+        }
+
+        /// Decodes one entity starting right after the '&'.
+        /// Returns how many bytes it took (including the ';'), 0 if it isn't one.
+        size_t DecodeEntity(std::string_view s, std::string& out) {
+            const size_t semicolon {s.find(';')};
+            if(semicolon == std::string_view::npos || semicolon == 0) {
+                return 0;
+            }
+
+            const std::string_view name {s.substr(0, semicolon)};
+
+            if(name[0] == '#') {
+                const bool hex {name.size() > 1 && (name[1] == 'x' || name[1] == 'X')};
+                const std::string_view digits {name.substr(hex ? 2 : 1)};
+                unsigned long codePoint {0};
+
+                if(digits.empty()) {
+                    return 0;
+                }
+
+                for(const char c : digits) {
+                    unsigned long digit {0};
+
+                    if(c >= '0' && c <= '9') {
+                        digit = static_cast<unsigned long>(c - '0');
+                    } else if(hex && c >= 'a' && c <= 'f') {
+                        digit = static_cast<unsigned long>(c - 'a' + 10);
+                    } else if(hex && c >= 'A' && c <= 'F') {
+                        digit = static_cast<unsigned long>(c - 'A' + 10);
+                    } else {
+                        return 0;
+                    }
+
+                    codePoint = codePoint * (hex ? 16 : 10) + digit;
+                    if(codePoint >= 0x110000) {
+                        return 0;
+                    }
+                }
+
+                AppendUtf8(codePoint, out);
+                return semicolon + 1;
+            }
+
+            constexpr std::pair<std::string_view, char> entities[] {
+                {"quot", '\"'}, {"amp", '&'}, {"apos", '\''}, {"lt", '<'}, {"gt", '>'}
+            };
+
+            for(const auto& [entity, value] : entities) {
+                if(name == entity) {
+                    out.push_back(value);
+                    return semicolon + 1;
+                }
+            }
+
+            return 0;
+        }
+    }
+
+    XmlPullParser::XmlPullParser() {
+        m_OpenTags.reserve(XmlPullParser::DEPTH_RESERVE);
+    }
+
+    void XmlPullParser::Feed(std::string_view data, const bool final) {
+        m_Data  = data;
+        m_Final = final;
+    }
+
+    XmlTokenType XmlPullParser::Next(XmlToken& token) {
+        // Comments, processing instructions and the DOCTYPE are skipped in this loop
+        // rather than by calling Next() again: a clip full of them mustn't nest a frame for each
+        while(true) {
+            if(m_Pos == 0 && m_Data.size() >= 2) {
+                const unsigned char b0 {static_cast<unsigned char>(m_Data[0])};
+                const unsigned char b1 {static_cast<unsigned char>(m_Data[1])};
+
+                // UTF-16 needs transcoding, leave that to the DOM
+                if((b0 == 0xFF && b1 == 0xFE) || (b0 == 0xFE && b1 == 0xFF)) {
+                    return token.Type = XmlTokenType::UNSUPPORTED;
+                }
+
+                if(m_Data.starts_with(UTF8_BOM)) {
+                    m_Pos = UTF8_BOM.size();
+                } else if(m_Data.size() < UTF8_BOM.size() && !m_Final) {
+                    return token.Type = XmlTokenType::NEED_MORE;
+                }
+            }
+
+            if(m_Pos >= m_Data.size()) {
+                if(!m_Final) {
+                    return token.Type = XmlTokenType::NEED_MORE;
+                }
+                return token.Type = m_OpenTags.empty() ? XmlTokenType::END_OF_INPUT : XmlTokenType::MALFORMED;
+            }
+
+            if(m_Data[m_Pos] == '<') {
+                bool skipped {false};
+                const XmlTokenType type {ParseMarkup(token, skipped)};
+                if(skipped) {
+                    continue;
+                }
+                return type;
+            }
+
+            // Character data runs until the next tag
+            const size_t begin {m_Pos};
+            const size_t lt {m_Data.find('<', begin)};
+
+            if(lt == std::string_view::npos) {
+                if(!m_Final) {
+                    return token.Type = XmlTokenType::NEED_MORE;
+                }
+
+                // Trailing whitespace after the root element is fine, anything else isn't
+                if(!m_OpenTags.empty() || !IsWhitespace(m_Data.substr(begin))) {
+                    return token.Type = XmlTokenType::MALFORMED;
+                }
+
+                m_Pos = m_Data.size();
+                return token.Type = XmlTokenType::END_OF_INPUT;
+            }
+
+            token.Content = m_Data.substr(begin, lt - begin);
+            return Finish(token, XmlTokenType::TEXT, begin, lt);
+        }
+    }
+
+    XmlTokenType XmlPullParser::ParseMarkup(XmlToken& token, bool& skipped) {
+        const std::string_view rest {m_Data.substr(m_Pos)};
+
+        // Not enough data to tell what kind of markup this is
+        if(rest.size() < 9 && !m_Final && rest.find('>') == std::string_view::npos) {
+            return token.Type = XmlTokenType::NEED_MORE;
+        }
+
+        if(rest.starts_with("<!--")) {
+            const XmlTokenType type {SkipUntil("-->", m_Pos + 4)};
+            skipped = type == XmlTokenType::TEXT;
+            return token.Type = type;
+        }
+
+        if(rest.starts_with("<?")) {
+            const XmlTokenType type {SkipUntil("?>", m_Pos + 2)};
+            skipped = type == XmlTokenType::TEXT;
+            return token.Type = type;
+        }
+
+        if(rest.starts_with("<![CDATA[")) {
+            const size_t begin {m_Pos};
+            const size_t close {m_Data.find("]]>", begin + 9)};
+
+            if(close == std::string_view::npos) {
+                return token.Type = m_Final ? XmlTokenType::MALFORMED : XmlTokenType::NEED_MORE;
+            }
+
+            token.Content = m_Data.substr(begin + 9, close - begin - 9);
+            return Finish(token, XmlTokenType::CDATA, begin, close + 3);
+        }
+
+        if(rest.starts_with("<!")) {
+            const size_t close {rest.find('>')};
+
+            if(close == std::string_view::npos) {
+                return token.Type = m_Final ? XmlTokenType::MALFORMED : XmlTokenType::NEED_MORE;
+            }
+
+            // An internal DTD subset may declare entities of its own
+            if(rest.substr(0, close).find('[') != std::string_view::npos) {
+                return token.Type = XmlTokenType::UNSUPPORTED;
+            }
+
+            m_Pos += close + 1;
+            skipped = true;
+            return token.Type = XmlTokenType::TEXT;
+        }
+
+        return ParseTag(token);
+    }
+
+    XmlTokenType XmlPullParser::ParseTag(XmlToken& token) {
+        const size_t begin {m_Pos};
+        const bool closing {m_Data.size() > begin + 1 && m_Data[begin + 1] == '/'};
+        char quote {0};
+        size_t end {begin + 1};
+
+        // Find the closing bracket, '>' inside attribute values doesn't count
+        for(; end < m_Data.size(); end++) {
+            const char c {m_Data[end]};
+
+            if(quote) {
+                if(c == quote) quote = 0;
+            } else if(c == '\"' || c == '\'') {
+                quote = c;
+            } else if(c == '>') {
+                break;
+            } else if(c == '<') {
+                return token.Type = XmlTokenType::MALFORMED;
+            }
+        }
+
+        if(end >= m_Data.size()) {
+            return token.Type = m_Final ? XmlTokenType::MALFORMED : XmlTokenType::NEED_MORE;
+        }
+
+        const size_t nameBegin {begin + (closing ? 2 : 1)};
+        size_t nameEnd {nameBegin};
+        while(nameEnd < end && !IsSpaceChar(m_Data[nameEnd]) && m_Data[nameEnd] != '/') {
+            nameEnd++;
+        }
+
+        if(nameEnd == nameBegin) {
+            return token.Type = XmlTokenType::MALFORMED;
+        }
+
+        token.Name = m_Data.substr(nameBegin, nameEnd - nameBegin);
+
+        if(closing) {
+            if(m_OpenTags.empty()) {
+                return token.Type = XmlTokenType::MALFORMED;
+            }
+
+            const auto [openBegin, openLength] {m_OpenTags.back()};
+            if(m_Data.substr(openBegin, openLength) != token.Name) {
+                return token.Type = XmlTokenType::MALFORMED;
+            }
+
+            m_OpenTags.pop_back();
+            token.Content = {};
+            return Finish(token, XmlTokenType::END_TAG, begin, end + 1);
+        }
+
+        const bool empty {m_Data[end - 1] == '/'};
+        token.Content = m_Data.substr(nameEnd, (empty ? end - 1 : end) - nameEnd);
+
+        if(empty) {
+            return Finish(token, XmlTokenType::EMPTY_TAG, begin, end + 1);
+        }
+
+        m_OpenTags.emplace_back(nameBegin, nameEnd - nameBegin);
+        return Finish(token, XmlTokenType::START_TAG, begin, end + 1);
+    }
+
+    XmlTokenType XmlPullParser::SkipUntil(std::string_view terminator, const size_t from) {
+        const size_t found {m_Data.find(terminator, from)};
+
+        if(found == std::string_view::npos) {
+            return m_Final ? XmlTokenType::MALFORMED : XmlTokenType::NEED_MORE;
+        }
+
+        m_Pos = found + terminator.size();
+        return XmlTokenType::TEXT; // Anything but NEED_MORE and MALFORMED means "skipped"
+    }
+
+    XmlTokenType XmlPullParser::Finish(XmlToken& token, const XmlTokenType type,
+                                       const size_t begin, const size_t end) {
+        token.Type  = type;
+        token.Begin = begin;
+        token.End   = end;
+        m_Pos       = end;
+        return type;
+    }
+
+    void XmlPullParser::DecodeText(std::string_view raw, std::string& out) {
+        out.reserve(out.size() + raw.size());
+
+        for(size_t i {0}; i < raw.size(); i++) {
+            const char c {raw[i]};
+
+            if(c == '&') {
+                const size_t taken {DecodeEntity(raw.substr(i + 1), out)};
+                if(taken > 0) {
+                    i += taken;
+                    continue;
+                }
+            } else if(c == '\r') {
+                // CR LF and lone CR both become LF
+                out.push_back('\n');
+                if(i + 1 < raw.size() && raw[i + 1] == '\n') i++;
+                continue;
+            }
+
+            out.push_back(c);
+        }
+    }
+
+    bool XmlPullParser::IsWhitespace(std::string_view text) {
+        for(const char c : text) {
+            if(!IsSpaceChar(c)) return false;
+        }
+
+        return true;
+    }
+}
\ No newline at end of file
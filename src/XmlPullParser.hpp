@@ -0,0 +1,84 @@
+/*
+* Project: p2mark
+* File:    XmlPullParser.hpp
+* Desc:    Minimal streaming XML tokenizer header file
+* Created: 2026-10-17
+*/
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace p2mark {
+    enum class XmlTokenType {
+        START_TAG = 0,
+        END_TAG,
+        EMPTY_TAG,
+        TEXT,
+        CDATA,
+        NEED_MORE,    // The token isn't complete yet, feed more data
+        END_OF_INPUT,
+        MALFORMED,
+        UNSUPPORTED   // Valid XML, but not something we want to handle without a DOM
+    };
+
+    struct XmlToken {
+        XmlTokenType Type        {XmlTokenType::END_OF_INPUT};
+        std::string_view Name    {}; // Tags only
+        std::string_view Content {}; // Raw attributes for tags, raw text for text and CDATA
+        size_t Begin             {0}; // Byte offset of the token in the fed data
+        size_t End               {0}; // One past the last byte of the token
+    };
+
+    /// A tiny pull tokenizer that only understands as much XML as
+    /// P2 clip files and Adobe's XMPs use. It doesn't build anything;
+    /// the caller asks for the next token and decides when to stop.
+    /// Data is fed incrementally: every Feed() must pass the whole
+    /// input read so far (the same bytes plus whatever was appended),
+    /// so token offsets stay valid while the buffer grows.
+    class XmlPullParser {
+    public:
+        static inline constexpr size_t DEPTH_RESERVE {16};
+
+    public:
+        XmlPullParser();
+
+    public:
+        void Feed(std::string_view data, const bool final);
+
+        /// Returns the next token. Comments, processing instructions and
+        /// DOCTYPE declarations are skipped. Nothing is consumed if the
+        /// returned type is NEED_MORE.
+        XmlTokenType Next(XmlToken& token);
+
+        /// Number of currently open elements.
+        inline size_t Depth() const { return m_OpenTags.size(); }
+
+        /// Appends the text with the XML entities decoded and
+        /// line endings normalised, the same way tinyxml2 does.
+        static void DecodeText(std::string_view raw, std::string& out);
+
+        static bool IsWhitespace(std::string_view text);
+
+    private:
+        /// Sets skipped (and returns nothing of use) if the markup was
+        /// a comment, a processing instruction or a DOCTYPE.
+        XmlTokenType ParseMarkup(XmlToken& token, bool& skipped);
+        XmlTokenType ParseTag(XmlToken& token);
+        XmlTokenType SkipUntil(std::string_view terminator, const size_t from);
+
+        XmlTokenType Finish(XmlToken& token, const XmlTokenType type,
+                            const size_t begin, const size_t end);
+
+    private:
+        std::string_view m_Data {};
+        size_t m_Pos            {0};
+        bool m_Final            {false};
+
+        /// Offset and length of every open tag's name
+        std::vector<std::pair<size_t, size_t>> m_OpenTags;
+    };
+}
\ No newline at end of file
@@ -7,26 +7,252 @@
 
 #include "XmlReader.hpp"
 
+#include "ClipManifest.hpp"
+
 namespace p2mark {
-    XmlReader::XmlReader(const fs::path& xmlFilePath) :
-        m_FilePath(xmlFilePath) {
+    XmlReader::XmlReader(const fs::path& xmlFilePath, ParseContext& context) :
+        m_FilePath(xmlFilePath), m_Context(context), m_Buffer(context.ReadBuffer()),
+        m_XmlDoc(context.ClipDocument()), m_Markers(context.Markers()) {
+
+        m_Context.BeginClip();
+
+        // Fall back to plain reads if the file can't be mapped
+        if(!m_Mapping.Open(xmlFilePath)) {
+            m_File.open(xmlFilePath, std::ios::in | std::ios::binary);
+
+            if(!m_File.is_open()) {
+                throw P2Exception("Can\'t load a clip file", P2ExceptionCode::CODE_XML_READ_ERROR);
+            }
+
+            StageMetrics::CountSyscalls(Syscall::SYSCALL_OPEN, 2);
+            m_Buffer.reserve(XmlReader::READ_CHUNK_SIZE);
+        }
+    }
+
+    XmlReader::XmlReader(const fs::path& xmlFilePath, std::string& contents, ParseContext& context) :
+        m_FilePath(xmlFilePath), m_Context(context), m_Buffer(context.ReadBuffer()), m_Preloaded(true),
+        m_XmlDoc(context.ClipDocument()), m_Markers(context.Markers()) {
+
+        m_Context.BeginClip();
+        m_Buffer.swap(contents);
+    }
+
+    std::span<const Marker> XmlReader::ParseSourceXml() {
+        StageTimer timer(Stage::STAGE_PARSE);
+
+        if(!StreamMemoList()) {
+            m_Markers.clear();
+            ParseWithDom();
+        }
+
+        return m_Markers;
+    }
+
+    MarkerRange XmlReader::ParseInto(MarkerStore& store) {
+        return store.Append(ParseSourceXml());
+    }
+
+    bool XmlReader::HashContents(uint64_t& hash) const {
+        if(!m_Mapping.IsOpen() && !m_Preloaded) {
+            return false;
+        }
+
+        hash = ClipManifest::HashContents(Input());
+        return true;
+    }
+
+    // The path is: P2Main -> ClipContent -> ClipMetadata -> MemoList -> Memo;
+    // this mirrors what FindDeepElement() and ParseTextMemoElement() do
+    // with the DOM, but stops reading as soon as the MemoList is closed
+    bool XmlReader::StreamMemoList() {
+        constexpr size_t MEMO_LIST_DEPTH {MEMO_LIST_PATH.Depth() + 1};
+        constexpr size_t MEMO_DEPTH      {MEMO_LIST_DEPTH + 1};
+        constexpr size_t FIELD_DEPTH     {MEMO_LIST_DEPTH + 2};
+
+        enum class Field { NONE, OFFSET, TEXT };
+
+        XmlPullParser parser {};
+        XmlToken token {};
+        bool lastChunk {m_Mapping.IsOpen() || !ReadNextChunk()};
+        bool rootFound {false};
+        size_t matched {0}; // How many levels of the path are open right now
+
+        // The memo being assembled
+        bool memoHasContent {false};
+        bool offsetFound    {false};
+        bool textFound      {false};
+        bool fieldHasChild  {false};
+        Field field         {Field::NONE};
+        std::string offsetText {};
+        Marker mark {};
+
+        const auto damaged = []() {
+            return P2Exception("The clip file is damaged or has incorrect type",
+                               P2ExceptionCode::CODE_XML_READ_ERROR);
+        };
+
+        parser.Feed(Input(), lastChunk);
+
+        while(true) {
+            const XmlTokenType type {parser.Next(token)};
+
+            if(type == XmlTokenType::NEED_MORE) {
+                lastChunk = !ReadNextChunk();
+                parser.Feed(Input(), lastChunk);
+                continue;
+            } else if(type == XmlTokenType::UNSUPPORTED) {
+                return false;
+            } else if(type == XmlTokenType::MALFORMED) {
+                throw damaged();
+            } else if(type == XmlTokenType::END_OF_INPUT) {
+                if(!rootFound) throw damaged();
+                return true;
+            }
+
+            if(type == XmlTokenType::START_TAG || type == XmlTokenType::EMPTY_TAG) {
+                const size_t depth {type == XmlTokenType::START_TAG ? parser.Depth() : parser.Depth() + 1};
+                const bool empty {type == XmlTokenType::EMPTY_TAG};
+                rootFound = true;
+
+                if(depth <= MEMO_LIST_DEPTH && matched == depth - 1 &&
+                   (depth == 1 || token.Name == MEMO_LIST_PATH.Element(depth - 2))) {
+                    // A childless element on the path means there are no memos
+                    if(empty) return true;
+                    matched = depth;
+                } else if(matched == MEMO_LIST_DEPTH && depth == MEMO_DEPTH) {
+                    // Any child of the MemoList is a memo; an empty one ends the list
+                    if(empty) return true;
+
+                    memoHasContent = false;
+                    offsetFound    = false;
+                    textFound      = false;
+                    mark           = {};
+                } else if(matched == MEMO_LIST_DEPTH && depth == FIELD_DEPTH) {
+                    memoHasContent = true;
+
+                    if(token.Name == OFFSET_ELEM && !offsetFound) {
+                        offsetFound = true;
+                        offsetText.clear();
+                        field = empty ? Field::NONE : Field::OFFSET;
+                    } else if(token.Name == TEXT_ELEM && !textFound) {
+                        textFound = true;
+                        field = empty ? Field::NONE : Field::TEXT;
+                    }
+
+                    fieldHasChild = false;
+                } else if(matched == MEMO_LIST_DEPTH && depth == FIELD_DEPTH + 1) {
+                    fieldHasChild = true; // GetText() only looks at the first child
+                }
+            } else if(type == XmlTokenType::TEXT || type == XmlTokenType::CDATA) {
+                const size_t depth {parser.Depth()};
+                const bool cdata {type == XmlTokenType::CDATA};
+
+                // Whitespace between elements isn't a node for tinyxml2
+                if(!cdata && XmlPullParser::IsWhitespace(token.Content)) {
+                    continue;
+                }
+
+                if(matched == MEMO_LIST_DEPTH && depth == MEMO_DEPTH) {
+                    memoHasContent = true;
+                } else if(depth == FIELD_DEPTH && field != Field::NONE && !fieldHasChild) {
+                    if(field == Field::OFFSET) {
+                        if(cdata) {
+                            offsetText.assign(token.Content);
+                        } else {
+                            XmlPullParser::DecodeText(token.Content, offsetText);
+                        }
+                    } else {
+                        // Taken right away: the read buffer may move when it grows
+                        mark.text = KeepText(token.Content, cdata);
+                    }
 
-        if(m_XmlDoc.LoadFile(xmlFilePath.string().c_str()) != XML_SUCCESS) {
+                    fieldHasChild = true;
+                }
+            } else if(type == XmlTokenType::END_TAG) {
+                const size_t depth {parser.Depth() + 1};
+
+                if(depth == FIELD_DEPTH) {
+                    field = Field::NONE;
+                } else if(matched == MEMO_LIST_DEPTH && depth == MEMO_DEPTH) {
+                    if(!memoHasContent) return true;
+
+                    if(offsetFound && ParseOffset(offsetText, mark.offset)) {
+                        m_Markers.emplace_back(mark);
+                    }
+                } else if(depth <= matched) {
+                    // MemoList, ClipMetadata or ClipContent is over - nothing else to look for
+                    return true;
+                }
+            }
+        }
+    }
+
+    std::string_view XmlReader::Input() const {
+        return m_Mapping.IsOpen() ? m_Mapping.View() : std::string_view(m_Buffer);
+    }
+
+    std::string_view XmlReader::KeepText(std::string_view raw, const bool cdata) {
+        const bool needsDecoding {!cdata && raw.find_first_of("&\r") != std::string_view::npos};
+
+        // Zero-copy: the mapping (or the preloaded buffer) lives as long as the reader does
+        if((m_Mapping.IsOpen() || m_Preloaded) && !needsDecoding) {
+            return raw;
+        }
+
+        std::string& text {m_Context.NextOwnedText()};
+        if(needsDecoding) {
+            XmlPullParser::DecodeText(raw, text);
+        } else {
+            text.assign(raw);
+        }
+
+        return text;
+    }
+
+    bool XmlReader::ReadNextChunk() {
+        if(!m_File.is_open() || m_File.eof()) {
+            return false;
+        }
+
+        const size_t oldSize {m_Buffer.size()};
+        m_Buffer.resize(oldSize + XmlReader::READ_CHUNK_SIZE);
+        m_File.read(m_Buffer.data() + oldSize, static_cast<std::streamsize>(XmlReader::READ_CHUNK_SIZE));
+
+        const size_t bytesRead {static_cast<size_t>(m_File.gcount())};
+        m_Buffer.resize(oldSize + bytesRead);
+
+        StageMetrics::CountSyscalls(Syscall::SYSCALL_READ);
+        StageMetrics::CountBytesRead(bytesRead);
+
+        if(m_File.bad()) {
             throw P2Exception("Can\'t load a clip file", P2ExceptionCode::CODE_XML_READ_ERROR);
         }
 
-        m_Markers.reserve(XmlReader::MARKERS_VECTOR_RESERVE);
+        return bytesRead == XmlReader::READ_CHUNK_SIZE;
     }
 
-    // The path is: P2Main -> ClipContent -> ClipMetadata -> MemoList -> Memo
-    std::vector<Marker> XmlReader::ParseSourceXml() {
+    void XmlReader::ParseWithDom() {
+        // Contents that were handed over (prefetched, or from memory) are all there already
+        XMLError loaded {XML_SUCCESS};
+        if(m_Preloaded) {
+            loaded = m_XmlDoc.Parse(m_Buffer.data(), m_Buffer.size());
+        } else {
+            StageMetrics::CountSyscalls(Syscall::SYSCALL_OPEN, 2);
+            StageMetrics::CountSyscalls(Syscall::SYSCALL_READ);
+            loaded = m_XmlDoc.LoadFile(m_FilePath.string().c_str());
+        }
+
+        if(loaded != XML_SUCCESS) {
+            throw P2Exception("Can\'t load a clip file", P2ExceptionCode::CODE_XML_READ_ERROR);
+        }
+
         XMLElement* root {m_XmlDoc.RootElement()};
         if(!root) {
             throw P2Exception("The clip file is damaged or has incorrect type",
                               P2ExceptionCode::CODE_XML_READ_ERROR);
         }
 
-        XMLElement* memoListElem {p2mark::XmlUtils::FindDeepElement(root, "ClipContent/ClipMetadata/MemoList")};
+        XMLElement* memoListElem {p2mark::XmlUtils::FindDeepElement(root, XmlReader::MEMO_LIST_PATH)};
 
         auto elementIsValid = [](XMLElement*& elem) {
             return (elem != nullptr && !elem->NoChildren());
@@ -34,7 +260,7 @@ namespace p2mark {
 
         // No child elements -> no tags to parse
         if(!elementIsValid(memoListElem)) {
-            return m_Markers;
+            return;
         }
 
         for(XMLElement* memoElem {memoListElem->FirstChildElement()};
@@ -46,8 +272,6 @@ namespace p2mark {
                 m_Markers.emplace_back(*mark);
             }
         }
-
-        return m_Markers;
     }
 
     std::optional<Marker> XmlReader::ParseTextMemoElement(XMLElement* elem) {
@@ -56,18 +280,53 @@ namespace p2mark {
         }
 
         Marker mark {};
-        const XMLElement* offsetElem {elem->FirstChildElement(XmlReader::OFFSET_ELEM.data())};
-        const XMLElement* textElem   {elem->FirstChildElement(XmlReader::TEXT_ELEM.data())};
+        // Both fields in one pass over the children of the memo
+        const auto [offsetElem, textElem] {p2mark::XmlUtils::FindDeepElements(elem, XmlReader::OFFSET_PATH,
+                                                                                 XmlReader::TEXT_PATH)};
 
         if(!offsetElem || offsetElem->QueryIntText(&mark.offset) != XML_SUCCESS) {
             return std::nullopt;
         }
 
-        // Optional node
+        // Optional node; the text stays in the document, which the reader owns
         if(textElem && textElem->GetText() != nullptr) {
-            mark.text = std::string(textElem->GetText());
+            mark.text = textElem->GetText();
         }
 
         return mark;
     }
+
+    bool XmlReader::ParseOffset(std::string_view text, int& offset) {
+        size_t i {0};
+        while(i < text.size() && std::isspace(static_cast<unsigned char>(text[i]))) {
+            i++;
+        }
+
+        text.remove_prefix(i);
+
+        const bool negative {text.starts_with('-')};
+        if(negative || text.starts_with('+')) {
+            text.remove_prefix(1);
+        }
+
+        int base {10};
+        if(text.starts_with("0x") || text.starts_with("0X")) {
+            text.remove_prefix(2);
+            base = 16;
+        }
+
+        long long value {0};
+        const auto [end, error] {std::from_chars(text.data(), text.data() + text.size(), value, base)};
+        if(error != std::errc() || end == text.data()) {
+            return false;
+        }
+
+        value = negative ? -value : value;
+        if(value < std::numeric_limits<int>::min() || value > std::numeric_limits<int>::max()) {
+            return false;
+        }
+
+        offset = static_cast<int>(value);
+        return true;
+    }
 }
\ No newline at end of file
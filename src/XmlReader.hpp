@@ -7,46 +7,120 @@
 
 #pragma once
 
+#include <charconv>
 #include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <limits>
 #include <optional>
+#include <span>
 #include <sstream>
 #include <string_view>
 
 #include "tinyxml2.h"
 
+#include "MappedFile.hpp"
 #include "Marker.hpp"
+#include "MarkerStore.hpp"
 #include "P2Exception.hpp"
+#include "ParseContext.hpp"
+#include "StageMetrics.hpp"
 #include "Utils.hpp"
+#include "XmlPath.hpp"
+#include "XmlPullParser.hpp"
 
 namespace fs = std::filesystem;
 using namespace tinyxml2;
 
 namespace p2mark {
+    /// Reads the memos out of a P2 clip file.
+    /// The clip is mapped into memory and parsed in place, so the markers
+    /// it hands out borrow their text from the reader: keep the reader alive
+    /// for as long as the markers are in use. Everything else (the markers,
+    /// the read buffer, the DOM) lives in the worker's parse context and is
+    /// reused for the next clip.
     class XmlReader {
     public:
         // Per P2 standard, this is max markers per clip
-        static inline constexpr size_t MARKERS_VECTOR_RESERVE {100};
+        static inline constexpr size_t MARKERS_VECTOR_RESERVE {ParseContext::MARKERS_RESERVE};
 
-        static inline constexpr std::string_view MEMO_LIST_ELEM {"MemoList"};
-        static inline constexpr std::string_view MEMO_ELEM      {"Memo"};
-        static inline constexpr std::string_view OFFSET_ELEM    {"Offset"};
-        static inline constexpr std::string_view TEXT_ELEM      {"Text"};
+        /// If the clip can't be mapped, it is read in chunks of this size
+        /// until the memo list is over. Most clip files fit in one or two chunks,
+        /// but the ones with a lot of metadata after the MemoList don't need
+        /// to be read in full.
+        static inline constexpr size_t READ_CHUNK_SIZE {8 * 1024};
+
+        /// Where the memos are, below the root (P2Main).
+        static inline constexpr auto MEMO_LIST_PATH {CompileXmlPath<"ClipContent/ClipMetadata/MemoList">()};
+
+        /// The fields of one memo, below the memo element.
+        static inline constexpr auto OFFSET_PATH {CompileXmlPath<"Offset">()};
+        static inline constexpr auto TEXT_PATH   {CompileXmlPath<"Text">()};
+
+        static inline constexpr std::string_view MEMO_ELEM   {"Memo"};
+        static inline constexpr std::string_view OFFSET_ELEM {OFFSET_PATH.Element(0)};
+        static inline constexpr std::string_view TEXT_ELEM   {TEXT_PATH.Element(0)};
 
     public:
-        explicit XmlReader(const fs::path& xmlFilePath);
+        /// Begins a new clip in the context, forgetting the previous one.
+        XmlReader(const fs::path& xmlFilePath, ParseContext& context);
+
+        /// Parses contents that were already read (ClipPrefetcher)
+        /// or that never were a file (BatchProcessor); the path isn't opened.
+        /// The contents are swapped with the context's read buffer,
+        /// so the caller gets a spare buffer back.
+        XmlReader(const fs::path& xmlFilePath, std::string& contents, ParseContext& context);
 
     public:
-        std::vector<Marker> ParseSourceXml();
+        /// The markers stay in the context until its next clip begins.
+        std::span<const Marker> ParseSourceXml();
+
+        /// Parses the clip and copies its markers to the end of a store,
+        /// for markers that have to outlive the reader and the clip.
+        MarkerRange ParseInto(MarkerStore& store);
+
+        /// The hash of the whole clip (see ClipManifest::HashContents()),
+        /// taken from the mapping or the preloaded contents instead of
+        /// reading the file again. Returns false if the clip is read in chunks.
+        bool HashContents(uint64_t& hash) const;
 
     private:
+        /// Pull-parses the clip only as far as the end of the MemoList.
+        /// Returns false if the file uses XML features that the streaming
+        /// scanner doesn't handle; the DOM has to take over then.
+        bool StreamMemoList();
+
+        /// The bytes parsed so far: the whole mapping, or the read buffer.
+        std::string_view Input() const;
+
+        /// Appends the next chunk of the file to the read buffer.
+        /// Returns false once the whole file has been read.
+        bool ReadNextChunk();
+
+        /// The old way: load the whole clip into a tinyxml2 DOM.
+        void ParseWithDom();
+
         /// Parses the TextMemo section of the clip file
         /// and returns a marker structure (if it exists).
         std::optional<Marker> ParseTextMemoElement(XMLElement* elem);
 
+        /// Returns a view of the memo text that lives as long as the reader:
+        /// straight into the mapping when nothing has to be decoded,
+        /// otherwise into a decoded copy owned by the reader.
+        std::string_view KeepText(std::string_view raw, const bool cdata);
+
+        /// Same as QueryIntText(): leading whitespace and trailing garbage
+        /// are allowed, hexadecimal numbers need a 0x prefix.
+        static bool ParseOffset(std::string_view text, int& offset);
+
     private:
         const fs::path m_FilePath;
-        tinyxml2::XMLDocument m_XmlDoc;
-        std::vector<Marker> m_Markers;
+        ParseContext& m_Context;
+        MappedFile m_Mapping;
+        std::ifstream m_File;
+        std::string& m_Buffer;
+        bool m_Preloaded {false}; // The buffer holds the whole file and never grows
+        tinyxml2::XMLDocument& m_XmlDoc;
+        std::vector<Marker>& m_Markers;
     };
 }
\ No newline at end of file
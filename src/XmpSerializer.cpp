@@ -0,0 +1,377 @@
+/*
+* Project: p2mark
+* File:    XmpSerializer.cpp
+* Desc:    Direct XMP serializer implementation file
+* Created: 2026-10-17
+*/
+
+#include "XmpSerializer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <iterator>
+
+#include "GuidGenerator.hpp"
+#include "TextEscaper.hpp"
+
+namespace p2mark::XmpTemplates {
+    struct Attribute {
+        std::string_view Name  {};
+        std::string_view Value {}; // Must not need escaping
+    };
+
+    struct Element {
+        std::string_view Name {};
+        std::span<const Attribute> Attributes {};
+    };
+
+    // The base XMP structure, every element is the only child of the previous one
+    inline constexpr Attribute XMPMETA_ATTRIBUTES[] {
+        {"xmlns:x", "adobe:ns:meta/"},
+        {"x:xmptk", "Adobe XMP Core 7.0-c000 79.1357c9e, 2021/07/14-00:39:56        "}
+    };
+
+    inline constexpr Attribute RDF_ATTRIBUTES[] {
+        {"xmlns:rdf", "http://www.w3.org/1999/02/22-rdf-syntax-ns#"}
+    };
+
+    inline constexpr Attribute DESCRIPTION_ATTRIBUTES[] {
+        {"rdf:about",   ""},
+        {"xmlns:dc",    "http://purl.org/dc/elements/1.1/"},
+        {"xmlns:xmpDM", "http://ns.adobe.com/xmp/1.0/DynamicMedia/"},
+        {"xmlns:stDim", "http://ns.adobe.com/xap/1.0/sType/Dimensions#"},
+        {"xmlns:xmp",   "http://ns.adobe.com/xap/1.0/"},
+        {"xmlns:tiff",  "http://ns.adobe.com/tiff/1.0/"},
+        {"xmlns:aux",   "http://ns.adobe.com/exif/1.0/aux/"},
+        {"xmlns:xmpMM", "http://ns.adobe.com/xap/1.0/mm/"},
+        {"xmlns:stEvt", "http://ns.adobe.com/xap/1.0/sType/ResourceEvent#"}
+    };
+
+    inline constexpr Attribute TRACK_ATTRIBUTES[] {
+        {"xmpDM:trackName", "Comment"},
+        {"xmpDM:trackType", "Comment"},
+        {"xmpDM:frameRate", "f25"}
+    };
+
+    inline constexpr Element BASE_STRUCTURE[] {
+        {"x:xmpmeta",       XMPMETA_ATTRIBUTES},
+        {"rdf:RDF",         RDF_ATTRIBUTES},
+        {"rdf:Description", DESCRIPTION_ATTRIBUTES},
+        {"xmpDM:Tracks",    {}},
+        {"rdf:Bag",         {}},
+        {"rdf:li",          {}},
+        {"rdf:Description", TRACK_ATTRIBUTES},
+        {"xmpDM:markers",   {}},
+        {"rdf:Seq",         {}}
+    };
+
+    /// The depth of the marker list (rdf:Seq) and of the markers in it
+    inline constexpr size_t SEQ_DEPTH    {std::size(BASE_STRUCTURE) - 1};
+    inline constexpr size_t MARKER_DEPTH {SEQ_DEPTH + 1};
+
+    inline constexpr std::string_view INDENT {"    "};
+
+    /// First pass over a template: how long it is.
+    class SizeCounter {
+    public:
+        constexpr void Put(std::string_view s) { m_Size += s.size(); }
+        constexpr size_t Size() const { return m_Size; }
+
+    private:
+        size_t m_Size {0};
+    };
+
+    /// Second pass: the bytes themselves.
+    template<size_t N>
+    class ByteFiller {
+    public:
+        constexpr void Put(std::string_view s) {
+            for(const char c : s) {
+                m_Bytes[m_Pos++] = c;
+            }
+        }
+
+        constexpr const std::array<char, N>& Bytes() const { return m_Bytes; }
+
+    private:
+        std::array<char, N> m_Bytes {};
+        size_t m_Pos {0};
+    };
+
+    /// A line break and the indentation of the given depth. Writers
+    /// that know the layout of an existing file do it their own way.
+    template<typename W>
+    constexpr void PutLineStart(W& w, const size_t depth) {
+        if constexpr(requires { w.LineStart(depth); }) {
+            w.LineStart(depth);
+        } else {
+            w.Put("\n");
+            for(size_t i {0}; i < depth; i++) {
+                w.Put(INDENT);
+            }
+        }
+    }
+
+    template<typename W>
+    constexpr void PutOpenTag(W& w, const Element& elem) {
+        w.Put("<");
+        w.Put(elem.Name);
+
+        for(const Attribute& attr : elem.Attributes) {
+            w.Put(" ");
+            w.Put(attr.Name);
+            w.Put("=\"");
+            w.Put(attr.Value);
+            w.Put("\"");
+        }
+    }
+
+    template<typename W>
+    constexpr void PutCloseTag(W& w, std::string_view name, const size_t depth) {
+        PutLineStart(w, depth);
+        w.Put("</");
+        w.Put(name);
+        w.Put(">");
+    }
+
+    // The pieces of the file. Each one is a struct with an Emit() that
+    // works with both writers, so it can be measured and then baked.
+
+    /// Everything up to the marker list, which is left unsealed ("<rdf:Seq"):
+    /// it becomes <rdf:Seq/> if there are no markers.
+    struct Head {
+        template<typename W>
+        static constexpr void Emit(W& w) {
+            for(size_t depth {0}; depth < std::size(BASE_STRUCTURE); depth++) {
+                if(depth > 0) {
+                    w.Put(">");
+                    PutLineStart(w, depth);
+                }
+
+                PutOpenTag(w, BASE_STRUCTURE[depth]);
+            }
+        }
+    };
+
+    /// From the marker list's closing tag down to the end of the file.
+    struct Tail {
+        template<typename W>
+        static constexpr void Emit(W& w) {
+            for(size_t depth {SEQ_DEPTH}; depth-- > 0;) {
+                PutCloseTag(w, BASE_STRUCTURE[depth].Name, depth);
+            }
+
+            w.Put("\n");
+        }
+    };
+
+    struct SeqClose {
+        template<typename W>
+        static constexpr void Emit(W& w) {
+            PutCloseTag(w, BASE_STRUCTURE[SEQ_DEPTH].Name, SEQ_DEPTH);
+        }
+    };
+
+    // One marker: rdf:li/rdf:Description/xmpDM:cuePointParams/rdf:Seq/rdf:li,
+    // with the attribute values spliced in between the pieces
+
+    struct MarkerStart {
+        template<typename W>
+        static constexpr void Emit(W& w) {
+            PutLineStart(w, MARKER_DEPTH);
+            w.Put("<rdf:li>");
+            PutLineStart(w, MARKER_DEPTH + 1);
+            w.Put("<rdf:Description xmpDM:startTime=\"");
+        }
+    };
+
+    struct MarkerGuid {
+        template<typename W>
+        static constexpr void Emit(W& w) {
+            w.Put("\" xmpDM:guid=\"");
+        }
+    };
+
+    struct MarkerName {
+        template<typename W>
+        static constexpr void Emit(W& w) {
+            w.Put("\" xmpDM:name=\"");
+        }
+    };
+
+    struct MarkerCuePoint {
+        template<typename W>
+        static constexpr void Emit(W& w) {
+            w.Put("\">");
+            PutLineStart(w, MARKER_DEPTH + 2);
+            w.Put("<xmpDM:cuePointParams>");
+            PutLineStart(w, MARKER_DEPTH + 3);
+            w.Put("<rdf:Seq>");
+            PutLineStart(w, MARKER_DEPTH + 4);
+            w.Put("<rdf:li xmpDM:key=\"marker_guid\" xmpDM:value=\"");
+        }
+    };
+
+    struct MarkerEnd {
+        template<typename W>
+        static constexpr void Emit(W& w) {
+            w.Put("\"/>");
+            PutCloseTag(w, "rdf:Seq", MARKER_DEPTH + 3);
+            PutCloseTag(w, "xmpDM:cuePointParams", MARKER_DEPTH + 2);
+            PutCloseTag(w, "rdf:Description", MARKER_DEPTH + 1);
+            PutCloseTag(w, "rdf:li", MARKER_DEPTH);
+        }
+    };
+
+    /// Run-time writer for the marker pieces, in the layout of an existing file.
+    class LayoutWriter {
+    public:
+        LayoutWriter(std::string& out, const XmpLayout& layout) :
+            m_Out(out), m_Layout(layout) {}
+
+        void Put(std::string_view s) { m_Out.append(s); }
+
+        void LineStart(const size_t depth) {
+            m_Out.append(m_Layout.Newline);
+            m_Out.append(m_Layout.SeqIndent);
+
+            for(size_t i {SEQ_DEPTH}; i < depth; i++) {
+                m_Out.append(m_Layout.Indent);
+            }
+        }
+
+    private:
+        std::string& m_Out;
+        const XmpLayout& m_Layout;
+    };
+
+    template<typename Part>
+    inline constexpr size_t TEMPLATE_SIZE {[]() {
+        SizeCounter counter {};
+        Part::Emit(counter);
+        return counter.Size();
+    }()};
+
+    template<typename Part>
+    inline constexpr std::array<char, TEMPLATE_SIZE<Part>> TEMPLATE_BYTES {[]() {
+        ByteFiller<TEMPLATE_SIZE<Part>> filler {};
+        Part::Emit(filler);
+        return filler.Bytes();
+    }()};
+
+    template<typename Part>
+    inline constexpr std::string_view Bytes() {
+        return {TEMPLATE_BYTES<Part>.data(), TEMPLATE_BYTES<Part>.size()};
+    }
+
+    /// A marker without its offset, GUIDs and name
+    inline constexpr size_t MARKER_FIXED_SIZE {
+        TEMPLATE_SIZE<MarkerStart> + TEMPLATE_SIZE<MarkerGuid> +
+        TEMPLATE_SIZE<MarkerCuePoint> + TEMPLATE_SIZE<MarkerEnd>
+    };
+
+    /// "-2147483648"
+    inline constexpr size_t MAX_OFFSET_LENGTH {11};
+
+    /// Writes the markers; putPart(Part {}) appends the fixed piece Part.
+    template<typename PutPart>
+    void AppendMarkerEntries(std::span<const Marker> markers, std::string& out, PutPart&& putPart) {
+        std::array<GuidGenerator::GuidString, GuidGenerator::BATCH_SIZE> guids {};
+
+        for(size_t i {0}; i < markers.size(); i++) {
+            const Marker& mark {markers[i]};
+            const size_t guidIndex {i % GuidGenerator::BATCH_SIZE};
+
+            if(guidIndex == 0) {
+                const size_t count {std::min(GuidGenerator::BATCH_SIZE, markers.size() - i)};
+                GuidGenerator::GenerateBatch(std::span(guids).first(count));
+            }
+
+            const std::string_view guid {guids[guidIndex].data(), GuidGenerator::GUID_LENGTH};
+
+            char offset[MAX_OFFSET_LENGTH] {};
+            const auto [offsetEnd, ec] {std::to_chars(offset, offset + sizeof(offset), mark.offset)};
+
+            putPart(MarkerStart {});
+            out.append(offset, offsetEnd);
+            putPart(MarkerGuid {});
+            out.append(guid);
+
+            if(!mark.text.empty()) {
+                putPart(MarkerName {});
+                TextEscaper::AppendXmlAttribute(XmpSerializer::AttributeText(mark.text), out);
+            }
+
+            putPart(MarkerCuePoint {});
+            out.append(guid);
+            putPart(MarkerEnd {});
+        }
+    }
+}
+
+namespace p2mark {
+    using namespace XmpTemplates;
+
+    void XmpSerializer::SerializeNewXmp(std::span<const Marker> markers, std::string& out) {
+        out.clear();
+        out.reserve(TEMPLATE_SIZE<Head> + 2 + TEMPLATE_SIZE<SeqClose> + TEMPLATE_SIZE<Tail> + MarkersLength(markers));
+
+        out.append(Bytes<Head>());
+
+        if(markers.empty()) {
+            out.append("/>");
+        } else {
+            out.append(">");
+            AppendMarkers(markers, out);
+            out.append(Bytes<SeqClose>());
+        }
+
+        out.append(Bytes<Tail>());
+    }
+
+    void XmpSerializer::SerializeMarkers(std::span<const Marker> markers,
+                                         const XmpLayout& layout,
+                                         std::string& out) {
+        out.reserve(out.size() + MarkersLength(markers, layout));
+
+        LayoutWriter writer(out, layout);
+        AppendMarkerEntries(markers, out, [&writer](auto part) {
+            decltype(part)::Emit(writer);
+        });
+    }
+
+    void XmpSerializer::AppendMarkers(std::span<const Marker> markers, std::string& out) {
+        AppendMarkerEntries(markers, out, [&out](auto part) {
+            out.append(Bytes<decltype(part)>());
+        });
+    }
+
+    size_t XmpSerializer::MarkersLength(std::span<const Marker> markers) {
+        size_t length {0};
+
+        for(const Marker& mark : markers) {
+            length += MARKER_FIXED_SIZE + MAX_OFFSET_LENGTH + 2 * GuidGenerator::GUID_LENGTH;
+
+            if(!mark.text.empty()) {
+                length += TEMPLATE_SIZE<MarkerName> + TextEscaper::XmlAttributeLength(AttributeText(mark.text));
+            }
+        }
+
+        return length;
+    }
+
+    size_t XmpSerializer::MarkersLength(std::span<const Marker> markers, const XmpLayout& layout) {
+        // Every marker spans LINES_PER_MARKER lines, none of them
+        // more than MAX_RELATIVE_DEPTH levels below the rdf:Seq
+        constexpr size_t LINES_PER_MARKER   {9};
+        constexpr size_t MAX_RELATIVE_DEPTH {5};
+
+        const size_t lineStart {layout.Newline.size() + layout.SeqIndent.size() + MAX_RELATIVE_DEPTH * layout.Indent.size()};
+        return MarkersLength(markers) + markers.size() * LINES_PER_MARKER * lineStart;
+    }
+
+    std::string_view XmpSerializer::AttributeText(std::string_view text) {
+        return text.substr(0, text.find('\0'));
+    }
+}
\ No newline at end of file
@@ -0,0 +1,61 @@
+/*
+* Project: p2mark
+* File:    XmpSerializer.hpp
+* Desc:    Direct XMP serializer header file
+* Created: 2026-10-17
+*/
+
+#pragma once
+
+#include <span>
+#include <string>
+#include <string_view>
+
+#include "Marker.hpp"
+
+namespace p2mark {
+    /// How the lines of an existing XMP are laid out, so markers
+    /// spliced into it look like they've always been there.
+    struct XmpLayout {
+        std::string_view Newline   {"\n"};
+        std::string_view Indent    {"    "}; // One level
+        std::string_view SeqIndent {};       // Of the line the marker list (rdf:Seq) is on
+    };
+
+    /// Writes XMPs straight into a single pre-sized buffer, without a DOM.
+    /// Everything that doesn't depend on the markers is baked into byte
+    /// templates at compile time; only the offsets, GUIDs and the escaped
+    /// marker names are spliced in at run time.
+    /// The output is byte for byte what tinyxml2's pretty printer used to
+    /// produce for the same tree (4-space indentation, empty elements as <x/>,
+    /// the same attribute escaping), which is what Premiere has been reading;
+    /// only the marker names that aren't valid UTF-8 are repaired (see TextEscaper).
+    class XmpSerializer {
+    public:
+        /// Serializes a complete new XMP with the given markers into out.
+        /// Line breaks are '\n', the file has to be written in text mode
+        /// (as tinyxml2 did) to get the platform's line endings.
+        static void SerializeNewXmp(std::span<const Marker> markers, std::string& out);
+
+        /// Appends just the rdf:li entries of the markers, to go inside
+        /// an existing rdf:Seq. Every entry starts with a line break,
+        /// there is none after the last one.
+        static void SerializeMarkers(std::span<const Marker> markers,
+                                     const XmpLayout& layout,
+                                     std::string& out);
+
+        /// Enough room for what AppendMarkers() appends
+        /// (exact, apart from the longest possible offsets).
+        static size_t MarkersLength(std::span<const Marker> markers);
+
+        /// Enough room for what SerializeMarkers() appends.
+        static size_t MarkersLength(std::span<const Marker> markers, const XmpLayout& layout);
+
+        /// tinyxml2 stops at the first null character of an attribute value.
+        static std::string_view AttributeText(std::string_view text);
+
+    private:
+        /// Appends the rdf:li entries of the markers from the baked templates.
+        static void AppendMarkers(std::span<const Marker> markers, std::string& out);
+    };
+}
\ No newline at end of file
@@ -8,37 +8,6 @@
 #include "XmpWriter.hpp"
 
 namespace p2mark {
-    const std::vector<XmlNode> XmpWriter::m_XmpBaseStructure {
-        {"x:xmpmeta", {
-            {"xmlns:x", "adobe:ns:meta/"},
-            {"x:xmptk", "Adobe XMP Core 7.0-c000 79.1357c9e, 2021/07/14-00:39:56        "}
-        }},
-        {"rdf:RDF", {
-            {"xmlns:rdf", "http://www.w3.org/1999/02/22-rdf-syntax-ns#"}
-        }},
-        {"rdf:Description", {
-            {"rdf:about",   ""},
-            {"xmlns:dc",    "http://purl.org/dc/elements/1.1/"},
-            {"xmlns:xmpDM", "http://ns.adobe.com/xmp/1.0/DynamicMedia/"},
-            {"xmlns:stDim", "http://ns.adobe.com/xap/1.0/sType/Dimensions#"},
-            {"xmlns:xmp",   "http://ns.adobe.com/xap/1.0/"},
-            {"xmlns:tiff",  "http://ns.adobe.com/tiff/1.0/"},
-            {"xmlns:aux",   "http://ns.adobe.com/exif/1.0/aux/"},
-            {"xmlns:xmpMM", "http://ns.adobe.com/xap/1.0/mm/"},
-            {"xmlns:stEvt", "http://ns.adobe.com/xap/1.0/sType/ResourceEvent#"},
-        }},
-        {"xmpDM:Tracks", {}},
-        {"rdf:Bag", {}},
-        {"rdf:li", {}},
-        {"rdf:Description", {
-            {"xmpDM:trackName", "Comment"},
-            {"xmpDM:trackType", "Comment"},
-            {"xmpDM:frameRate", "f25"}
-        }},
-        {"xmpDM:markers", {}},
-        {"rdf:Seq", {}}
-    };
-
     const std::vector<XmlNode> XmpWriter::m_XmpMarkerStructure {
         {"rdf:li", {}},
         {"rdf:Description", {
@@ -53,39 +22,220 @@ namespace p2mark {
         }}
     };
 
-    XmpWriter::XmpWriter(const fs::path& xmpFilePath, std::span<const Marker> markers) :
-        m_FilePath(xmpFilePath), m_Markers(markers) {}
+    XmpWriter::XmpWriter(const fs::path& xmpFilePath,
+                         std::span<const Marker> markers,
+                         AtomicFileWriter& fileWriter,
+                         ParseContext& context) :
+        m_FilePath(xmpFilePath), m_Markers(markers), m_FileWriter(fileWriter),
+        m_Output(context.OutputBuffer()), m_XmlDoc(context.XmpDocument()) {}
+
+    FileStamp XmpWriter::WriteDestinationXmp() {
+        StageTimer timer(Stage::STAGE_XMP_WRITE);
+        StageMetrics::CountSyscalls(Syscall::SYSCALL_STAT);
 
-    void XmpWriter::WriteDestinationXmp() {
         if(!fs::exists(m_FilePath)) {
             CreateXmpFile();
-        } else {
+        } else if(!PatchSourceXmp()) {
             ParseSourceXmp();
         }
+
+        return m_Stamp;
+    }
+
+    void XmpWriter::SaveXmp(std::string_view data, const bool textMode) {
+        StageTimer timer(Stage::STAGE_XMP_SAVE);
+
+        if(!m_FileWriter.Write(m_FilePath, data, textMode, &m_Stamp)) {
+            throw P2Exception(std::format("Can't save {}", m_FilePath.filename().string()),
+                              P2ExceptionCode::CODE_XMP_WRITE_ERROR);
+        }
     }
 
     // XMP's structure is EXTREMELY SHIT
-    // read this with your eyes closed
+    // read XmpSerializer.cpp with your eyes closed
     void XmpWriter::CreateXmpFile() {
-        // Create the basic XMP tree
-        std::vector<XMLElement*> elems {CreateXmpTree(XmpWriter::m_XmpBaseStructure)};
-        ConnectXmpNodes(elems);
-        m_XmlDoc.InsertFirstChild(elems[0]);
+        m_Output.clear();
+        XmpSerializer::SerializeNewXmp(m_Markers, m_Output);
 
-        const size_t last {elems.size() - 1};
-        AppendMarkersToXml(elems[last]);
+        // Text mode, like tinyxml2's SaveFile(), for the same line endings
+        SaveXmp(m_Output, true);
+    }
 
-        const bool compactXml {false};
-        if(m_XmlDoc.SaveFile(m_FilePath.string().c_str(), compactXml) != XML_SUCCESS) {
-            throw P2Exception(std::format("Can't save {}", m_FilePath.filename().string()),
+    bool XmpWriter::PatchSourceXmp() {
+        // Loading is over once the file has been read through; what follows is writing
+        std::optional<StageTimer> loadTimer {std::in_place, Stage::STAGE_XMP_LOAD};
+        MappedFile source {};
+
+        // Empty, or can't be mapped: the DOM will say what's wrong with it
+        if(!source.Open(m_FilePath)) {
+            return false;
+        }
+
+        const auto cantLoad = []() {
+            return P2Exception("Can\'t load XMP file", P2ExceptionCode::CODE_XMP_READ_ERROR);
+        };
+
+        const std::string_view input {source.View()};
+        XmlPullParser parser {};
+        parser.Feed(input, true);
+
+        // The same search as FindDeepElement(): the first child element
+        // with the next name on every level, below the first root element
+        const size_t seqDepth {XmpWriter::MARKER_LIST_PATH.Depth() + 1};
+
+        XmlToken token {};
+        XmlToken seqOpen {};
+        XmlToken seqClose {};
+        bool rootFound {false};
+        bool seqFound  {false};
+        bool seqClosed {false};
+        size_t matched {0}; // Path elements found so far
+
+        while(true) {
+            const XmlTokenType type {parser.Next(token)};
+
+            if(type == XmlTokenType::UNSUPPORTED) {
+                return false;
+            } else if(type == XmlTokenType::MALFORMED || type == XmlTokenType::NEED_MORE) {
+                throw cantLoad();
+            } else if(type == XmlTokenType::END_OF_INPUT) {
+                break;
+            }
+
+            // Keep going until the end even after the list was found:
+            // a file that is broken further down must not be written to
+            if(type == XmlTokenType::START_TAG || type == XmlTokenType::EMPTY_TAG) {
+                const size_t depth {type == XmlTokenType::START_TAG ? parser.Depth() : parser.Depth() + 1};
+
+                if(!rootFound) {
+                    rootFound = depth == 1;
+                } else if(!seqFound && depth == matched + 2 && token.Name == XmpWriter::MARKER_LIST_PATH.Element(matched)) {
+                    matched++;
+
+                    if(matched == XmpWriter::MARKER_LIST_PATH.Depth()) {
+                        seqFound = true;
+                        seqOpen  = token;
+                    } else if(type == XmlTokenType::EMPTY_TAG) {
+                        throw cantLoad(); // The path ends here
+                    }
+                }
+            } else if(type == XmlTokenType::END_TAG) {
+                const size_t depth {parser.Depth() + 1};
+
+                if(rootFound && !seqFound && depth == matched + 1) {
+                    throw cantLoad(); // No such child on this level
+                } else if(seqFound && !seqClosed && depth == seqDepth) {
+                    seqClosed = true;
+                    seqClose  = token;
+                }
+            }
+        }
+
+        if(!rootFound) {
+            throw P2Exception("The XMP file is damaged or has incorrect type",
+                              P2ExceptionCode::CODE_XMP_READ_ERROR);
+        } else if(!seqFound) {
+            throw cantLoad();
+        }
+
+        loadTimer.reset();
+
+        // If the file is read-only, we can't write markers into it
+        if(p2mark::FilesystemUtils::IsReadOnly(m_FilePath)) {
+            throw P2Exception("XMP file is marked as read-only",
                               P2ExceptionCode::CODE_XMP_WRITE_ERROR);
         }
+
+        // Anything but whitespace inside the list (markers, comments, text)
+        // counts as content, just like NoChildren() in the DOM
+        const bool emptyTag {seqOpen.Type == XmlTokenType::EMPTY_TAG};
+        if(!emptyTag && !XmlPullParser::IsWhitespace(input.substr(seqOpen.End, seqClose.Begin - seqOpen.End))) {
+            throw P2Exception("XMP file already contains markers",
+                              P2ExceptionCode::CODE_XMP_WRITE_ERROR);
+        }
+
+        std::string seqIndent {};
+        const XmpLayout layout {DetectLayout(input, seqOpen, seqDepth, seqIndent)};
+
+        std::string& output {m_Output};
+        output.clear();
+        output.reserve(input.size() + XmpSerializer::MarkersLength(m_Markers, layout) +
+                       layout.Newline.size() + seqIndent.size() + seqOpen.Name.size() + 4);
+
+        if(emptyTag) {
+            // <rdf:Seq/> becomes <rdf:Seq>...</rdf:Seq>
+            output.append(input.substr(0, seqOpen.End - 2));
+            output.append(">");
+            XmpSerializer::SerializeMarkers(m_Markers, layout, output);
+            output.append(layout.Newline);
+            output.append(seqIndent);
+            output.append("</");
+            output.append(seqOpen.Name);
+            output.append(">");
+            output.append(input.substr(seqOpen.End));
+        } else {
+            output.append(input.substr(0, seqOpen.End));
+            XmpSerializer::SerializeMarkers(m_Markers, layout, output);
+            output.append(layout.Newline);
+            output.append(seqIndent);
+            output.append(input.substr(seqClose.Begin));
+        }
+
+        // Windows can't replace a file while it is mapped
+        source.Close();
+
+        // Binary: the original bytes (and line endings) are written back as they were
+        SaveXmp(output, false);
+
+        return true;
+    }
+
+    XmpLayout XmpWriter::DetectLayout(std::string_view input, const XmlToken& seqToken,
+                                      const size_t seqDepth, std::string& seqIndent) {
+        XmpLayout layout {};
+
+        const size_t lineBreak {seqToken.Begin == 0 ? std::string_view::npos : input.rfind('\n', seqToken.Begin - 1)};
+        const size_t lineStart {lineBreak == std::string_view::npos ? 0 : lineBreak + 1};
+        const std::string_view indentation {input.substr(lineStart, seqToken.Begin - lineStart)};
+
+        if(lineBreak != std::string_view::npos && lineBreak > 0 && input[lineBreak - 1] == '\r') {
+            layout.Newline = "\r\n";
+        }
+
+        // Adobe indents with 3 spaces, tinyxml2 used 4, somebody might use tabs:
+        // the list's own indentation tells which, if it's on a line of its own
+        const size_t levels {seqDepth - 1};
+        const bool ownLine {lineBreak != std::string_view::npos && XmlPullParser::IsWhitespace(indentation)};
+        const bool uniform {!indentation.empty() &&
+                            indentation.find_first_not_of(indentation.front()) == std::string_view::npos};
+
+        if(ownLine && uniform && indentation.size() % levels == 0) {
+            layout.Indent = input.substr(lineStart, indentation.size() / levels);
+        }
+
+        if(ownLine) {
+            seqIndent.assign(indentation);
+        } else {
+            for(size_t i {0}; i < levels; i++) {
+                seqIndent.append(layout.Indent);
+            }
+        }
+
+        layout.SeqIndent = seqIndent;
+        return layout;
     }
 
     void XmpWriter::ParseSourceXmp() {
-        if(m_XmlDoc.LoadFile(m_FilePath.string().c_str()) != XML_SUCCESS) {
-            throw P2Exception("Can\'t load XMP file",
-                              P2ExceptionCode::CODE_XMP_READ_ERROR);
+        StageMetrics::CountSyscalls(Syscall::SYSCALL_OPEN, 2);
+        StageMetrics::CountSyscalls(Syscall::SYSCALL_READ);
+
+        {
+            StageTimer timer(Stage::STAGE_XMP_LOAD);
+
+            if(m_XmlDoc.LoadFile(m_FilePath.string().c_str()) != XML_SUCCESS) {
+                throw P2Exception("Can\'t load XMP file",
+                                  P2ExceptionCode::CODE_XMP_READ_ERROR);
+            }
         }
 
         XMLElement* root = m_XmlDoc.RootElement();
@@ -94,8 +244,7 @@ namespace p2mark {
                               P2ExceptionCode::CODE_XMP_READ_ERROR);
         }
 
-        constexpr std::string_view markerListPath {"rdf:RDF/rdf:Description/xmpDM:Tracks/rdf:Bag/rdf:li/rdf:Description/xmpDM:markers/rdf:Seq"};
-        XMLElement* markerListElem {p2mark::XmlUtils::FindDeepElement(root, markerListPath)};
+        XMLElement* markerListElem {p2mark::XmlUtils::FindDeepElement(root, XmpWriter::MARKER_LIST_PATH)};
 
         if(!markerListElem) {
             throw P2Exception("Can\'t load XMP file",
@@ -116,10 +265,12 @@ namespace p2mark {
         }
 
         AppendMarkersToXml(markerListElem);
-        if(m_XmlDoc.SaveFile(m_FilePath.string().c_str(), false) != XML_SUCCESS) {
-            throw P2Exception(std::format("Can't save {}", m_FilePath.filename().string()),
-                              P2ExceptionCode::CODE_XMP_WRITE_ERROR);
-        }
+
+        // Printed into memory exactly like SaveFile() would print it
+        // into the file, so it can be written atomically
+        XMLPrinter printer(nullptr, false);
+        m_XmlDoc.Print(&printer);
+        SaveXmp(std::string_view(printer.CStr(), static_cast<size_t>(printer.CStrSize() - 1)), true);
     }
 
     std::vector<XMLElement*> XmpWriter::CreateXmpTree(const std::vector<XmlNode>& nodeList) {
@@ -162,16 +313,31 @@ namespace p2mark {
             descriptionElem->SetAttribute("xmpDM:startTime", offset);
         };
 
-        constexpr auto insertGuid = [](XMLElement* descriptionElem, XMLElement* liElem, std::string_view guid) -> void {
-            descriptionElem->SetAttribute("xmpDM:guid", guid.data());
-            liElem->SetAttribute("xmpDM:value", guid.data());
+        constexpr auto insertGuid = [](XMLElement* descriptionElem, XMLElement* liElem, const char* guid) -> void {
+            descriptionElem->SetAttribute("xmpDM:guid", guid);
+            liElem->SetAttribute("xmpDM:value", guid);
         };
 
-        constexpr auto insertMarkerText = [](XMLElement* descriptionElem, std::string_view text) -> void {
-            descriptionElem->SetAttribute("xmpDM:name", text.data());
+        // Marker texts are views and aren't null-terminated,
+        // one buffer is reused for all of them (tinyxml2 escapes them itself)
+        std::string textBuffer {};
+        auto insertMarkerText = [&textBuffer](XMLElement* descriptionElem, std::string_view text) -> void {
+            textBuffer.clear();
+            TextEscaper::AppendXmlSafe(text, textBuffer);
+            descriptionElem->SetAttribute("xmpDM:name", textBuffer.c_str());
         };
 
-        for(const Marker& mark : m_Markers) {
+        std::array<GuidGenerator::GuidString, GuidGenerator::BATCH_SIZE> guids {};
+
+        for(size_t i {0}; i < m_Markers.size(); i++) {
+            const Marker& mark {m_Markers[i]};
+            const size_t guidIndex {i % GuidGenerator::BATCH_SIZE};
+
+            if(guidIndex == 0) {
+                const size_t count {std::min(GuidGenerator::BATCH_SIZE, m_Markers.size() - i)};
+                GuidGenerator::GenerateBatch(std::span(guids).first(count));
+            }
+
             std::vector<XMLElement*> markerElems {CreateXmpTree(XmpWriter::m_XmpMarkerStructure)};
             ConnectXmpNodes(markerElems);
 
@@ -179,7 +345,7 @@ namespace p2mark {
             XMLElement* liElem          {markerElems[4]}; // rdf:Description/xmpDM:cuePointParams/rdf:Seq/rdf:li
 
             insertFrameOffset(descriptionElem, mark.offset);
-            insertGuid(descriptionElem, liElem, p2mark::WindowsUtils::GenerateGuid());
+            insertGuid(descriptionElem, liElem, guids[guidIndex].data());
             if(!mark.text.empty()) insertMarkerText(descriptionElem, mark.text);
 
             markerRoot->InsertEndChild(markerElems[0]);
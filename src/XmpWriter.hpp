@@ -7,8 +7,11 @@
 
 #pragma once
 
+#include <array>
 #include <format>
+#include <fstream>
 #include <iostream>
+#include <optional>
 #include <span>
 #include <string_view>
 #include <vector>
@@ -16,10 +19,20 @@
 
 #include "tinyxml2.h"
 
+#include "AtomicFileWriter.hpp"
+#include "ClipManifest.hpp"
 #include "Constants.hpp"
+#include "MappedFile.hpp"
+#include "GuidGenerator.hpp"
 #include "Marker.hpp"
 #include "P2Exception.hpp"
+#include "ParseContext.hpp"
+#include "StageMetrics.hpp"
+#include "TextEscaper.hpp"
 #include "Utils.hpp"
+#include "XmlPath.hpp"
+#include "XmlPullParser.hpp"
+#include "XmpSerializer.hpp"
 
 namespace fs = std::filesystem;
 using namespace tinyxml2;
@@ -32,16 +45,44 @@ namespace p2mark {
 
     class XmpWriter {
     public:
+        /// Where Premiere keeps the markers, below the root (x:xmpmeta).
+        static inline constexpr auto MARKER_LIST_PATH {CompileXmlPath<
+            "rdf:RDF/rdf:Description/xmpDM:Tracks/rdf:Bag/rdf:li/rdf:Description/xmpDM:markers/rdf:Seq">()};
+
+    public:
+        /// The file is replaced through the file writer, never written in place.
+        /// The output buffer and the DOM are borrowed from the worker's context.
         explicit XmpWriter(const fs::path& xmpFilePath,
-                           std::span<const Marker> markers);
+                           std::span<const Marker> markers,
+                           AtomicFileWriter& fileWriter,
+                           ParseContext& context);
 
     public:
-        void WriteDestinationXmp();
+        /// Returns the stamp the XMP will have once it's in place
+        /// (with batched durability it may still be pending).
+        FileStamp WriteDestinationXmp();
 
     private:
+        /// Hands the finished XMP over to the file writer.
+        void SaveXmp(std::string_view data, const bool textMode);
+
+        /// New files are serialized directly, without a DOM.
         void CreateXmpFile();
+
+        /// Splices the markers into the existing XMP at the byte offset of its
+        /// empty marker list; everything else is copied through untouched.
+        /// Returns false if the file uses XML the scanner doesn't handle,
+        /// ParseSourceXmp() has to do it then.
+        bool PatchSourceXmp();
+
+        /// The old way: load the existing XMP into a DOM, add the markers
+        /// and print the whole document again.
         void ParseSourceXmp();
 
+        /// The indentation of the line the token is on, and the line break used there.
+        static XmpLayout DetectLayout(std::string_view input, const XmlToken& seqToken,
+                                      const size_t seqDepth, std::string& seqIndent);
+
         /// Creates a flat list of XML nodes from a list of node names.
         std::vector<XMLElement*> CreateXmpTree(const std::vector<XmlNode>& nodeList);
 
@@ -53,15 +94,15 @@ namespace p2mark {
         void AppendMarkersToXml(XMLElement* markerRoot);
 
     private:
-        /// The base XMP structure.
-        static const std::vector<XmlNode> m_XmpBaseStructure;
-
         /// The marker structure of the XMP.
         static const std::vector<XmlNode> m_XmpMarkerStructure;
 
     private:
         const fs::path m_FilePath;
         std::span<const Marker> m_Markers;
-        tinyxml2::XMLDocument m_XmlDoc;
+        AtomicFileWriter& m_FileWriter;
+        FileStamp m_Stamp {};
+        std::string& m_Output;
+        tinyxml2::XMLDocument& m_XmlDoc;
     };
 }
\ No newline at end of file
@@ -5,11 +5,16 @@
 * Created: 2025-10-07
 */
 
+#include <chrono>
+#include <csignal>
 #include <filesystem>
 #include <format>
+#include <fstream>
 #include <iostream>
+#include <optional>
 #include <string_view>
 #include <format>
+#include <vector>
 
 #include "argparse.hpp"
 
@@ -18,23 +23,56 @@
 #include "P2Exception.hpp"
 #include "Application.hpp"
 #include "AppInfo.hpp"
+#include "JobServer.hpp"
+#include "MarkerIndex.hpp"
+#include "RecordWriter.hpp"
+#include "TraceRecorder.hpp"
+#include "Utils.hpp"
 
 using namespace p2mark;
 
 // Program's command line arguments:
 static inline constexpr std::string_view ARG_CONTENTS_PATH {"contents_path"};
+static inline constexpr std::string_view ARG_BUILD_INDEX   {"--build-index"};
+static inline constexpr std::string_view ARG_DAEMON        {"--daemon"};
+static inline constexpr std::string_view ARG_DURABILITY    {"--durability"};
+static inline constexpr std::string_view ARG_FORCE_SHORT   {"-f"};
+static inline constexpr std::string_view ARG_FORCE_LONG    {"--force"};
+static inline constexpr std::string_view ARG_FORMAT        {"--format"};
 static inline constexpr std::string_view ARG_HELP_SHORT    {"-h"};
 static inline constexpr std::string_view ARG_HELP_LONG     {"--help"};
+static inline constexpr std::string_view ARG_JOBS_SHORT    {"-j"};
+static inline constexpr std::string_view ARG_JOBS_LONG     {"--jobs"};
+static inline constexpr std::string_view ARG_JOB_LIST      {"--job-list"};
 static inline constexpr std::string_view ARG_LIST_SHORT    {"-l"};
 static inline constexpr std::string_view ARG_LIST_LONG     {"--list"};
+static inline constexpr std::string_view ARG_OFFSET_MAX    {"--offset-max"};
+static inline constexpr std::string_view ARG_OFFSET_MIN    {"--offset-min"};
+static inline constexpr std::string_view ARG_PRIORITY      {"--priority"};
+static inline constexpr std::string_view ARG_QUERY         {"--query"};
+static inline constexpr std::string_view ARG_RECURSIVE     {"--recursive"};
+static inline constexpr std::string_view ARG_STATS_JSON    {"--stats-json"};
+static inline constexpr std::string_view ARG_SUBMIT        {"--submit"};
+static inline constexpr std::string_view ARG_TEXT          {"--text"};
+static inline constexpr std::string_view ARG_TRACE         {"--trace"};
 static inline constexpr std::string_view ARG_VERSION_SHORT {"-v"};
 static inline constexpr std::string_view ARG_VERSION_LONG  {"--version"};
+static inline constexpr std::string_view ARG_WATCH_SHORT   {"-w"};
+static inline constexpr std::string_view ARG_WATCH_LONG    {"--watch"};
+
+// Set by Ctrl+C in watch and daemon mode
+static volatile std::sig_atomic_t g_StopRequested {0};
+
+static void OnStopSignal(int) {
+    g_StopRequested = 1;
+}
 
 static void SetupArguments(argparse::ArgumentParser& parser) {
     parser.add_description(AppInfo::Description.data());
 
     parser.add_argument(ARG_CONTENTS_PATH)
-        .help("Path to the P2 CONTENTS directory.");
+        .help("Path to one or more P2 CONTENTS directories (or, with -l, .tar archives of P2 cards).")
+        .nargs(argparse::nargs_pattern::any);
 
     parser.add_argument(ARG_HELP_SHORT, ARG_HELP_LONG)
         .help("Prints the program\'s help page and exits.")
@@ -48,6 +86,94 @@ static void SetupArguments(argparse::ArgumentParser& parser) {
         .help("List the markers, don\'t generate XMPs.")
         .flag();
 
+    parser.add_argument(ARG_JOBS_SHORT, ARG_JOBS_LONG)
+        .help("Number of clips to process in parallel (0 uses every CPU core).")
+        .metavar("N")
+        .default_value(1U)
+        .scan<'u', unsigned int>();
+
+    parser.add_argument(ARG_JOB_LIST)
+        .help("Read more CONTENTS paths from a file, one per line (- reads them from stdin).")
+        .metavar("FILE");
+
+    parser.add_argument(ARG_RECURSIVE)
+        .help("Find every shoot under this directory (an archive volume, say) and process "
+              "each one as soon as it\'s found.")
+        .metavar("ROOT");
+
+    parser.add_argument(ARG_FORCE_SHORT, ARG_FORCE_LONG)
+        .help("Process every clip again, even the ones that haven\'t changed since the last run.")
+        .flag();
+
+    parser.add_argument(ARG_DURABILITY)
+        .help("How hard to make sure written XMPs survive a power cut or a yanked card: "
+              "none, batch (sync once per batch of files) or full (sync every file).")
+        .metavar("LEVEL")
+        .default_value(std::string(DurabilityToString(Durability::DURABILITY_BATCH)))
+        .nargs(1)
+        .choices("none", "batch", "full");
+
+    parser.add_argument(ARG_FORMAT)
+        .help("What to write to stdout: text, or one record per clip and per marker "
+              "as ndjson or csv (the messages go to stderr then).")
+        .metavar("FORMAT")
+        .default_value(std::string(OutputFormatToString(OutputFormat::FORMAT_TEXT)))
+        .nargs(1)
+        .choices("text", "ndjson", "csv");
+
+    parser.add_argument(ARG_STATS_JSON)
+        .help("Write the run\'s counters, per-stage latencies and I/O totals to a JSON file "
+              "(- writes them to stdout after the usual output).")
+        .metavar("FILE");
+
+    parser.add_argument(ARG_TRACE)
+        .help("Record when every stage of every clip began and ended, on which thread, and write it "
+              "to a Chrome trace-event JSON file (open it in Perfetto or chrome://tracing).")
+        .metavar("FILE");
+
+    parser.add_argument(ARG_BUILD_INDEX)
+        .help("List the markers (no XMPs are written) and save those of every clip "
+              "to an index file that --query can search.")
+        .metavar("FILE");
+
+    parser.add_argument(ARG_QUERY)
+        .help("Search an index made with --build-index instead of processing shoots.")
+        .metavar("FILE");
+
+    parser.add_argument(ARG_TEXT)
+        .help("--query: words the memo has to contain (each one begins a word of it, case aside).")
+        .metavar("WORDS");
+
+    parser.add_argument(ARG_OFFSET_MIN)
+        .help("--query: the smallest frame offset of a marker.")
+        .metavar("N")
+        .scan<'i', int>();
+
+    parser.add_argument(ARG_OFFSET_MAX)
+        .help("--query: the largest frame offset of a marker.")
+        .metavar("N")
+        .scan<'i', int>();
+
+    parser.add_argument(ARG_DAEMON)
+        .help("Keep running and take jobs from --submit over this Unix domain socket "
+              "(-j sets the workers they share, Ctrl+C stops).")
+        .metavar("SOCKET");
+
+    parser.add_argument(ARG_SUBMIT)
+        .help("Hand the job over to the daemon listening on this socket and print its NDJSON reply.")
+        .metavar("SOCKET");
+
+    parser.add_argument(ARG_PRIORITY)
+        .help("--submit: how urgent the job is among the queued ones: low, normal or high.")
+        .metavar("LEVEL")
+        .default_value(std::string(JobPriorityToString(JobPriority::PRIORITY_NORMAL)))
+        .nargs(1)
+        .choices("low", "normal", "high");
+
+    parser.add_argument(ARG_WATCH_SHORT, ARG_WATCH_LONG)
+        .help("Keep running and process clips as soon as they are copied into CLIP (Ctrl+C stops).")
+        .flag();
+
     parser.add_argument(ARG_VERSION_SHORT, ARG_VERSION_LONG)
         .help("Prints the program\'s version and exits.")
         .flag()
@@ -59,6 +185,107 @@ static void SetupArguments(argparse::ArgumentParser& parser) {
     parser.add_epilog(AppInfo::Author.data());
 }
 
+/// Reads CONTENTS paths from a job list: one path per line,
+/// empty lines and lines starting with '#' are ignored.
+static void ReadJobList(std::istream& input, std::vector<std::string>& paths) {
+    std::string line {};
+
+    while(std::getline(input, line)) {
+        // Job lists written on Windows
+        if(!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+
+        if(line.empty() || line.front() == '#') {
+            continue;
+        }
+
+        paths.emplace_back(line);
+    }
+}
+
+/// Writes the stats report where --stats-json asked for it.
+/// Returns false if the file can't be written.
+static bool WriteStatsReport(const Application& app, const std::string& path) {
+    if(path == "-") {
+        app.WriteStatsJson(std::cout);
+        return true;
+    }
+
+    std::ofstream report(path, std::ios::binary | std::ios::trunc);
+    if(!report.is_open()) {
+        std::cerr << std::format("Cannot write the stats to {}.\n", path);
+        return false;
+    }
+
+    app.WriteStatsJson(report);
+    return true;
+}
+
+/// Writes the --trace timeline. Returns false if the file can't be written.
+static bool WriteTraceFile(const std::string& path) {
+    std::ofstream trace(path, std::ios::binary | std::ios::trunc);
+    if(!trace.is_open()) {
+        std::cerr << std::format("Cannot write the trace to {}.\n", path);
+        return false;
+    }
+
+    TraceRecorder::WriteChromeJson(trace);
+    return true;
+}
+
+/// Answers a query from the index alone; the shoots it was built from
+/// aren't needed (or touched). Returns the exit code.
+static int RunIndexQuery(const std::string& indexPath, const MarkerQuery& query, const OutputFormat format) {
+    const auto start {std::chrono::steady_clock::now()};
+
+    MarkerIndex index {};
+    if(!index.Open(indexPath)) {
+        std::cerr << std::format("Cannot open the marker index {} (missing, damaged, or not an index).\n", indexPath);
+        return 1;
+    }
+
+    const std::vector<uint32_t> found {index.Find(query)};
+    const auto elapsed {std::chrono::steady_clock::now() - start};
+
+    if(format == OutputFormat::FORMAT_TEXT) {
+        std::string out {};
+        for(const uint32_t marker : found) {
+            out.append(std::format("{} @ {}: {}\n", index.ClipPath(index.ClipOf(marker)),
+                                   index.Offset(marker), index.Text(marker)));
+        }
+        std::cout << out;
+    } else {
+        // The hits are in clip order, so each clip's markers are next to each other
+        RecordWriter records(format, std::cout);
+        std::vector<Marker> markers {};
+        std::string formatted {};
+
+        for(size_t i {0}; i < found.size();) {
+            const uint32_t clip {index.ClipOf(found[i])};
+
+            markers.clear();
+            for(; i < found.size() && index.ClipOf(found[i]) == clip; i++) {
+                markers.push_back({index.Offset(found[i]), index.Text(found[i])});
+            }
+
+            formatted.clear();
+            RecordWriter::FormatMarkers(format, index.ClipPath(clip), {}, markers, formatted);
+            records.WriteMarkers(formatted);
+        }
+
+        records.Flush();
+    }
+
+    std::string markerNoun {"markers"};
+    p2mark::StringUtils::MakeSingularIfNeeded(markerNoun, static_cast<int>(found.size()));
+
+    (format == OutputFormat::FORMAT_TEXT ? std::cout : std::cerr)
+        << std::format("\n{} {} found among {} in {:.3f} ms.\n", found.size(), markerNoun, index.MarkerCount(),
+                       std::chrono::duration<double, std::milli>(elapsed).count());
+    return 0;
+}
+
 int main(int argc, char* argv[]) {
     const bool exitOnDefaultArguments {true};
     argparse::ArgumentParser argParser(AppInfo::Name.data(),
@@ -74,32 +301,193 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
+    std::vector<std::string> contentsPaths {argParser.get<std::vector<std::string>>(ARG_CONTENTS_PATH)};
+
+    const OutputFormat format {OutputFormatFromString(argParser.get<std::string>(ARG_FORMAT))
+                                   .value_or(OutputFormat::FORMAT_TEXT)};
+
+    if(argParser.is_used(ARG_TRACE) &&
+       (argParser.is_used(ARG_QUERY) || argParser.is_used(ARG_DAEMON) || argParser.is_used(ARG_SUBMIT))) {
+        std::cerr << std::format("{} only goes with a run that processes the shoots itself.\n", ARG_TRACE);
+        return 1;
+    }
+
+    if(auto indexPath {argParser.present(ARG_QUERY)}) {
+        if(!contentsPaths.empty() || argParser.is_used(ARG_JOB_LIST) || argParser.is_used(ARG_BUILD_INDEX) ||
+           argParser.is_used(ARG_RECURSIVE)) {
+            std::cerr << std::format("A query only reads the index, it takes no {} paths.\n", CONTENTS_DIR);
+            return 1;
+        }
+
+        MarkerQuery query {};
+        query.Text      = argParser.present(ARG_TEXT).value_or(std::string {});
+        query.MinOffset = argParser.present<int>(ARG_OFFSET_MIN).value_or(query.MinOffset);
+        query.MaxOffset = argParser.present<int>(ARG_OFFSET_MAX).value_or(query.MaxOffset);
+
+        return RunIndexQuery(*indexPath, query, format);
+    }
+
+    if(argParser.is_used(ARG_TEXT) || argParser.is_used(ARG_OFFSET_MIN) || argParser.is_used(ARG_OFFSET_MAX)) {
+        std::cerr << std::format("{}, {} and {} only go with {}.\n", ARG_TEXT, ARG_OFFSET_MIN, ARG_OFFSET_MAX, ARG_QUERY);
+        return 1;
+    }
+
+    if(auto socketPath {argParser.present(ARG_DAEMON)}) {
+        if(!contentsPaths.empty() || argParser.is_used(ARG_JOB_LIST) || argParser.is_used(ARG_SUBMIT) ||
+           argParser.is_used(ARG_RECURSIVE)) {
+            std::cerr << std::format("The daemon gets its {} paths from the jobs it\'s sent.\n", CONTENTS_DIR);
+            return 1;
+        }
+
+        JobServer server(*socketPath, argParser.get<unsigned int>(ARG_JOBS_LONG));
+
+        std::signal(SIGINT, OnStopSignal);
+        std::signal(SIGTERM, OnStopSignal);
+
+        return server.Run([]() { return g_StopRequested != 0; }) ? 0 : 1;
+    }
+
+    if(argParser.is_used(ARG_PRIORITY) && !argParser.is_used(ARG_SUBMIT)) {
+        std::cerr << std::format("{} only goes with {}.\n", ARG_PRIORITY, ARG_SUBMIT);
+        return 1;
+    }
+
+    if(auto jobList {argParser.present(ARG_JOB_LIST)}) {
+        if(*jobList == "-") {
+            ReadJobList(std::cin, contentsPaths);
+        } else {
+            std::ifstream jobListFile(*jobList);
+            if(!jobListFile.is_open()) {
+                std::cerr << std::format("Cannot open the job list {}.\n", *jobList);
+                return 1;
+            }
+
+            ReadJobList(jobListFile, contentsPaths);
+        }
+    }
+
+    const std::optional<std::string> recursiveRoot {argParser.present(ARG_RECURSIVE)};
+
+    if(recursiveRoot && !contentsPaths.empty()) {
+        std::cerr << std::format("{} finds the {} paths itself, don\'t give any.\n", ARG_RECURSIVE, CONTENTS_DIR);
+        return 1;
+    }
+
+    std::error_code rootError {};
+    if(recursiveRoot && !fs::is_directory(*recursiveRoot, rootError)) {
+        std::cerr << std::format("{} isn\'t a directory.\n", *recursiveRoot);
+        return 1;
+    }
+
+    if(contentsPaths.empty() && !recursiveRoot) {
+        std::cerr << std::format("No {} path was given.\nType -h or --help to get usage info.\n", CONTENTS_DIR);
+        return 1;
+    }
+
     AppMode mode {AppMode::MODE_WRITE_MARKERS};
-    if(argParser.is_used(ARG_LIST_SHORT)) {
+    if(argParser.is_used(ARG_LIST_SHORT) || argParser.is_used(ARG_BUILD_INDEX)) {
         mode = AppMode::MODE_LIST_MARKERS;
     }
 
-    std::cout << std::format("{} running in {} mode.\n\n",
-                             AppInfo::Name, AppModeToString(mode));
+    AppOptions options {};
+    options.Jobs  = argParser.get<unsigned int>(ARG_JOBS_LONG);
+    options.Watch = argParser.get<bool>(ARG_WATCH_LONG);
+    options.Force = argParser.get<bool>(ARG_FORCE_LONG);
+    options.XmpDurability = DurabilityFromString(argParser.get<std::string>(ARG_DURABILITY))
+                                .value_or(Durability::DURABILITY_BATCH);
+    options.Format = format;
+    options.IndexPath = argParser.present(ARG_BUILD_INDEX).value_or(std::string {});
+
+    if(options.Watch && (contentsPaths.size() != 1 || recursiveRoot)) {
+        std::cerr << std::format("Watch mode needs exactly one {} path.\n", CONTENTS_DIR);
+        return 1;
+    }
+
+    if(options.Watch && !options.IndexPath.empty()) {
+        std::cerr << "An index can\'t be built in watch mode.\n";
+        return 1;
+    }
+
+    if(auto socketPath {argParser.present(ARG_SUBMIT)}) {
+        if(options.Watch || recursiveRoot) {
+            std::cerr << std::format("Neither watch mode nor {} can be handed over to the daemon.\n", ARG_RECURSIVE);
+            return 1;
+        }
+
+        // The daemon doesn't run in our working directory
+        JobRequest request {};
+        request.Mode          = mode;
+        request.Force         = options.Force;
+        request.XmpDurability = options.XmpDurability;
+        request.Priority      = JobPriorityFromString(argParser.get<std::string>(ARG_PRIORITY))
+                                    .value_or(JobPriority::PRIORITY_NORMAL);
+        request.IndexPath     = options.IndexPath.empty() ? fs::path {} : fs::absolute(options.IndexPath);
+
+        for(const std::string& path : contentsPaths) {
+            request.ContentsPaths.emplace_back(fs::absolute(path).string());
+        }
+
+        return JobServer::Submit(*socketPath, request, std::cout) ? 0 : 1;
+    }
+
+    const std::optional<std::string> statsJsonPath {argParser.present(ARG_STATS_JSON)};
+    const std::optional<std::string> tracePath {argParser.present(ARG_TRACE)};
+    const bool writesRecords {options.Format != OutputFormat::FORMAT_TEXT};
+
+    if(writesRecords && statsJsonPath == "-") {
+        std::cerr << std::format("The stats can\'t go to stdout together with {} records.\n",
+                                 OutputFormatToString(options.Format));
+        return 1;
+    }
+
+    // Records are all that goes to stdout
+    (writesRecords ? std::cerr : std::cout) << std::format("{} running in {} mode.\n\n",
+                                                           AppInfo::Name, AppModeToString(mode));
+
+    int status {1};
+    std::optional<Application> app {};
 
     try {
         // SCOPED_TIMER; // Uncomment to time the execution of the program
 
-        Application app(mode, argParser.get<std::string>(ARG_CONTENTS_PATH));
-        app.RetrieveClipFiles();
-        app.SortClipFiles();
-        app.BatchProcessClips();
+        if(tracePath) {
+            TraceRecorder::Start();
+        }
+
+        app.emplace(mode, contentsPaths, options);
 
-        return 0;
+        if(options.Watch) {
+            std::signal(SIGINT, OnStopSignal);
+            std::signal(SIGTERM, OnStopSignal);
+
+            app->WatchClips([]() { return g_StopRequested != 0; });
+        } else if(recursiveRoot) {
+            app->ProcessTree(*recursiveRoot);
+        } else {
+            app->RetrieveClipFiles();
+            app->SortClipFiles();
+            app->BatchProcessClips();
+        }
+
+        status = app->SaveMarkerIndex() ? 0 : 1;
     } catch(const P2Exception& e) {
         std::cerr << std::format("{}.\n", e.what());
-        return 1;
     } catch(const std::filesystem::filesystem_error& e) {
         std::cerr << std::format("Cannot access path: {}.\n",
                                  e.path1().string());
-        return 1;
     } catch(const std::exception&) {
         std::cerr << "Unexpected error occured during processing.\n";
-        return 1;
     }
+
+    // Written however the run ended: a failed run is the one that most needs explaining.
+    // The stats need the application, which a shoot that can't be opened never gets
+    if(statsJsonPath && app && !WriteStatsReport(*app, *statsJsonPath)) {
+        status = 1;
+    }
+
+    if(tracePath && !WriteTraceFile(*tracePath)) {
+        status = 1;
+    }
+
+    return status;
 }
\ No newline at end of file